@@ -5,13 +5,23 @@
 
 #include <cairo/cairo.h>
 #include <stack>
+#include <vector>
 #include <memory>
+#include <functional>
 #include <xg/font.hpp>
 #include <xg/pen.hpp>
 #include <xg/brush.hpp>
 #include <xg/path.hpp>
 
 namespace xg {
+
+class MarkerAtlas ;
+class SurfaceLease ;
+
+// Image processing applied to the pixels of a layer before it is composited. The pixels are premultiplied ARGB32
+// (native endian) and the matrix maps the user coordinates at the time the layer was opened to pixel coordinates.
+typedef std::function<void (unsigned char *pixels, int width, int height, int stride, const Matrix2d &tr)> LayerFilter ;
+
 namespace detail {
 
 class Backend {
@@ -20,31 +30,100 @@ public:
     cairo_surface_t *surf_ = nullptr , *proxy_surf_ = nullptr;
     std::shared_ptr<Canvas> mask_ ;
 
+    struct Layer {
+        double opacity_ ;
+        bool group_ ;           // drawn into an offscreen group
+        cairo_matrix_t ctm_ ;
+        LayerFilter filter_ ;
+    } ;
+
+    std::vector<Layer> layers_ ;
+    std::shared_ptr<MarkerAtlas> markers_ ;
+    // pooled pixel buffers of surf_ (image canvases) and proxy_surf_
+    std::shared_ptr<SurfaceLease> surf_lease_, proxy_lease_ ;
+
     Backend() ;
     ~Backend() ;
 
+    // Paint used for filling. Each brush kind is stored in place with a small number of gradient stops kept
+    // inline so that setting a brush does not allocate and applying it is a switch on the type.
+    struct BrushState {
+        enum Type { None, Solid, LinearGradient, RadialGradient, Pattern } ;
+
+        static const int max_inline_stops = 8 ;
+
+        struct Stop {
+            double offset_ ;
+            Color clr_ ;
+        } ;
+
+        void set(const SolidBrush &br) ;
+        void set(const LinearGradientBrush &br) ;
+        void set(const RadialGradientBrush &br) ;
+        void set(const PatternBrush &br) ;
+        void clear() ;
+
+        const Stop *stops() const { return n_stops_ <= max_inline_stops ? stops_ : extra_stops_.data() ; }
+
+        explicit operator bool () const { return type_ != None ; }
+
+        Type type_ = None ;
+        FillRule fill_rule_ = FillRule::EvenOdd ;
+        double opacity_ = 1.0 ;
+
+        Color color_ ;                          // Solid
+        double coords_[5] ;                     // LinearGradient: x0 y0 x1 y1, RadialGradient: cx cy r fx fy
+        SpreadMethod spread_ = SpreadMethod::Pad ;
+        Matrix2d tr_ ;
+        int n_stops_ = 0 ;
+        Stop stops_[max_inline_stops] ;
+        std::vector<Stop> extra_stops_ ;        // only used with more than max_inline_stops stops
+        std::shared_ptr<Canvas> pattern_ ;      // Pattern
+
+    private:
+
+        void set_gradient(const GradientBrush &br) ;
+    } ;
+
+    // stroke parameters of the cairo context that differ from the current pen
+    enum StrokeDirtyBits { StrokeDirtyColor = 0x01, StrokeDirtyWidth = 0x02, StrokeDirtyMiter = 0x04, StrokeDirtyCap = 0x08,
+                           StrokeDirtyJoin = 0x10, StrokeDirtyDash = 0x20, StrokeDirtyAll = 0x3f } ;
+
     struct State {
          State() ;
 
-         std::shared_ptr<Pen> pen_ ;
-         std::shared_ptr<Brush> brush_ ;
+         const Pen *pen() const { return has_pen_ ? &pen_ : nullptr ; }
+
+         Pen pen_ ;
+         bool has_pen_ = false ;
+
+         // Pen last applied to the cairo context at this save level and the parameters that have changed since.
+         // Kept per state since cairo_restore also restores the stroke parameters.
+         Pen applied_pen_ ;
+         unsigned int stroke_dirty_ = StrokeDirtyAll ;
+         BrushState brush_ ;
 
-         Font font_ ;
+         // shared since it is rarely changed while states are copied on every save()
+         std::shared_ptr<const Font> font_ ;
+         TextRenderMode text_mode_ = TextRenderMode::Glyphs ;
          Matrix2d trans_ ;
      };
 
-    std::stack<State> state_ ;
+    // vector storage keeps its capacity so that save/restore do not allocate
+    std::stack<State, std::vector<State>> state_ ;
 
 protected:
 
     void init() ;
     void flush() ;
     void set_cairo_stroke(const Pen &pen) ;
-    void cairo_apply_linear_gradient(const LinearGradientBrush &lg);
-    void cairo_apply_radial_gradient(const RadialGradientBrush &rg);
-    void cairo_apply_pattern(const PatternBrush &pat);
+    void apply_stroke_state() ;
+    void cairo_apply_gradient(const BrushState &br);
+    void cairo_apply_pattern(const BrushState &br);
     void fill_stroke_shape();
-    void set_cairo_fill(const std::shared_ptr<Brush> &br);
+    void set_cairo_fill(const BrushState &br);
+    void fill_stroke_batch(const cairo_path_t *path, const Color *clr, bool fill) ;
+    void show_glyphs(const cairo_glyph_t *glyphs, const Glyph *src, int num_glyphs, double size, bool use_pen, const Color *clr = nullptr) ;
     void line_path(double x0, double y0, double x1, double y1) ;
     void rect_path(double x0, double y9, double w, double h) ;
     void path(const Path &path) ;
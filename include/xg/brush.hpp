@@ -134,6 +134,7 @@ public:
 
     Matrix2d transform() const { return tr_ ; }
     Canvas &pattern() const { return *pattern_ ; }
+    const std::shared_ptr<Canvas> &patternCanvas() const { return pattern_ ; }
     SpreadMethod spread() const { return sm_ ; }
 
 private:
@@ -0,0 +1,50 @@
+#ifndef __XG_CACHED_PATH_HPP__
+#define __XG_CACHED_PATH_HPP__
+
+#include <memory>
+
+#include <xg/path.hpp>
+#include <xg/pen.hpp>
+#include <xg/xform.hpp>
+
+namespace xg {
+
+class CachedPathData ;
+
+// A retained path for shapes that are redrawn many times (e.g. plot frames, static backgrounds).
+// The backend rasterizes the fill and stroke coverage of the path once and on subsequent draws with the same
+// device transformation (up to an integer pixel offset) only composites the cached masks. The fill uses the
+// brush of the canvas at draw time while the stroke uses the pen given here. Vector targets (PDF, PS, SVG) draw
+// the path normally.
+
+class CachedPath {
+public:
+
+    CachedPath(const Path &p, const Matrix2d &tr = Matrix2d()): path_(p), has_pen_(false), tr_(tr) {}
+    CachedPath(const Path &p, const Pen &pen, const Matrix2d &tr = Matrix2d()): path_(p), pen_(pen), has_pen_(true), tr_(tr) {}
+
+    const Path &path() const { return path_ ; }
+    const Pen *pen() const { return has_pen_ ? &pen_ : nullptr ; }
+
+    // transformation applied to the path before the canvas transformation
+    const Matrix2d &transform() const { return tr_ ; }
+    void setTransform(const Matrix2d &tr) { tr_ = tr ; invalidate() ; }
+
+    // drop cached rasterizations
+    void invalidate() { data_.reset() ; }
+
+private:
+
+    friend class CachedPathData ;
+
+    Path path_ ;
+    Pen pen_ ;
+    bool has_pen_ ;
+    Matrix2d tr_ ;
+
+    mutable std::shared_ptr<CachedPathData> data_ ;
+} ;
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define __XG_CANVAS_HPP__
 
 #include <memory>
+#include <functional>
 
 #include <string>
 #include <xg/pen.hpp>
@@ -9,18 +10,27 @@
 #include <xg/font.hpp>
 #include <xg/xform.hpp>
 #include <xg/path.hpp>
+#include <xg/cached_path.hpp>
+#include <xg/marker.hpp>
 #include <xg/font.hpp>
 #include <xg/image.hpp>
 #include <xg/rectangle.hpp>
 #include <xg/glyph.hpp>
+#include <xg/text_layout.hpp>
 #include <xg/svg_document.hpp>
+#include <xg/recording_canvas.hpp>
 
 #include <xg/backends/cairo/canvas.hpp>
 
 namespace xg {
 
+namespace detail {
+struct OutputStream ;
+}
+
 enum TextAlignFlags {
-    TextAlignLeft = 0x01, TextAlignRight = 0x02, TextAlignTop = 0x04, TextAlignBottom = 0x08, TextAlignHCenter = 0x10, TextAlignVCenter = 0x20, TextAlignBaseline = 0x40
+    TextAlignLeft = 0x01, TextAlignRight = 0x02, TextAlignTop = 0x04, TextAlignBottom = 0x08, TextAlignHCenter = 0x10, TextAlignVCenter = 0x20, TextAlignBaseline = 0x40,
+    TextAlignJustify = 0x80
 }  ;
 
 class Canvas: public detail::Backend {
@@ -37,6 +47,16 @@ public:
     void save() ;
     void restore() ;
 
+    // Draw into an offscreen layer that is composited with the given opacity by the matching endLayer(), so that
+    // overlapping shapes in the layer do not show through each other. The layer is limited to the bounds (in user
+    // coordinates) when given, otherwise to the current clip; drawing outside of it is discarded. Like save(), the
+    // state is restored by endLayer(). Layers may be nested.
+    void beginLayer(double opacity, const Rectangle2d &bounds = Rectangle2d()) ;
+    // Layer whose pixels are processed by the filter before compositing. The filter is only applied when the
+    // layer is rasterized (image canvases), on other surfaces the content is composited unfiltered.
+    void beginLayer(double opacity, const Rectangle2d &bounds, const LayerFilter &filter) ;
+    void endLayer() ;
+
     void setTransform(const Matrix2d &tr) ;
 
     void setPen(const Pen &pen) ;
@@ -57,6 +77,9 @@ public:
 
     void setClipPath(const Path &p, FillRule frule= FillRule::EvenOdd) ;
 
+    // bounding box of the current clip region in user coordinates
+    Rectangle2d clipExtents() ;
+
 
     void drawLine(double x0, double y0, double x1, double y1) ;
     void drawLine(const Point2d &p1, const Point2d &p2) ;
@@ -64,6 +87,8 @@ public:
     void drawRect(const Rectangle2d &r) ;
 
     void drawPath(const Path &path) ;
+    // draw a retained path, compositing cached coverage masks when possible
+    void drawPath(const CachedPath &path) ;
 
     void drawPolyline(double *pts, int nPts) ;
     void drawPolygon(double *pts, int nPts) ;
@@ -71,6 +96,25 @@ public:
     void drawCircle(const Point2d &center, double r) ;
     void drawEllipse(double xp, double yp, double ax, double ay) ;
 
+    // Batched primitives. Coordinates are contiguous arrays (x0 y0 x1 y1 ... for points and line segments,
+    // x y w h for rectangles). Items are painted with as few fills/strokes as possible, so overlapping
+    // items are composited once as a union. If colors are given they replace the brush color, or the pen
+    // color when there is no brush (always the pen color for lines).
+    void drawCircles(const double *pts, int n, double r, const Color *colors = nullptr) ;
+    void drawCircles(const double *pts, const double *radii, int n, const Color *colors = nullptr) ;
+    void drawRects(const double *rects, int n, const Color *colors = nullptr) ;
+    void drawLines(const double *segments, int n, const Color *colors = nullptr) ;
+    // marker is a path centered at the origin, scaled by size and translated to each point
+    void drawMarkers(const double *pts, int n, const Path &marker, double size, const Color *colors = nullptr) ;
+    void drawMarkers(const double *pts, const double *sizes, int n, const Path &marker, const Color *colors = nullptr) ;
+    // standard markers with the current pen and brush. On image surfaces they are stamped from a sprite cache
+    // (positions are snapped to 1/4 pixel).
+    void drawMarkers(const double *pts, int n, MarkerShape shape, double size) ;
+
+    // Text outlines are only generated in TextRenderMode::Outlines or for glyphs drawn with a pen, otherwise
+    // glyphs are painted from cairo's glyph cache which is much faster for label heavy drawings.
+    void setTextRenderMode(TextRenderMode mode) ;
+
     void drawText(const std::string &textStr, double x0, double y0) ;
     void drawText(const std::string &textStr, double x0, double y0, double width, double height, unsigned int flags) ;
     void drawText(const std::string &textStr, const Point2d &p) ;
@@ -78,6 +122,9 @@ public:
 
     void drawGlyph(const Glyph &g, const Point2d &p) ;
     void drawGlyphs(const std::vector<Glyph> &glyphs, const std::vector<Point2d> &positions) ;
+    // Draw labels laid out by TextLayout::layoutBatch with the current font (the one used for the layout) and brush,
+    // label i at (origins[2*i], origins[2*i+1]). If colors are given they replace the brush color of each label.
+    void drawGlyphRuns(const GlyphRuns &runs, const double *origins, const Color *colors = nullptr) ;
 
     void drawImage(const Image &im,  double opacity) ;
 
@@ -94,15 +141,42 @@ protected:
     double dpi_x_, dpi_y_ ;
 } ;
 
+// pixel formats of image canvases; A8 stores only coverage and is used for masks, RGB24 and RGB16_565 are opaque
+enum class PixelFormat { ARGB32, RGB24, A8, RGB16_565 } ;
+
 class ImageCanvas: public Canvas
 {
 public:
 
-    ImageCanvas(double width, double height, double dpi=300) ;
+    ImageCanvas(double width, double height, double dpi=300, PixelFormat fmt = PixelFormat::ARGB32) ;
 
+    PixelFormat format() const { return format_ ; }
+
+    // copy of the pixels; RGB16_565 canvases are expanded to RGB24
     Image getImage() ;
 
     void saveToPng(const std::string &fname) ;
+
+    // Retained mode. The canvas content is described by a display list (in device coordinates) and only the parts
+    // of the image that changed are re-rasterized.
+
+    // mark a region (in device pixels) for redraw
+    void invalidate(const Rectangle2d &r) ;
+    void invalidateAll() ;
+
+    // clear and redraw the invalidated regions from the display list, returning the (pixel aligned) regions
+    // that were updated
+    std::vector<Rectangle2d> redraw(const DisplayList &content) ;
+
+    // invalidate the regions where content differs from the last content drawn by update() and redraw them
+    std::vector<Rectangle2d> update(const DisplayList &content) ;
+
+private:
+
+    PixelFormat format_ ;
+    std::vector<Rectangle2d> dirty_ ;
+    DisplayList content_ ;
+    bool has_content_ = false ;
 } ;
 
 // frontend for cairo recording surface
@@ -111,6 +185,72 @@ public:
     PatternCanvas(double width, double height) ;
 } ;
 
+// callback receiving the output of a document canvas as it is produced, it should return false on write error
+typedef std::function<bool (const char *data, size_t len)> OutputWriter ;
+
+// base of the canvases writing vector documents. Units are points (1/72 inch). PDF output is streamed as each page
+// is completed so memory use does not depend on the number of pages (see PSCanvas). Fonts are embedded once per
+// document as subsets of the glyphs used in all pages.
+class DocumentCanvas: public Canvas {
+public:
+
+    ~DocumentCanvas() ;
+
+    // write any pending output and close the document; no drawing is allowed afterwards
+    void finish() ;
+
+    // true if the surface could not be created or writing the output failed
+    bool hasError() const ;
+
+protected:
+
+    DocumentCanvas(double width, double height) ;
+
+    // create the stream passed as closure to the surface write function
+    void create_stream(const OutputWriter &writer) ;
+    void create_stream(int fd) ;
+
+    void show_page() ;
+
+    static cairo_status_t write_cb(void *closure, const unsigned char *data, unsigned int length) ;
+
+    std::unique_ptr<detail::OutputStream> stream_ ;
+    bool finished_ = false ;
+} ;
+
+// frontend for cairo PDF surface
+class PDFCanvas: public DocumentCanvas {
+public:
+    PDFCanvas(const std::string &fname, double width, double height) ;
+    // write to an open file descriptor, which is not closed
+    PDFCanvas(int fd, double width, double height) ;
+    PDFCanvas(const OutputWriter &writer, double width, double height) ;
+
+    // finish the current page and start a new one with the same or a different size
+    void newPage() ;
+    void newPage(double width, double height) ;
+} ;
+
+// frontend for cairo PostScript surface. The page content is held until finish() since the document prolog
+// (e.g. the font subsets) has to precede it, so memory use grows with the number of pages.
+class PSCanvas: public DocumentCanvas {
+public:
+    PSCanvas(const std::string &fname, double width, double height) ;
+    PSCanvas(int fd, double width, double height) ;
+    PSCanvas(const OutputWriter &writer, double width, double height) ;
+
+    void newPage() ;
+    void newPage(double width, double height) ;
+} ;
+
+// frontend for cairo SVG surface, SVG documents have a single page
+class SVGCanvas: public DocumentCanvas {
+public:
+    SVGCanvas(const std::string &fname, double width, double height) ;
+    SVGCanvas(int fd, double width, double height) ;
+    SVGCanvas(const OutputWriter &writer, double width, double height) ;
+} ;
+
 
 } // namespace xg ;
 
@@ -32,6 +32,9 @@ public:
     void setGreen(double green) noexcept { g_ = clamp(green) ; }
     void setBlue(double blue) noexcept { b_ = clamp(blue) ; }
 
+    bool operator == (const Color &o) const noexcept { return r_ == o.r_ && g_ == o.g_ && b_ == o.b_ && a_ == o.a_ ; }
+    bool operator != (const Color &o) const noexcept { return !(*this == o) ; }
+
 private:
 
     static double clamp(double value) ;
@@ -7,23 +7,35 @@
 namespace xg {
 
 enum class FontStyle { Normal, Oblique, Italic } ;
-enum FontWeight { Normal, Bold } ;
+// CSS font weights, any value in [1, 1000] may also be used
+enum class FontWeight { Thin = 100, ExtraLight = 200, Light = 300, Normal = 400, Medium = 500, SemiBold = 600,
+                        Bold = 700, ExtraBold = 800, Black = 900 } ;
+// CSS font stretch keywords as percentages of the normal width (fontconfig FC_WIDTH values)
+enum class FontStretch { UltraCondensed = 50, ExtraCondensed = 63, Condensed = 75, SemiCondensed = 87, Normal = 100,
+                         SemiExpanded = 113, Expanded = 125, ExtraExpanded = 150, UltraExpanded = 200 } ;
+// Glyphs: filled text is painted from cached glyph bitmaps (cairo_show_glyphs), Outlines: glyph outlines are
+// converted to paths and filled like other shapes
+enum class TextRenderMode { Glyphs, Outlines } ;
 
 class Font {
 public:
 
     Font(const std::string &family_desc, double pts):  sz_(pts),
-        style_(FontStyle::Normal),  weight_(FontWeight::Normal) {
+        style_(FontStyle::Normal),  weight_(400), stretch_(100) {
         parse_family_names(family_desc) ;
     }
 
     Font & setStyle(FontStyle style) { style_ = style  ; return *this ; }
-    Font & setWeight(FontWeight weight) { weight_ = weight ; return *this ;}
+    Font & setWeight(FontWeight weight) { weight_ = static_cast<int>(weight) ; return *this ;}
+    Font & setWeight(int weight) { weight_ = weight ; return *this ;}
+    Font & setStretch(FontStretch stretch) { stretch_ = static_cast<int>(stretch) ; return *this ;}
+    Font & setStretch(int percent) { stretch_ = percent ; return *this ;}
     Font & setSize(double pts) { sz_ = pts ; return *this ; }
     Font & setFamily(const std::string &family_desc ) { parse_family_names(family_desc) ; return *this ; }
 
     FontStyle style() const { return style_ ; }
-    FontWeight weight() const { return weight_ ; }
+    int weight() const { return weight_ ; }
+    int stretch() const { return stretch_ ; }
     double size() const { return sz_ ; }
     const std::vector<std::string> familyNames() const { return family_names_ ; }
 
@@ -42,12 +54,22 @@ private:
     }
 
     FontStyle style_ ;
-    FontWeight weight_ ;
+    int weight_, stretch_ ;
     double sz_ ;
     std::vector<std::string> family_names_ ;
 } ;
 
 
+// Resolve the faces of the fonts (family names, style and weight; sizes are ignored) on several threads, e.g. at
+// startup, so that text drawn later with them does not wait for fontconfig matching.
+void preloadFonts(const std::vector<Font> &fonts) ;
+
+// Persistent font match cache. loadFontCache reads the matches saved by a previous run and returns false if the file
+// is missing or was written under a different fontconfig configuration (fonts or configuration files changed),
+// saveFontCache writes all matches made so far.
+bool loadFontCache(const std::string &path) ;
+bool saveFontCache(const std::string &path) ;
+
 } // namespace xg ;
 
 #endif
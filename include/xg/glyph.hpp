@@ -13,6 +13,7 @@ struct Glyph {
     unsigned index_;  // glyph code point
     double x_advance_, y_advance_;  // amount to advance cursor
     double x_offset_, y_offset_ ;   // glyphs offset
+    void *face_ = nullptr ;         // backend font face of a fallback font the index refers to, nullptr for the font itself
  };
 
 
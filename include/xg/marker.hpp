@@ -0,0 +1,19 @@
+#ifndef __XG_MARKER_HPP__
+#define __XG_MARKER_HPP__
+
+#include <xg/path.hpp>
+
+namespace xg {
+
+// standard plot marker shapes
+
+enum class MarkerShape { Circle, Square, XMark, Point, Plus, Star, Diamond, TriangleDown,
+                         TriangleUp, TriangleLeft, TriangleRight } ;
+
+// outline of a marker of unit size centered at the origin. XMark and Plus consist only of line segments
+// and are visible only when stroked.
+Path markerPath(MarkerShape shape) ;
+
+}
+
+#endif
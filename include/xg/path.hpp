@@ -13,6 +13,7 @@ namespace xg {
 
 class PathData ;
 class Font ;
+class FlattenedPath ;
 
 class Path
 {
@@ -21,6 +22,12 @@ public:
     Path() = default;
     ~Path() = default;
 
+    // the backend data is shared with the copy, see data_
+    Path(const Path &other) ;
+    Path(Path &&other) = default ;
+    Path &operator=(const Path &other) ;
+    Path &operator=(Path &&other) = default ;
+
     // See SVG 1.1 Path specification (http://www.w3.org/TR/SVG/paths.html)
 
     Path & moveTo(double x, double y) ;
@@ -62,6 +69,8 @@ public:
     Path & addRect(double x0, double y0, double w, double h) ;
     Path & addRoundedRect(double x0, double y0, double w, double h, double xrad, double yrad) ;
     Path & addPath(const Path &other) ;
+    // append other path after transforming it by m
+    Path & addPath(const Path &other, const Matrix2d &m) ;
     Path & addText(const std::string &str, double x0, double y0, const Font &font) ;
     Path & addGlyphs(const std::vector<Glyph> &glyphs, const std::vector<Point2d> &pos, const Font &font) ;
 
@@ -69,13 +78,26 @@ public:
     Path &addPolygon(const std::vector<Point2d> &pts) ;
     Path &addPolyline(const std::vector<Point2d> &pts) ;
 
+    // transform all points of the path in place
+    Path & transform(const Matrix2d &m) ;
+
     Path transformed(const Matrix2d &m) const;
+    // same as above but writes into dst reusing its storage
+    void transformed(const Matrix2d &m, Path &dst) const ;
 
-    // path bounding box
+    // tight path bounding box (curve extrema are taken into account, not just control points)
     Rectangle2d extents() const ;
 
-    // return a flattened version of the path
-    Path flattened() const ;
+    // return a flattened version of the path (consisting only of move, line and close commands)
+    // tolerance is the maximum allowed distance between the curve and its approximation
+    Path flattened(double tolerance = 0.25) const ;
+
+    // flatten into a reusable polyline buffer. The tolerance is given in device units and m is the
+    // transformation that maps the path to the device. The output points are in path coordinates.
+    void flatten(FlattenedPath &dst, double tolerance = 0.25, const Matrix2d &m = Matrix2d()) const ;
+
+    // length of the flattened path
+    double length(double tolerance = 0.25) const ;
 
     enum Command { MoveToCmd, ClosePathCmd, LineToCmd, CurveToCmd, QuadCurveToCmd } ;
 
@@ -92,14 +114,56 @@ public:
 
 private:
 
+    friend class PathData ;
+
+    // backend representation of the path (e.g. cairo path data) built on first draw and
+    // reused until the path is modified. It is only read and set with the atomic shared_ptr
+    // functions from const methods so that the same path may be drawn from several threads.
+    mutable std::shared_ptr<PathData> data_ ;
 
     std::vector<CommandBlock> cmds_ ;
-    double cx_, cy_, rx_, ry_ ;
-    Command previous_cmd_ ;
+    double cx_ = 0, cy_ = 0, rx_ = 0, ry_ = 0 ;
+    Command previous_cmd_ = MoveToCmd ;
 
     void addCommand(Command cmd, double arg0=0, double arg1=0, double arg2=0, double arg3=0, double arg4=0, double arg5=0) ;
 } ;
 
+// Polyline approximation of a path as computed by Path::flatten. The points of all sub-paths are stored
+// in a single array and sub-paths are ranges into it. Closed sub-paths repeat their first point at the end.
+// Calling clear() keeps the allocated storage so the same buffer may be reused across paths.
+
+class FlattenedPath {
+public:
+
+    struct SubPath {
+        unsigned first_, last_ ; // range [first_, last_) in points
+        bool closed_ ;
+    } ;
+
+    const std::vector<Point2d> &points() const { return points_ ; }
+    const std::vector<SubPath> &subPaths() const { return subpaths_ ; }
+
+    void clear() ;
+
+    // total length of all sub-paths
+    double length() const { return lengths_.empty() ? 0.0 : lengths_.back() ; }
+
+    // arc-length parameterization: point (and optionally unit tangent) at distance s along the path
+    // s is clamped to [0, length()]
+    Point2d pointAtLength(double s, Vector2d *tangent = nullptr) const ;
+
+    // incremental construction
+    void moveTo(double x, double y) ;
+    void lineTo(double x, double y) ;
+    void close() ;
+
+private:
+
+    std::vector<Point2d> points_ ;
+    std::vector<SubPath> subpaths_ ;
+    std::vector<double> lengths_ ; // cumulative arc length at each point
+} ;
+
 
 
 } // namespace xplot ;
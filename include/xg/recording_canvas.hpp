@@ -0,0 +1,179 @@
+#ifndef __XG_RECORDING_CANVAS_HPP__
+#define __XG_RECORDING_CANVAS_HPP__
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdint>
+
+#include <xg/pen.hpp>
+#include <xg/brush.hpp>
+#include <xg/font.hpp>
+#include <xg/xform.hpp>
+#include <xg/path.hpp>
+#include <xg/image.hpp>
+#include <xg/rectangle.hpp>
+#include <xg/glyph.hpp>
+
+namespace xg {
+
+class Canvas ;
+class RecordingCanvas ;
+
+// A compact binary list of drawing commands captured by a RecordingCanvas. It may be replayed on any Canvas
+// (e.g. at a different resolution by setting a transform first), saved to disk and compared with another list
+// to find the regions that need to be redrawn. The stream is stored in host byte order.
+
+class DisplayList {
+public:
+
+    DisplayList() = default ;
+
+    // execute all commands on the canvas
+    void replay(Canvas &c) const ;
+
+    // execute only the drawing commands that affect the region r (in recording coordinates), clipped to r
+    void replay(Canvas &c, const Rectangle2d &r) const ;
+    // same for the union of several regions
+    void replay(Canvas &c, const std::vector<Rectangle2d> &regions) const ;
+
+    bool save(const std::string &fname) const ;
+    bool load(const std::string &fname) ;
+
+    void write(std::ostream &strm) const ;
+    bool read(std::istream &strm) ;
+
+    // Bounding boxes (in recording coordinates) of the regions where the rendering of the two lists differs.
+    // A drawing command is considered unchanged if the same command is drawn with identical state (transform,
+    // paint, font, clip) and in the same order relative to the other unchanged commands in both lists. Overlapping
+    // regions are merged.
+    static std::vector<Rectangle2d> diff(const DisplayList &a, const DisplayList &b) ;
+
+    // number of commands
+    size_t size() const { return count_ ; }
+    bool empty() const { return count_ == 0 ; }
+
+    // size of the encoded stream in bytes
+    size_t byteSize() const { return data_.size() ; }
+
+    // size of the recorded page
+    double width() const { return width_ ; }
+    double height() const { return height_ ; }
+
+    void clear() ;
+
+private:
+
+    friend class RecordingCanvas ;
+
+    template<class C> bool play(C &c, const std::vector<Rectangle2d> *regions) const ;
+
+    // visible drawing command
+    struct DrawItem {
+        size_t offset_ ;        // position of the command in the stream
+        uint64_t hash_ ;        // hash of the command and the state it is drawn with
+        Rectangle2d bounds_ ;   // device bounds
+    } ;
+
+    std::vector<char> data_ ;
+    std::vector<DrawItem> items_ ;
+    size_t count_ = 0 ;
+    double width_ = 0, height_ = 0 ;
+} ;
+
+// Canvas front-end that records drawing calls into a DisplayList instead of rendering them. It has the drawing
+// interface of Canvas except for the following, which are not recorded:
+//  - layers (beginLayer/endLayer)
+//  - pattern brushes and clip masks (setBrush(PatternBrush), setClipMask)
+//  - batched primitives (drawCircles, drawRects, drawLines, drawMarkers) and glyph runs (drawGlyphRuns)
+//  - cached paths (drawPath(CachedPath)) and SVG documents (drawSVG)
+
+class RecordingCanvas {
+public:
+
+    RecordingCanvas(double width, double height) ;
+
+    void save() ;
+    void restore() ;
+
+    void setTransform(const Matrix2d &tr) ;
+
+    void setPen(const Pen &pen) ;
+    void setBrush(const SolidBrush &brush) ;
+    void setBrush(const LinearGradientBrush &brush) ;
+    void setBrush(const RadialGradientBrush &brush) ;
+    void setFont(const Font &font) ;
+
+    void clearBrush()  ;
+    void clearPen() ;
+
+    void setAntialias(bool antiAlias = true) ;
+    void setTextRenderMode(TextRenderMode mode) ;
+
+    void setClipRect(double x0, double y0, double w, double h) ;
+    void setClipRect(const Rectangle2d &r) ;
+    void setClipPath(const Path &p, FillRule frule= FillRule::EvenOdd) ;
+
+    // bounding box of the current clip region in user coordinates
+    Rectangle2d clipExtents() const ;
+
+    void drawLine(double x0, double y0, double x1, double y1) ;
+    void drawLine(const Point2d &p1, const Point2d &p2) ;
+    void drawRect(double x0, double y0, double w, double h) ;
+    void drawRect(const Rectangle2d &r) ;
+
+    void drawPath(const Path &path) ;
+
+    void drawPolyline(double *pts, int nPts) ;
+    void drawPolygon(double *pts, int nPts) ;
+    void drawCircle(double cx, double cy, double r) ;
+    void drawCircle(const Point2d &center, double r) ;
+    void drawEllipse(double xp, double yp, double ax, double ay) ;
+
+    void drawText(const std::string &textStr, double x0, double y0) ;
+    void drawText(const std::string &textStr, double x0, double y0, double width, double height, unsigned int flags) ;
+    void drawText(const std::string &textStr, const Point2d &p) ;
+    void drawText(const std::string &textStr, const Rectangle2d &r, unsigned int flags) ;
+
+    void drawGlyph(const Glyph &g, const Point2d &p) ;
+    void drawGlyphs(const std::vector<Glyph> &glyphs, const std::vector<Point2d> &positions) ;
+
+    void drawImage(const Image &im,  double opacity) ;
+
+    double width() const { return width_ ; }
+    double height() const { return height_ ; }
+
+    const DisplayList &displayList() const { return list_ ; }
+
+    // start a new recording
+    void reset() ;
+
+private:
+
+    struct State {
+        State(): font_("Arial", 10) {}
+
+        Matrix2d ctm_ ;
+        bool has_pen_ = false, has_brush_ = false ;
+        double line_width_ = 0, miter_limit_ = 0 ;
+        bool antialias_ = true ;
+        Font font_ ;
+        TextRenderMode text_mode_ = TextRenderMode::Glyphs ;
+        Rectangle2d clip_ ;     // device bounds of the clip region
+        uint64_t pen_hash_ = 0, brush_hash_ = 0, font_hash_ = 0, clip_hash_ = 0 ;
+    } ;
+
+    size_t begin(int op) ;
+    uint64_t end(size_t offset) ;
+    void end_draw(size_t offset, const Rectangle2d &user_bounds, unsigned int deps) ;
+    void end_clip(size_t offset, const Rectangle2d &user_bounds) ;
+    Rectangle2d to_device(const Rectangle2d &r) const ;
+
+    double width_, height_ ;
+    DisplayList list_ ;
+    std::vector<State> states_ ;
+} ;
+
+}
+
+#endif
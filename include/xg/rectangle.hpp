@@ -3,6 +3,8 @@
 
 #include <xg/vector.hpp>
 
+#include <algorithm>
+
 namespace xg {
 
 class Rectangle2d
@@ -44,6 +46,29 @@ public:
 
     bool empty() const { return empty_ ; }
 
+    bool intersects(const Rectangle2d &other) const {
+        if ( empty_ || other.empty_ ) return false ;
+        return x_ <= other.x_ + other.width_ && other.x_ <= x_ + width_ &&
+               y_ <= other.y_ + other.height_ && other.y_ <= y_ + height_ ;
+    }
+
+    // smallest rectangle containing both
+    Rectangle2d united(const Rectangle2d &other) const {
+        if ( empty_ ) return other ;
+        if ( other.empty_ ) return *this ;
+        double x0 = std::min(x_, other.x_), y0 = std::min(y_, other.y_) ;
+        double x1 = std::max(x_ + width_, other.x_ + other.width_), y1 = std::max(y_ + height_, other.y_ + other.height_) ;
+        return Rectangle2d(x0, y0, x1 - x0, y1 - y0) ;
+    }
+
+    // common part of both, empty if they do not intersect
+    Rectangle2d intersected(const Rectangle2d &other) const {
+        if ( !intersects(other) ) return Rectangle2d() ;
+        double x0 = std::max(x_, other.x_), y0 = std::max(y_, other.y_) ;
+        double x1 = std::min(x_ + width_, other.x_ + other.width_), y1 = std::min(y_ + height_, other.y_ + other.height_) ;
+        return Rectangle2d(x0, y0, x1 - x0, y1 - y0) ;
+    }
+
     void extend(const Point2d &p) {
         if ( empty_ ) {
             x_ = p.x() ; y_ = p.y() ;
@@ -52,7 +77,7 @@ public:
             double tlx = std::min(x_, p.x()) ;
             double tly = std::min(y_, p.y()) ;
             double brx = std::max(x_ + width_, p.x()) ;
-            double bry = std::max(y_ + width_, p.y()) ;
+            double bry = std::max(y_ + height_, p.y()) ;
 
             x_ = tlx ; y_ = tly ;
             width_ = brx - tlx ; height_ = bry - tly ;
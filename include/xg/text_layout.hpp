@@ -6,12 +6,56 @@
 
 #include <xg/font.hpp>
 #include <xg/glyph.hpp>
+#include <xg/rectangle.hpp>
 
 class TextLayoutEngine ;
 
 namespace xg {
 
 enum class TextDirection { Auto, LeftToRight, RightToLeft } ;
+
+// Greedy: fill each line as much as possible, OptimalFit: choose the breaks of each paragraph that minimize the
+// total demerits of its lines (Knuth-Plass)
+enum class LineBreakMode { Greedy, OptimalFit } ;
+
+// Penalty model of the optimal fit line breaker. The demerits of a line are (line + badness)^2 plus the squared
+// penalty of its break, where badness grows with the cube of the ratio by which the inter-word spaces
+// (or the right margin when not justified) are stretched or shrunk.
+struct LineBreakPenalties {
+    double line_ = 10 ;                     // added to the badness of every line, favours fewer lines
+    double hyphen_ = 50 ;                   // breaking at a hyphenation point (soft hyphen)
+    double consecutive_hyphens_ = 3000 ;    // extra demerits for two hyphenated lines in a row
+    double fitness_ = 100 ;                 // extra demerits for a tight line next to a loose one
+} ;
+
+// Metrics of a text measured without laying it out in lines of glyphs, lines are only broken at newlines
+
+struct TextMetrics {
+    double width_ = 0 ;     // advance width of the longest line
+    double height_ = 0 ;    // sum of the line heights given by the font metrics
+    double ascent_ = 0 ;    // font ascent and descent
+    double descent_ = 0 ;
+    Rectangle2d ink_ ;      // bounding box of the glyphs relative to the origin of the first baseline, y axis down
+} ;
+
+// Measure text with the cached font metrics and shaper, much cheaper than a TextLayout. The batch version shares
+// the font lookup among all strings.
+TextMetrics measureText(const std::string &text, const Font &font) ;
+std::vector<TextMetrics> measureText(const std::vector<std::string> &texts, const Font &font) ;
+
+// Glyphs of many labels laid out at once (TextLayout::layoutBatch), stored contiguously. The glyphs of label i are
+// glyphs_[offsets_[i]] up to glyphs_[offsets_[i+1]] and positions_ holds their origins relative to the first
+// baseline of the label.
+
+struct GlyphRuns {
+    std::vector<Glyph> glyphs_ ;
+    std::vector<Point2d> positions_ ;
+    std::vector<size_t> offsets_ ;          // one more than the number of labels
+    std::vector<TextMetrics> metrics_ ;     // metrics of each label
+
+    size_t size() const { return metrics_.size() ; }
+} ;
+
 class TextLine ;
 
 class TextLayout {
@@ -19,8 +63,14 @@ public:
     TextLayout(const std::string &text, const Font &fd) ;
 
     void setWrapWidth(double width) ;
+    // distance between baselines as a multiple of the font line height
     void setLineSpacing(double ls) ;
 
+    void setLineBreakMode(LineBreakMode mode) ;
+    void setLineBreakPenalties(const LineBreakPenalties &penalties) ;
+    // stretch the spaces of all wrapped lines but the last of each paragraph to the wrap width
+    void setJustify(bool justify) ;
+
     void setTextDirection(TextDirection dir) ;
 
     void compute() ;
@@ -30,6 +80,10 @@ public:
 
     const std::vector<TextLine> &lines() const ;
 
+    // Lay out labels (no wrapping, lines break at newlines only) in parallel, sharing the font among all of them.
+    // The runs may be drawn with Canvas::drawGlyphRuns using the same font.
+    static GlyphRuns layoutBatch(const std::vector<std::string> &texts, const Font &font, TextDirection dir = TextDirection::Auto) ;
+
 
 private:
 
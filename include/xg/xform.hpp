@@ -154,6 +154,8 @@ public:
         m4_ = t1/d;
         m3_ = -m3_/d;
         m2_ = -m2_/d;
+
+        return *this ;
     }
 
     double m1() const { return m1_ ; }
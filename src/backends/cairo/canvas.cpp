@@ -2,19 +2,29 @@
 #include <xg/canvas.hpp>
 
 #include <cairo/cairo.h>
+#include <cairo/cairo-pdf.h>
+#include <cairo/cairo-ps.h>
+#include <cairo/cairo-svg.h>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 #include <cmath>
 #include <regex>
 
 #ifdef _WIN32
 #include <cairo-win32.h>
+#include <io.h>
 #else
+#include <unistd.h>
 #include <cairo/cairo-ft.h>
 #include <fontconfig/fcfreetype.h>
 #include <harfbuzz/hb.h>
 #include <harfbuzz/hb-ft.h>
 #include "text_layout_engine.hpp"
 #include "font_manager.hpp"
+#include "path_data.hpp"
+#include "marker_atlas.hpp"
+#include "surface_pool.hpp"
 
 #endif
 
@@ -26,10 +36,69 @@ using namespace std;
 namespace xg {
 namespace detail {
 
-Backend::State::State(): font_("Arial", 10) {
+Backend::State::State(): font_(std::make_shared<Font>("Arial", 10)) {
 
 }
 
+void Backend::BrushState::set(const SolidBrush &br) {
+    type_ = Solid ;
+    fill_rule_ = br.fillRule() ;
+    opacity_ = br.fillOpacity() ;
+    color_ = br.color() ;
+    pattern_.reset() ;
+}
+
+void Backend::BrushState::set_gradient(const GradientBrush &br) {
+    fill_rule_ = br.fillRule() ;
+    opacity_ = br.fillOpacity() ;
+    spread_ = br.spread() ;
+    tr_ = br.transform() ;
+    pattern_.reset() ;
+
+    const auto &stops = br.stops() ;
+    n_stops_ = stops.size() ;
+
+    Stop *dst = stops_ ;
+
+    if ( n_stops_ > max_inline_stops ) {
+        extra_stops_.resize(n_stops_) ;
+        dst = extra_stops_.data() ;
+    }
+
+    for( int i=0 ; i<n_stops_ ; i++ ) {
+        dst[i].offset_ = stops[i].offset_ ;
+        dst[i].clr_ = stops[i].clr_ ;
+    }
+}
+
+void Backend::BrushState::set(const LinearGradientBrush &br) {
+    type_ = LinearGradient ;
+    set_gradient(br) ;
+    coords_[0] = br.x0() ; coords_[1] = br.y0() ;
+    coords_[2] = br.x1() ; coords_[3] = br.y1() ;
+}
+
+void Backend::BrushState::set(const RadialGradientBrush &br) {
+    type_ = RadialGradient ;
+    set_gradient(br) ;
+    coords_[0] = br.cx() ; coords_[1] = br.cy() ; coords_[2] = br.radius() ;
+    coords_[3] = br.fx() ; coords_[4] = br.fy() ;
+}
+
+void Backend::BrushState::set(const PatternBrush &br) {
+    type_ = Pattern ;
+    fill_rule_ = br.fillRule() ;
+    opacity_ = br.fillOpacity() ;
+    spread_ = br.spread() ;
+    tr_ = br.transform() ;
+    pattern_ = br.patternCanvas() ;
+}
+
+void Backend::BrushState::clear() {
+    type_ = None ;
+    pattern_.reset() ;
+}
+
 Backend::Backend() {
     State st ;
     state_.push(std::move(st)) ;
@@ -46,118 +115,103 @@ void Backend::set_cairo_stroke(const Pen &pen) {
     if ( clr.a()  == 1.0 ) cairo_set_source_rgb(cr(), clr.r(), clr.g(), clr.b()) ;
     else cairo_set_source_rgba(cr(), clr.r(), clr.g(), clr.b(), clr.a() ) ;
 
-    cairo_set_line_width (cr(), pen.lineWidth());
+    cairo_set_stroke_style(cr(), pen) ;
+}
 
-    cairo_set_miter_limit (cr(), pen.miterLimit()) ;
+static unsigned int stroke_changes(const Pen &a, const Pen &b) {
+    unsigned int bits = 0 ;
 
-    switch ( pen.lineCap() ) {
-    case LineCap::Butt:
-        cairo_set_line_cap(cr(), CAIRO_LINE_CAP_BUTT) ;
-        break ;
-    case LineCap::Round:
-        cairo_set_line_cap(cr(), CAIRO_LINE_CAP_ROUND) ;
-        break ;
-    case LineCap::Square:
-        cairo_set_line_cap(cr(), CAIRO_LINE_CAP_SQUARE) ;
-        break ;
-    }
+    if ( !(a.lineColor() == b.lineColor()) ) bits |= Backend::StrokeDirtyColor ;
+    if ( a.lineWidth() != b.lineWidth() ) bits |= Backend::StrokeDirtyWidth ;
+    if ( a.miterLimit() != b.miterLimit() ) bits |= Backend::StrokeDirtyMiter ;
+    if ( a.lineCap() != b.lineCap() ) bits |= Backend::StrokeDirtyCap ;
+    if ( a.lineJoin() != b.lineJoin() ) bits |= Backend::StrokeDirtyJoin ;
+    if ( a.dashOffset() != b.dashOffset() || a.dashArray() != b.dashArray() ) bits |= Backend::StrokeDirtyDash ;
 
-    switch ( pen.lineJoin() ) {
-    case LineJoin::Miter:
-        cairo_set_line_join(cr(), CAIRO_LINE_JOIN_MITER) ;
-        break ;
-    case LineJoin::Round:
-        cairo_set_line_join(cr(), CAIRO_LINE_JOIN_ROUND) ;
-        break ;
-    case LineJoin::Bevel:
-        cairo_set_line_join(cr(), CAIRO_LINE_JOIN_BEVEL) ;
-        break ;
-    }
+    return bits ;
+}
 
-    double dash_offset = pen.dashOffset() ;
+// emit only the stroke parameters that changed since they were last applied to the context
 
-    const auto &dash_array = pen.dashArray() ;
+void Backend::apply_stroke_state() {
 
-    if ( dash_array.empty() )
-        cairo_set_dash(cr(), 0, 0, 0) ;
-    else
-        cairo_set_dash(cr(), &dash_array[0], dash_array.size(), dash_offset) ;
-}
+    State &state = state_.top() ;
 
-void Backend::cairo_apply_linear_gradient(const LinearGradientBrush &lg) {
-    cairo_pattern_t *pattern;
-    cairo_matrix_t matrix;
+    unsigned int dirty = state.stroke_dirty_ ;
 
-    double x0 = lg.x0(), y0 = lg.y0(), x1 = lg.x1(), y1 = lg.y1() ;
+    if ( dirty == 0 ) return ;
 
-    pattern = cairo_pattern_create_linear ( x0, y0, x1, y1 ) ;
+    const Pen &pen = state.pen_ ;
 
-    Matrix2d tr = lg.transform() ;
-    cairo_matrix_init (&matrix, tr.m1(), tr.m2(), tr.m3(), tr.m4(), tr.m5(), tr.m6());
-    cairo_matrix_invert (&matrix);
-    cairo_pattern_set_matrix (pattern, &matrix);
+    if ( dirty & StrokeDirtyColor ) {
+        const Color &clr = pen.lineColor() ;
+
+        if ( clr.a()  == 1.0 ) cairo_set_source_rgb(cr(), clr.r(), clr.g(), clr.b()) ;
+        else cairo_set_source_rgba(cr(), clr.r(), clr.g(), clr.b(), clr.a() ) ;
+    }
+
+    if ( dirty & ( StrokeDirtyCap | StrokeDirtyJoin | StrokeDirtyDash ) ) {
+        // rarely changing, set everything at once
+        cairo_set_stroke_style(cr(), pen) ;
+    } else {
+        if ( dirty & StrokeDirtyWidth )
+            cairo_set_line_width (cr(), pen.lineWidth());
 
-    if ( lg.spread() == SpreadMethod::Reflect )
+        if ( dirty & StrokeDirtyMiter )
+            cairo_set_miter_limit (cr(), pen.miterLimit()) ;
+    }
+
+    state.applied_pen_ = pen ;
+    state.stroke_dirty_ = 0 ;
+}
+
+static void cairo_set_pattern_extend(cairo_pattern_t *pattern, SpreadMethod sm) {
+    if ( sm == SpreadMethod::Reflect )
         cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REFLECT);
-    else if ( lg.spread() == SpreadMethod::Repeat )
+    else if ( sm == SpreadMethod::Repeat )
         cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REPEAT);
     else
         cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
-
-    for( const auto &stop: lg.stops() ) {
-        const Color &clr = stop.clr_ ;
-        cairo_pattern_add_color_stop_rgba (pattern, stop.offset_, clr.r(), clr.g(), clr.b(), clr.a() * lg.fillOpacity() );
-    }
-
-    cairo_set_source (cr(), pattern);
-    cairo_pattern_destroy (pattern);
 }
 
-void Backend::cairo_apply_radial_gradient(const RadialGradientBrush &rg) {
+void Backend::cairo_apply_gradient(const BrushState &br) {
     cairo_pattern_t *pattern;
     cairo_matrix_t matrix;
 
-    double fx = rg.fx(), fy=rg.fy(), cx=rg.cx(), cy=rg.cy(), r=rg.radius() ;
+    const double *c = br.coords_ ;
 
-    pattern = cairo_pattern_create_radial ( fx,	fy, 0.0, cx, cy, r) ;
+    if ( br.type_ == BrushState::LinearGradient )
+        pattern = cairo_pattern_create_linear ( c[0], c[1], c[2], c[3] ) ;
+    else
+        pattern = cairo_pattern_create_radial ( c[3], c[4], 0.0, c[0], c[1], c[2]) ;
 
-    Matrix2d tr = rg.transform() ;
+    const Matrix2d &tr = br.tr_ ;
     cairo_matrix_init (&matrix, tr.m1(), tr.m2(), tr.m3(), tr.m4(), tr.m5(), tr.m6());
     cairo_matrix_invert (&matrix);
     cairo_pattern_set_matrix (pattern, &matrix);
 
-    if ( rg.spread() == SpreadMethod::Reflect )
-        cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REFLECT);
-    else if ( rg.spread() == SpreadMethod::Repeat )
-        cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REPEAT);
-    else
-        cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
+    cairo_set_pattern_extend(pattern, br.spread_) ;
 
-    for( const auto &stop: rg.stops() ) {
-        const Color &clr = stop.clr_ ;
-        cairo_pattern_add_color_stop_rgba (pattern, stop.offset_, clr.r(), clr.g(), clr.b(), clr.a() * rg.fillOpacity() );
+    const BrushState::Stop *stops = br.stops() ;
+
+    for( int i=0 ; i<br.n_stops_ ; i++ ) {
+        const Color &clr = stops[i].clr_ ;
+        cairo_pattern_add_color_stop_rgba (pattern, stops[i].offset_, clr.r(), clr.g(), clr.b(), clr.a() * br.opacity_ );
     }
 
     cairo_set_source (cr(), pattern);
     cairo_pattern_destroy (pattern);
 }
 
-void Backend::cairo_apply_pattern(const PatternBrush &pat) {
+void Backend::cairo_apply_pattern(const BrushState &br) {
 
-    Canvas &c = pat.pattern() ;
+    cairo_pattern_t *pattern = cairo_pattern_create_for_surface (br.pattern_->surf_);
 
-    cairo_pattern_t *pattern = cairo_pattern_create_for_surface (c.surf_);
-
-    if ( pat.spread() == SpreadMethod::Reflect )
-        cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REFLECT);
-    else if ( pat.spread() == SpreadMethod::Repeat )
-        cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REPEAT);
-    else
-        cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
+    cairo_set_pattern_extend(pattern, br.spread_) ;
 
     cairo_matrix_t matrix;
 
-    Matrix2d tr = pat.transform() ;
+    const Matrix2d &tr = br.tr_ ;
     cairo_matrix_init (&matrix, tr.m1(), tr.m2(), tr.m3(), tr.m4(), tr.m5(), tr.m6());
     cairo_matrix_invert (&matrix);
     cairo_pattern_set_matrix (pattern, &matrix);
@@ -171,21 +225,18 @@ void Backend::cairo_apply_pattern(const PatternBrush &pat) {
 
 void Backend::fill_stroke_shape() {
 
-    const State &state = state_.top();
+    State &state = state_.top();
 
 
     if ( state.brush_ )  {
-        const auto &br = state.brush_ ;
-
-        set_cairo_fill(br) ;
+        set_cairo_fill(state.brush_) ;
 
-        if ( state.pen_  ) cairo_fill_preserve(cr()) ;
+        if ( state.has_pen_  ) cairo_fill_preserve(cr()) ;
         else cairo_fill (cr());
     }
 
-    if ( state.pen_ )  {
-        const Pen &pen = *state.pen_ ;
-        set_cairo_stroke(pen) ;
+    if ( state.has_pen_ )  {
+        apply_stroke_state() ;
         cairo_stroke(cr()) ;
     }
 
@@ -193,28 +244,128 @@ void Backend::fill_stroke_shape() {
 
 }
 
-void Backend::set_cairo_fill(const std::shared_ptr<Brush> &br) {
+void Backend::set_cairo_fill(const BrushState &br) {
 
-    if ( br->fillRule() == FillRule::EvenOdd)
+    // the source now differs from the pen color
+    state_.top().stroke_dirty_ |= StrokeDirtyColor ;
+
+    if ( br.fill_rule_ == FillRule::EvenOdd)
         cairo_set_fill_rule (cr(), CAIRO_FILL_RULE_EVEN_ODD);
-    else if ( br->fillRule() == FillRule::NonZero )
+    else if ( br.fill_rule_ == FillRule::NonZero )
         cairo_set_fill_rule (cr(), CAIRO_FILL_RULE_WINDING);
 
-    if ( const auto &brush = dynamic_cast<SolidBrush *>(br.get()) )
-    {
-        const Color &clr = brush->color() ;
+    switch ( br.type_ ) {
+    case BrushState::Solid: {
+        const Color &clr = br.color_ ;
 
-        if ( clr.a() * br->fillOpacity()  == 1.0 ) cairo_set_source_rgb(cr(), clr.r(), clr.g(), clr.b()) ;
-        else cairo_set_source_rgba(cr(), clr.r(), clr.g(), clr.b(), clr.a() * br->fillOpacity() ) ;
+        if ( clr.a() * br.opacity_  == 1.0 ) cairo_set_source_rgb(cr(), clr.r(), clr.g(), clr.b()) ;
+        else cairo_set_source_rgba(cr(), clr.r(), clr.g(), clr.b(), clr.a() * br.opacity_ ) ;
+        break ;
+    }
+    case BrushState::LinearGradient:
+    case BrushState::RadialGradient:
+        cairo_apply_gradient(br) ;
+        break ;
+    case BrushState::Pattern:
+        cairo_apply_pattern(br) ;
+        break ;
+    case BrushState::None:
+        break ;
     }
-    else if ( const auto &brush = dynamic_cast<LinearGradientBrush *>(br.get()) )
-        cairo_apply_linear_gradient(*brush) ;
-    else if ( const auto &brush = dynamic_cast<RadialGradientBrush *>(br.get()) )
-        cairo_apply_radial_gradient(*brush) ;
-    else if ( const auto &brush = dynamic_cast<PatternBrush *>(br.get()) )
-        cairo_apply_pattern(*brush) ;
 }
 
+// paint an accumulated batch of shapes, the optional color overriding the brush (or pen if fill is false)
+
+void Backend::fill_stroke_batch(const cairo_path_t *path, const Color *clr, bool fill) {
+
+    State &state = state_.top();
+
+    cairo_new_path(cr()) ;
+    cairo_append_path(cr(), path) ;
+
+    fill = fill && state.brush_ ;
+
+    if ( fill )  {
+        const auto &br = state.brush_ ;
+
+        if ( clr ) {
+            cairo_set_source_rgba(cr(), clr->r(), clr->g(), clr->b(), clr->a() * br.opacity_) ;
+            state.stroke_dirty_ |= StrokeDirtyColor ;
+        }
+        else set_cairo_fill(br) ;
+
+        // items of a batch never cancel each other
+        cairo_set_fill_rule(cr(), CAIRO_FILL_RULE_WINDING) ;
+
+        if ( state.has_pen_  ) cairo_fill_preserve(cr()) ;
+        else cairo_fill (cr());
+    }
+
+    if ( state.has_pen_ )  {
+        apply_stroke_state() ;
+        if ( clr && !fill ) {
+            cairo_set_source_rgba(cr(), clr->r(), clr->g(), clr->b(), clr->a()) ;
+            state.stroke_dirty_ |= StrokeDirtyColor ;
+        }
+        cairo_stroke(cr()) ;
+    }
+
+    cairo_new_path(cr()) ;
+}
+
+// Paint a glyph run with the current brush. Glyph masks rendered by cairo_show_glyphs are cached per scaled font so
+// this is much cheaper than filling the outlines, which are only used when stroking (use_pen) or in outline mode.
+// Without a brush, glyphs are painted with the current source (drawText) unless use_pen is set. A color (drawGlyphRuns)
+// replaces the brush. Glyphs taken from fallback faces (src[i].face_) are drawn in sub-runs with that face scaled to the
+// given size.
+
+void Backend::show_glyphs(const cairo_glyph_t *glyphs, const Glyph *src, int num_glyphs, double size, bool use_pen, const Color *clr) {
+
+    State &state = state_.top();
+
+    bool outlines = state.text_mode_ == TextRenderMode::Outlines || ( use_pen && state.has_pen_ ) ;
+
+    if ( !outlines && !state.brush_ && use_pen ) return ;
+
+    // fill_stroke_shape sets up the brush itself, a color replaces the brush color
+    if ( clr && !use_pen ) {
+        double opacity = state.brush_ ? state.brush_.opacity_ : 1.0 ;
+        cairo_set_source_rgba(cr(), clr->r(), clr->g(), clr->b(), clr->a() * opacity) ;
+        state.stroke_dirty_ |= StrokeDirtyColor ;
+    }
+    else if ( state.brush_ && !( outlines && use_pen ) ) set_cairo_fill(state.brush_) ;
+
+    cairo_scaled_font_t *primary = cairo_scaled_font_reference(cairo_get_scaled_font(cr())) ;
+
+    for( int i=0 ; i<num_glyphs ; ) {
+        int j = i + 1 ;
+        while ( j < num_glyphs && src[j].face_ == src[i].face_ ) ++j ;
+
+        cairo_scaled_font_t *fallback = nullptr ;
+
+        if ( src[i].face_ ) {
+            fallback = FontManager::instance().createFont(static_cast<cairo_font_face_t *>(src[i].face_), size) ;
+            if ( fallback ) cairo_set_scaled_font(cr(), fallback) ;
+        }
+        else if ( i > 0 )
+            cairo_set_scaled_font(cr(), primary) ;
+
+        if ( outlines ) cairo_glyph_path(cr(), glyphs + i, j - i) ;
+        else cairo_show_glyphs(cr(), glyphs + i, j - i) ;
+
+        if ( fallback ) cairo_scaled_font_destroy(fallback) ;
+
+        i = j ;
+    }
+
+    cairo_set_scaled_font(cr(), primary) ;
+    cairo_scaled_font_destroy(primary) ;
+
+    if ( outlines ) {
+        if ( use_pen ) fill_stroke_shape() ;
+        else cairo_fill(cr()) ;
+    }
+}
 
 void Backend::line_path(double x0, double y0, double x1, double y1) {
     cairo_move_to(cr(), x0, y0) ;
@@ -239,26 +390,8 @@ cairo_t *Backend::cr() {
 
 
 void Backend::path(const Path &path) {
-
     cairo_new_path(cr()) ;
-
-    for( const auto &pcb: path.commands() ) {
-
-        switch( pcb.cmd_ ) {
-        case Path::MoveToCmd:
-            cairo_move_to(cr(), pcb.arg0_, pcb.arg1_) ;
-            break ;
-        case Path::LineToCmd:
-            cairo_line_to(cr(), pcb.arg0_, pcb.arg1_) ;
-            break ;
-        case Path::CurveToCmd:
-            cairo_curve_to(cr(), pcb.arg0_, pcb.arg1_, pcb.arg2_, pcb.arg3_, pcb.arg4_, pcb.arg5_) ;
-            break ;
-        case Path::ClosePathCmd:;
-            cairo_close_path(cr()) ;
-            break ;
-        }
-    }
+    cairo_append_path(cr(), PathData::cairoPath(path)) ;
 }
 
 
@@ -274,6 +407,22 @@ cairo_surface_t *cairo_create_image_surface(const Image &im)
 
     int src_stride = im.stride() ;
 
+    if ( im.format() == ImageFormat::A8 ) {
+        // coverage only, keep it as an alpha surface
+        psurf = cairo_image_surface_create(CAIRO_FORMAT_A8, width, height) ;
+        cairo_surface_flush(psurf) ;
+
+        unsigned char *dst = cairo_image_surface_get_data(psurf) ;
+        int dst_stride = cairo_image_surface_get_stride(psurf);
+        const char *src = im.pixels() ;
+
+        for (int i = 0; i < height; i++, dst += dst_stride, src += src_stride )
+            memcpy(dst, src, width) ;
+
+        cairo_surface_mark_dirty(psurf) ;
+        return psurf ;
+    }
+
     psurf = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height) ;
 
     // this is needed to work with transparency
@@ -350,8 +499,15 @@ void Backend::flush() {
         cairo_set_source_surface(source_cr_, proxy_surf_, 0, 0);
         cairo_mask_surface(source_cr_, mask_->surf_, 0, 0) ;
         cairo_fill(source_cr_) ;
+
+        // drawing continues on the target surface
+        cairo_destroy(cr_) ;
+        cr_ = source_cr_ ;
+        state_.top().stroke_dirty_ = StrokeDirtyAll ;
+
         cairo_surface_destroy(proxy_surf_) ;
         proxy_surf_ = nullptr ;
+        proxy_lease_.reset() ;
     }
 
     cairo_surface_flush(surf_) ;
@@ -372,24 +528,27 @@ Backend::~Backend() {
 } // namespace detail
 
 void Canvas::setPen(const Pen &pen) {
-    state_.top().pen_ = std::make_shared<Pen>(pen) ;
+    State &state = state_.top() ;
+    state.stroke_dirty_ |= detail::stroke_changes(pen, state.applied_pen_) ;
+    state.pen_ = pen ;
+    state.has_pen_ = true ;
 }
 
 void Canvas::setBrush(const SolidBrush &br) {
-    state_.top().brush_ = std::make_shared<SolidBrush>(br) ;
+    state_.top().brush_.set(br) ;
 }
 
 void Canvas::setBrush(const LinearGradientBrush &br) {
-    state_.top().brush_ = std::make_shared<LinearGradientBrush>(br) ;
+    state_.top().brush_.set(br) ;
 }
 
 
 void Canvas::setBrush(const RadialGradientBrush &br) {
-    state_.top().brush_ = std::make_shared<RadialGradientBrush>(br) ;
+    state_.top().brush_.set(br) ;
 }
 
 void Canvas::setBrush(const PatternBrush &br) {
-    state_.top().brush_ = std::make_shared<PatternBrush>(br) ;
+    state_.top().brush_.set(br) ;
 }
 
 void Canvas::save() {
@@ -402,30 +561,105 @@ void Canvas::restore() 	{
     state_.pop() ;
 }
 
+void Canvas::beginLayer(double opacity, const Rectangle2d &bounds) {
+    beginLayer(opacity, bounds, LayerFilter()) ;
+}
+
+void Canvas::beginLayer(double opacity, const Rectangle2d &bounds, const LayerFilter &filter) {
+    Layer layer ;
+    layer.opacity_ = std::max(opacity, 0.0) ;
+    layer.filter_ = filter ;
+    cairo_get_matrix(cr(), &layer.ctm_) ;
+
+    cairo_save(cr()) ;
+    state_.push(state_.top()) ;
+
+    // the group surface only covers the clip extents
+    if ( !bounds.empty() ) {
+        cairo_rectangle(cr(), bounds.x(), bounds.y(), bounds.width(), bounds.height()) ;
+        cairo_clip(cr()) ;
+    }
+
+    // an opaque layer needs no offscreen surface
+    layer.group_ = opacity < 1.0 || filter ;
+
+    if ( layer.group_ ) cairo_push_group(cr()) ;
+
+    layers_.emplace_back(std::move(layer)) ;
+}
+
+static void cairo_filter_group(cairo_pattern_t *group, const detail::Backend::Layer &layer) {
+    cairo_surface_t *surf ;
+
+    if ( cairo_pattern_get_surface(group, &surf) != CAIRO_STATUS_SUCCESS ||
+         cairo_surface_get_type(surf) != CAIRO_SURFACE_TYPE_IMAGE ||
+         cairo_image_surface_get_format(surf) != CAIRO_FORMAT_ARGB32 ) return ;
+
+    cairo_surface_flush(surf) ;
+
+    // pixel = device + offset for group surfaces
+    double ox, oy ;
+    cairo_surface_get_device_offset(surf, &ox, &oy) ;
+
+    const cairo_matrix_t &m = layer.ctm_ ;
+    Matrix2d tr(m.xx, m.yx, m.xy, m.yy, m.x0 + ox, m.y0 + oy) ;
+
+    layer.filter_(cairo_image_surface_get_data(surf), cairo_image_surface_get_width(surf),
+                  cairo_image_surface_get_height(surf), cairo_image_surface_get_stride(surf), tr) ;
+
+    cairo_surface_mark_dirty(surf) ;
+}
+
+void Canvas::endLayer() {
+    assert( !layers_.empty() ) ;
+
+    const Layer &layer = layers_.back() ;
+
+    if ( layer.group_ ) {
+        cairo_pattern_t *group = cairo_pop_group(cr()) ;
+
+        if ( layer.filter_ ) cairo_filter_group(group, layer) ;
+
+        cairo_set_source(cr(), group) ;
+        if ( layer.opacity_ > 0 ) cairo_paint_with_alpha(cr(), layer.opacity_) ;
+        cairo_pattern_destroy(group) ;
+    }
+
+    layers_.pop_back() ;
+
+    cairo_restore(cr()) ;
+    state_.pop() ;
+}
+
 
 
 
 void Canvas::setFont(const Font &font) {
-    state_.top().font_ = font ;
+    state_.top().font_ = std::make_shared<Font>(font) ;
+}
+
+void Canvas::setTextRenderMode(TextRenderMode mode) {
+    state_.top().text_mode_ = mode ;
 }
 
 void Canvas::clearBrush() {
-    state_.top().brush_.reset() ;
+    state_.top().brush_.clear() ;
 }
 
 void Canvas::clearPen() {
-    state_.top().pen_.reset() ;
+    state_.top().has_pen_ = false ;
 }
 
 
 void Canvas::drawText(const std::string &text, double x0, double y0, double width, double height, unsigned int flags)
 {
-    const Font &f = state_.top().font_ ;
+    const Font &f = *state_.top().font_ ;
 
     cairo_scaled_font_t *scaled_font = FontManager::instance().createFont(f) ;
 
     TextLayout layout(text, f) ;
     layout.setWrapWidth(width) ;
+    layout.setJustify(flags & TextAlignJustify) ;
 
     layout.compute() ;
 
@@ -470,12 +704,7 @@ void Canvas::drawText(const std::string &text, double x0, double y0, double widt
 
         cairo_translate(cr(), x0 + tx, y0 + y + ty) ;
 
-        //      cairo_show_glyphs(cr_, cairo_glyphs, num_glyphs) ;
-        cairo_glyph_path(cr(), cairo_glyphs, num_glyphs);
-
-        cairo_fill(cr()) ;
-
-        //     fill_stroke_shape() ;
+        show_glyphs(cairo_glyphs, line.glyphs().data(), num_glyphs, f.size(), false) ;
 #if 0
         cairo_rectangle(cr_, 0, 0, layout.width(), -line.ascent_) ;
         cairo_rectangle(cr_, 0, 0, layout.width(), line.descent_) ;
@@ -506,7 +735,7 @@ void Canvas::drawText(const string &textStr, const Rectangle2d &r, unsigned int
 
 void Canvas::drawText(const std::string &text, double x0, double y0)
 {
-    const Font &f = state_.top().font_ ;
+    const Font &f = *state_.top().font_ ;
 
 
     TextLayout layout(text, f) ;
@@ -538,9 +767,7 @@ void Canvas::drawText(const std::string &text, double x0, double y0)
 
     cairo_translate(cr(), x0, y0) ;
 
-    cairo_glyph_path(cr(), cairo_glyphs, num_glyphs);
-
-    cairo_fill(cr()) ;
+    show_glyphs(cairo_glyphs, line.glyphs().data(), num_glyphs, f.size(), false) ;
 #if 0
     cairo_rectangle(cr_, 0, 0, layout.width(), -line.ascent_) ;
     cairo_rectangle(cr_, 0, 0, layout.width(), line.descent_) ;
@@ -562,7 +789,7 @@ void Canvas::drawText(const std::string &text, double x0, double y0)
 
 void Canvas::drawGlyphs(const vector<Glyph> &glyphs, const vector<Point2d> &gpos)
 {
-    const Font &f = state_.top().font_ ;
+    const Font &f = *state_.top().font_ ;
 
     cairo_scaled_font_t *scaled_font = FontManager::instance().createFont(f) ;
 
@@ -583,9 +810,52 @@ void Canvas::drawGlyphs(const vector<Glyph> &glyphs, const vector<Point2d> &gpos
 
     cairo_set_scaled_font(cr(), scaled_font) ;
 
-    cairo_glyph_path(cr(), cairo_glyphs, num_glyphs);
+    show_glyphs(cairo_glyphs, glyphs.data(), num_glyphs, f.size(), true) ;
+
+    cairo_restore(cr()) ;
+
+    // the stroke parameters applied by show_glyphs were undone by the restore
+    state_.top().stroke_dirty_ = StrokeDirtyAll ;
+
+    cairo_glyph_free(cairo_glyphs) ;
 
-    fill_stroke_shape();
+    cairo_scaled_font_destroy(scaled_font) ;
+}
+
+void Canvas::drawGlyphRuns(const GlyphRuns &runs, const double *origins, const Color *colors)
+{
+    const Font &f = *state_.top().font_ ;
+
+    size_t n = runs.size() ;
+    if ( n == 0 || runs.offsets_.size() != n + 1 ) return ;
+
+    cairo_scaled_font_t *scaled_font = FontManager::instance().createFont(f) ;
+
+    size_t num_glyphs = runs.glyphs_.size() ;
+    cairo_glyph_t *cairo_glyphs = cairo_glyph_allocate (num_glyphs + 1);
+
+    for ( size_t i=0 ; i<n ; i++ ) {
+        for ( size_t k = runs.offsets_[i] ; k < runs.offsets_[i+1] ; k++ ) {
+            cairo_glyphs[k].index = runs.glyphs_[k].index_ ;
+            cairo_glyphs[k].x = origins[2*i] + runs.positions_[k].x() ;
+            cairo_glyphs[k].y = origins[2*i+1] + runs.positions_[k].y() ;
+        }
+    }
+
+    cairo_save(cr()) ;
+
+    cairo_set_scaled_font(cr(), scaled_font) ;
+
+    // consecutive labels of the same color are painted together
+    size_t first = 0 ;
+    for ( size_t i=1 ; i<=n ; i++ ) {
+        if ( i < n && ( !colors || colors[i] == colors[first] ) ) continue ;
+
+        size_t start = runs.offsets_[first], end = runs.offsets_[i] ;
+        show_glyphs(cairo_glyphs + start, runs.glyphs_.data() + start, end - start, f.size(), false, colors ? &colors[first] : nullptr) ;
+
+        first = i ;
+    }
 
     cairo_restore(cr()) ;
 
@@ -608,10 +878,23 @@ void Canvas::setClipRect(const Rectangle2d &r)
 }
 
 void Canvas::setClipMask(const std::shared_ptr<Canvas> &mask) {
+    flush() ;
+
     mask_ = mask ;
-    proxy_surf_ = cairo_surface_create_similar(surf_, CAIRO_CONTENT_COLOR_ALPHA, width_, height_) ;
+
+    if ( cairo_surface_get_type(surf_) == CAIRO_SURFACE_TYPE_IMAGE ) {
+        // scratch surface from the pool with the same format as the target
+        int w = cairo_image_surface_get_width(surf_), h = cairo_image_surface_get_height(surf_) ;
+        proxy_lease_ = std::make_shared<SurfaceLease>(SurfacePool::instance().acquire(cairo_image_surface_get_format(surf_), w, h)) ;
+        proxy_surf_ = cairo_surface_reference(proxy_lease_->surface()) ;
+    }
+    else
+        proxy_surf_ = cairo_surface_create_similar(surf_, cairo_surface_get_content(surf_), width_, height_) ;
+
     cairo_t *cr = cairo_create(proxy_surf_) ;
     cr_ = cr ;
+    // fresh context with default stroke parameters
+    state_.top().stroke_dirty_ = StrokeDirtyAll ;
 }
 
 void Canvas::setClipRect(double x0, double y0, double w, double h)
@@ -632,6 +915,13 @@ void Canvas::setClipPath(const Path &p, FillRule rule)
     cairo_clip(cr()) ;
 }
 
+Rectangle2d Canvas::clipExtents()
+{
+    double x1, y1, x2, y2 ;
+    cairo_clip_extents(cr(), &x1, &y1, &x2, &y2) ;
+    return Rectangle2d({x1, y1}, {x2, y2}) ;
+}
+
 void Canvas::drawLine(double x0, double y0, double x1, double y1) {
     line_path(x0, y0, x1, y1) ;
     fill_stroke_shape() ;
@@ -667,6 +957,73 @@ void Canvas::drawPath(const Path &p) {
     fill_stroke_shape() ;
 }
 
+// vector backends keep the geometry, cached masks would be embedded as images
+
+static bool is_vector_surface(cairo_surface_t *surf) {
+    switch ( cairo_surface_get_type(surf) ) {
+    case CAIRO_SURFACE_TYPE_PDF:
+    case CAIRO_SURFACE_TYPE_PS:
+    case CAIRO_SURFACE_TYPE_SVG:
+    case CAIRO_SURFACE_TYPE_RECORDING:
+    case CAIRO_SURFACE_TYPE_SCRIPT:
+        return true ;
+    default:
+        return false ;
+    }
+}
+
+void Canvas::drawPath(const CachedPath &p)
+{
+    const State &state = state_.top() ;
+
+    CachedPathData &data = CachedPathData::get(p) ;
+    bool use_masks = !is_vector_surface(cairo_get_target(cr())) ;
+
+    cairo_matrix_t dev ;
+    cairo_get_matrix(cr(), &dev) ;
+
+    double mx, my ;
+
+    if ( state.brush_ ) {
+        cairo_fill_rule_t rule = ( state.brush_.fill_rule_ == FillRule::NonZero ) ? CAIRO_FILL_RULE_WINDING : CAIRO_FILL_RULE_EVEN_ODD ;
+
+        cairo_save(cr()) ;
+
+        if ( const CachedPathData::Mask *mask = use_masks ? data.fillMask(p, dev, rule, mx, my) : nullptr ) {
+            // the source is locked to the current user space before switching to device space
+            set_cairo_fill(state.brush_) ;
+            cairo_identity_matrix(cr()) ;
+            cairo_mask_surface(cr(), mask->surf_, mx, my) ;
+        } else {
+            cairo_push_transform(cr(), p.transform()) ;
+            path(p.path()) ;
+            set_cairo_fill(state.brush_) ;
+            cairo_fill(cr()) ;
+        }
+
+        cairo_restore(cr()) ;
+    }
+
+    if ( const Pen *pen = p.pen() ) {
+        const Color &clr = pen->lineColor() ;
+
+        cairo_save(cr()) ;
+
+        if ( const CachedPathData::Mask *mask = use_masks ? data.strokeMask(p, dev, mx, my) : nullptr ) {
+            cairo_set_source_rgba(cr(), clr.r(), clr.g(), clr.b(), clr.a()) ;
+            cairo_identity_matrix(cr()) ;
+            cairo_mask_surface(cr(), mask->surf_, mx, my) ;
+        } else {
+            cairo_push_transform(cr(), p.transform()) ;
+            path(p.path()) ;
+            set_cairo_stroke(*pen) ;
+            cairo_stroke(cr()) ;
+        }
+
+        cairo_restore(cr()) ;
+    }
+}
+
 void Canvas::drawCircle(double cx, double cy, double r)
 {
     cairo_arc (cr(), cx, cy, r, 0.0, 2*M_PI) ;
@@ -677,6 +1034,151 @@ void Canvas::drawCircle(const Point2d &center, double r) {
     drawCircle(center.x(), center.y(), r) ;
 }
 
+// shapes are flushed in chunks to bound memory and tessellation cost, and whenever the item color changes
+static const int max_batch_size = 8192 ;
+
+template<class Add, class Flush>
+static void batch_items(int n, const Color *colors, Add add, Flush flush)
+{
+    PathBatch batch ;
+    int first = 0 ;
+
+    for( int i=0 ; i<n ; i++ ) {
+        if ( i - first == max_batch_size || ( colors && colors[i] != colors[first] ) ) {
+            flush(batch.path(), colors ? &colors[first] : nullptr) ;
+            batch.clear() ;
+            first = i ;
+        }
+        add(batch, i) ;
+    }
+
+    if ( n > first ) flush(batch.path(), colors ? &colors[first] : nullptr) ;
+}
+
+void Canvas::drawCircles(const double *pts, int n, double r, const Color *colors)
+{
+    batch_items(n, colors,
+                [&](PathBatch &b, int i) { b.addCircle(pts[2*i], pts[2*i+1], r) ; },
+                [&](const cairo_path_t *p, const Color *clr) { fill_stroke_batch(p, clr, true) ; }) ;
+}
+
+void Canvas::drawCircles(const double *pts, const double *radii, int n, const Color *colors)
+{
+    batch_items(n, colors,
+                [&](PathBatch &b, int i) { b.addCircle(pts[2*i], pts[2*i+1], radii[i]) ; },
+                [&](const cairo_path_t *p, const Color *clr) { fill_stroke_batch(p, clr, true) ; }) ;
+}
+
+void Canvas::drawRects(const double *rects, int n, const Color *colors)
+{
+    batch_items(n, colors,
+                [&](PathBatch &b, int i) { b.addRect(rects[4*i], rects[4*i+1], rects[4*i+2], rects[4*i+3]) ; },
+                [&](const cairo_path_t *p, const Color *clr) { fill_stroke_batch(p, clr, true) ; }) ;
+}
+
+void Canvas::drawLines(const double *segments, int n, const Color *colors)
+{
+    batch_items(n, colors,
+                [&](PathBatch &b, int i) { b.addLine(segments[4*i], segments[4*i+1], segments[4*i+2], segments[4*i+3]) ; },
+                [&](const cairo_path_t *p, const Color *clr) { fill_stroke_batch(p, clr, false) ; }) ;
+}
+
+void Canvas::drawMarkers(const double *pts, int n, const Path &marker, double size, const Color *colors)
+{
+    const cairo_path_t *mp = PathData::cairoPath(marker) ;
+
+    batch_items(n, colors,
+                [&](PathBatch &b, int i) { b.addPath(mp, pts[2*i], pts[2*i+1], size) ; },
+                [&](const cairo_path_t *p, const Color *clr) { fill_stroke_batch(p, clr, true) ; }) ;
+}
+
+void Canvas::drawMarkers(const double *pts, const double *sizes, int n, const Path &marker, const Color *colors)
+{
+    const cairo_path_t *mp = PathData::cairoPath(marker) ;
+
+    batch_items(n, colors,
+                [&](PathBatch &b, int i) { b.addPath(mp, pts[2*i], pts[2*i+1], sizes[i]) ; },
+                [&](const cairo_path_t *p, const Color *clr) { fill_stroke_batch(p, clr, true) ; }) ;
+}
+
+void Canvas::drawMarkers(const double *pts, int n, MarkerShape shape, double size)
+{
+    const State &state = state_.top() ;
+
+    if ( !markers_ ) markers_.reset(new MarkerAtlas) ;
+
+    cairo_matrix_t m ;
+    cairo_get_matrix(cr(), &m) ;
+
+    // sprites are used only for raster targets and transformations without rotation or non-uniform scaling
+    MarkerAtlas::Key key ;
+    const BrushState &br = state.brush_ ;
+
+    Color fill = br.color_ ;
+    fill.setAlpha(fill.a() * br.opacity_) ;
+
+    bool use_sprites = cairo_surface_get_type(cairo_get_target(cr())) == CAIRO_SURFACE_TYPE_IMAGE &&
+            m.xy == 0 && m.yx == 0 && m.xx == m.yy && m.xx > 0 &&
+            ( br.type_ == BrushState::None || br.type_ == BrushState::Solid ) &&
+            markers_->makeKey(key, shape, size, m.xx, state.pen(), br ? &fill : nullptr) ;
+
+    if ( !use_sprites ) {
+        drawMarkers(pts, n, markerPath(shape), size) ;
+        return ;
+    }
+
+    const int steps = MarkerAtlas::subpixel_steps ;
+
+    // sprites of this marker indexed by subpixel bucket
+    const MarkerAtlas::Sprite *sprites[steps * steps] = { nullptr } ;
+    unsigned int generation = markers_->generation() ;
+
+    cairo_pattern_t *pattern = cairo_pattern_create_for_surface(markers_->surface()) ;
+    cairo_pattern_set_filter(pattern, CAIRO_FILTER_NEAREST) ;
+
+    cairo_save(cr()) ;
+    cairo_identity_matrix(cr()) ;
+
+    for( int i=0 ; i<n ; i++ ) {
+        double qx = floor((m.xx * pts[2*i] + m.x0) * steps + 0.5) ;
+        double qy = floor((m.yy * pts[2*i+1] + m.y0) * steps + 0.5) ;
+
+        double ix = floor(qx / steps), iy = floor(qy / steps) ;
+
+        key.bx_ = static_cast<int>(qx - ix * steps) ;
+        key.by_ = static_cast<int>(qy - iy * steps) ;
+
+        const MarkerAtlas::Sprite *&sprite = sprites[key.by_ * steps + key.bx_] ;
+
+        if ( !sprite ) {
+            const MarkerAtlas::Sprite *s = markers_->get(key) ;
+            if ( !s ) continue ;
+
+            // the atlas was flushed
+            if ( markers_->generation() != generation ) {
+                std::fill(sprites, sprites + steps * steps, nullptr) ;
+                generation = markers_->generation() ;
+            }
+
+            sprite = s ;
+        }
+
+        double ox = ix - sprite->cx_, oy = iy - sprite->cy_ ;
+
+        cairo_matrix_t pm ;
+        cairo_matrix_init_translate(&pm, sprite->x_ - ox, sprite->y_ - oy) ;
+        cairo_pattern_set_matrix(pattern, &pm) ;
+        cairo_set_source(cr(), pattern) ;
+
+        cairo_rectangle(cr(), ox, oy, sprite->w_, sprite->h_) ;
+        cairo_fill(cr()) ;
+    }
+
+    cairo_restore(cr()) ;
+
+    cairo_pattern_destroy(pattern) ;
+}
+
 #define SVG_ARC_MAGIC ((double) 0.5522847498)
 
 static void cairo_elliptical_arc_to(cairo_t *cr, double x2, double y2)
@@ -746,8 +1248,22 @@ Canvas::~Canvas()
 
 }
 
-ImageCanvas::ImageCanvas(double w, double h, double dpi): Canvas(w, h, dpi, dpi) {
-    surf_ = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h) ;
+static cairo_format_t cairo_pixel_format(PixelFormat fmt) {
+    switch ( fmt ) {
+    case PixelFormat::RGB24:
+        return CAIRO_FORMAT_RGB24 ;
+    case PixelFormat::A8:
+        return CAIRO_FORMAT_A8 ;
+    case PixelFormat::RGB16_565:
+        return CAIRO_FORMAT_RGB16_565 ;
+    default:
+        return CAIRO_FORMAT_ARGB32 ;
+    }
+}
+
+ImageCanvas::ImageCanvas(double w, double h, double dpi, PixelFormat fmt): Canvas(w, h, dpi, dpi), format_(fmt) {
+    surf_lease_ = std::make_shared<SurfaceLease>(SurfacePool::instance().acquire(cairo_pixel_format(fmt), w, h)) ;
+    surf_ = cairo_surface_reference(surf_lease_->surface()) ;
     source_cr_ = cairo_create(surf_) ;
     init() ;
 }
@@ -762,7 +1278,12 @@ Image ImageCanvas::getImage()
     unsigned src_stride = cairo_image_surface_get_stride(surf_) ;
     cairo_format_t src_format = cairo_image_surface_get_format(surf_) ;
 
-    Image im(width, height, ImageFormat::ARGB32) ;
+    ImageFormat fmt ;
+    if ( src_format == CAIRO_FORMAT_A8 ) fmt = ImageFormat::A8 ;
+    else if ( src_format == CAIRO_FORMAT_RGB24 || src_format == CAIRO_FORMAT_RGB16_565 ) fmt = ImageFormat::RGB24 ;
+    else fmt = ImageFormat::ARGB32 ;
+
+    Image im(width, height, fmt) ;
 
     unsigned dst_stride = im.stride() ;
     char *dst, *p, *q ;
@@ -782,11 +1303,108 @@ Image ImageCanvas::getImage()
             }
         }
     }
+    else if ( src_format == CAIRO_FORMAT_RGB24 ) {
+        for( i=0 ; i<height ; i++, dst += dst_stride, src += src_stride ) {
+            const uint32_t *sp = (const uint32_t *)src ;
+            for( j=0, q=dst ; j<width ; j++ ) {
+                uint32_t v = *sp++ ;
+                *q++ = ( v >> 16 ) & 0xff ; *q++ = ( v >> 8 ) & 0xff ; *q++ = v & 0xff ;
+            }
+        }
+    }
+    else if ( src_format == CAIRO_FORMAT_RGB16_565 ) {
+        for( i=0 ; i<height ; i++, dst += dst_stride, src += src_stride ) {
+            const uint16_t *sp = (const uint16_t *)src ;
+            for( j=0, q=dst ; j<width ; j++ ) {
+                uint16_t v = *sp++ ;
+                unsigned r = ( v >> 11 ) & 0x1f, g = ( v >> 5 ) & 0x3f, b = v & 0x1f ;
+                // replicate the high bits so that full intensity maps to 255
+                *q++ = ( r << 3 ) | ( r >> 2 ) ; *q++ = ( g << 2 ) | ( g >> 4 ) ; *q++ = ( b << 3 ) | ( b >> 2 ) ;
+            }
+        }
+    }
+    else if ( src_format == CAIRO_FORMAT_A8 ) {
+        for( i=0 ; i<height ; i++, dst += dst_stride, src += src_stride )
+            memcpy(dst, src, width) ;
+    }
 
     return im ;
 
 }
 
+void ImageCanvas::saveToPng(const std::string &fname) {
+    flush() ;
+    cairo_surface_write_to_png(surf_, fname.c_str()) ;
+}
+
+void ImageCanvas::invalidate(const Rectangle2d &r)
+{
+    // snap to pixels and clamp to the image
+    double x0 = std::max(floor(r.x()), 0.0), y0 = std::max(floor(r.y()), 0.0) ;
+    double x1 = std::min(ceil(r.x() + r.width()), width_), y1 = std::min(ceil(r.y() + r.height()), height_) ;
+
+    if ( r.empty() || x1 <= x0 || y1 <= y0 ) return ;
+
+    Rectangle2d m(x0, y0, x1 - x0, y1 - y0) ;
+
+    // merge with overlapping dirty regions
+    for( size_t i=0 ; i<dirty_.size() ; ) {
+        if ( dirty_[i].intersects(m) ) {
+            m = m.united(dirty_[i]) ;
+            dirty_.erase(dirty_.begin() + i) ;
+            i = 0 ;
+        }
+        else ++i ;
+    }
+
+    dirty_.push_back(m) ;
+}
+
+void ImageCanvas::invalidateAll()
+{
+    dirty_.assign(1, Rectangle2d(0, 0, width_, height_)) ;
+}
+
+std::vector<Rectangle2d> ImageCanvas::redraw(const DisplayList &content)
+{
+    std::vector<Rectangle2d> rects ;
+    rects.swap(dirty_) ;
+
+    if ( rects.empty() ) return rects ;
+
+    save() ;
+
+    cairo_identity_matrix(cr()) ;
+
+    cairo_new_path(cr()) ;
+    for( const auto &r: rects )
+        cairo_rectangle(cr(), r.x(), r.y(), r.width(), r.height()) ;
+
+    cairo_set_operator(cr(), CAIRO_OPERATOR_CLEAR) ;
+    cairo_fill(cr()) ;
+    cairo_set_operator(cr(), CAIRO_OPERATOR_OVER) ;
+
+    // clips to the dirty regions and skips commands outside them
+    content.replay(*this, rects) ;
+
+    restore() ;
+
+    return rects ;
+}
+
+std::vector<Rectangle2d> ImageCanvas::update(const DisplayList &content)
+{
+    if ( !has_content_ ) invalidateAll() ;
+    else {
+        for( const auto &r: DisplayList::diff(content_, content) )
+            invalidate(r) ;
+    }
+
+    content_ = content ;
+    has_content_ = true ;
+
+    return redraw(content) ;
+}
 
 void Canvas::drawImage(const Image &im,  double opacity )
 {
@@ -795,6 +1413,7 @@ void Canvas::drawImage(const Image &im,  double opacity )
     cairo_save(cr()) ;
 
     cairo_set_source_surface(cr(), (cairo_surface_t *)imsurf, 0, 0);
+    state_.top().stroke_dirty_ |= StrokeDirtyColor ;
 
     cairo_paint_with_alpha (cr(), opacity);
 
@@ -823,5 +1442,153 @@ PatternCanvas::PatternCanvas(double width, double height): Canvas(width, height,
     source_cr_ = cairo_create(surf_) ;
 }
 
+namespace detail {
+struct OutputStream {
+    OutputWriter writer_ ;
+    bool failed_ = false ;
+} ;
+}
+
+DocumentCanvas::DocumentCanvas(double width, double height): Canvas(width, height, 72, 72) {
+}
+
+DocumentCanvas::~DocumentCanvas() {
+    finish() ;
+}
+
+void DocumentCanvas::create_stream(const OutputWriter &writer) {
+    stream_.reset(new detail::OutputStream) ;
+    stream_->writer_ = writer ;
+}
+
+void DocumentCanvas::create_stream(int fd) {
+    create_stream([fd](const char *data, size_t len) {
+        while ( len > 0 ) {
+#ifdef _WIN32
+            int n = _write(fd, data, len) ;
+#else
+            ssize_t n = ::write(fd, data, len) ;
+#endif
+            if ( n < 0 ) {
+                if ( errno == EINTR ) continue ;
+                return false ;
+            }
+            data += n ; len -= n ;
+        }
+        return true ;
+    }) ;
+}
+
+cairo_status_t DocumentCanvas::write_cb(void *closure, const unsigned char *data, unsigned int length) {
+    detail::OutputStream *strm = static_cast<detail::OutputStream *>(closure) ;
+
+    if ( strm->failed_ ) return CAIRO_STATUS_WRITE_ERROR ;
+
+    if ( !strm->writer_((const char *)data, length) ) {
+        strm->failed_ = true ;
+        return CAIRO_STATUS_WRITE_ERROR ;
+    }
+
+    return CAIRO_STATUS_SUCCESS ;
+}
+
+void DocumentCanvas::finish() {
+    if ( finished_ ) return ;
+
+    // the stream has to outlive the surface so the surface is finished here and not in the backend destructor
+    flush() ;
+    cairo_surface_finish(surf_) ;
+    finished_ = true ;
+}
+
+bool DocumentCanvas::hasError() const {
+    return ( stream_ && stream_->failed_ ) || cairo_surface_status(surf_) != CAIRO_STATUS_SUCCESS ;
+}
+
+void DocumentCanvas::show_page() {
+    // emits the page to the output, the graphics state is kept for the next page
+    flush() ;
+    cairo_show_page(source_cr_) ;
+}
+
+PDFCanvas::PDFCanvas(const string &fname, double width, double height): DocumentCanvas(width, height) {
+    surf_ = cairo_pdf_surface_create(fname.c_str(), width, height) ;
+    source_cr_ = cairo_create(surf_) ;
+    init() ;
+}
+
+PDFCanvas::PDFCanvas(int fd, double width, double height): DocumentCanvas(width, height) {
+    create_stream(fd) ;
+    surf_ = cairo_pdf_surface_create_for_stream(write_cb, stream_.get(), width, height) ;
+    source_cr_ = cairo_create(surf_) ;
+    init() ;
+}
+
+PDFCanvas::PDFCanvas(const OutputWriter &writer, double width, double height): DocumentCanvas(width, height) {
+    create_stream(writer) ;
+    surf_ = cairo_pdf_surface_create_for_stream(write_cb, stream_.get(), width, height) ;
+    source_cr_ = cairo_create(surf_) ;
+    init() ;
+}
+
+void PDFCanvas::newPage() {
+    show_page() ;
+}
+
+void PDFCanvas::newPage(double width, double height) {
+    show_page() ;
+    cairo_pdf_surface_set_size(surf_, width, height) ;
+    width_ = width ; height_ = height ;
+}
+
+PSCanvas::PSCanvas(const string &fname, double width, double height): DocumentCanvas(width, height) {
+    surf_ = cairo_ps_surface_create(fname.c_str(), width, height) ;
+    source_cr_ = cairo_create(surf_) ;
+    init() ;
+}
+
+PSCanvas::PSCanvas(int fd, double width, double height): DocumentCanvas(width, height) {
+    create_stream(fd) ;
+    surf_ = cairo_ps_surface_create_for_stream(write_cb, stream_.get(), width, height) ;
+    source_cr_ = cairo_create(surf_) ;
+    init() ;
+}
+
+PSCanvas::PSCanvas(const OutputWriter &writer, double width, double height): DocumentCanvas(width, height) {
+    create_stream(writer) ;
+    surf_ = cairo_ps_surface_create_for_stream(write_cb, stream_.get(), width, height) ;
+    source_cr_ = cairo_create(surf_) ;
+    init() ;
+}
+
+void PSCanvas::newPage() {
+    show_page() ;
+}
+
+void PSCanvas::newPage(double width, double height) {
+    show_page() ;
+    cairo_ps_surface_set_size(surf_, width, height) ;
+    width_ = width ; height_ = height ;
+}
+
+SVGCanvas::SVGCanvas(const string &fname, double width, double height): DocumentCanvas(width, height) {
+    surf_ = cairo_svg_surface_create(fname.c_str(), width, height) ;
+    source_cr_ = cairo_create(surf_) ;
+    init() ;
+}
+
+SVGCanvas::SVGCanvas(int fd, double width, double height): DocumentCanvas(width, height) {
+    create_stream(fd) ;
+    surf_ = cairo_svg_surface_create_for_stream(write_cb, stream_.get(), width, height) ;
+    source_cr_ = cairo_create(surf_) ;
+    init() ;
+}
+
+SVGCanvas::SVGCanvas(const OutputWriter &writer, double width, double height): DocumentCanvas(width, height) {
+    create_stream(writer) ;
+    surf_ = cairo_svg_surface_create_for_stream(write_cb, stream_.get(), width, height) ;
+    source_cr_ = cairo_create(surf_) ;
+    init() ;
+}
 
 } // namespace xg
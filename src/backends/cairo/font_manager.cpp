@@ -1,10 +1,31 @@
 #include "font_manager.hpp"
 
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <sys/stat.h>
+#include <cmath>
+
 using namespace std ;
 using namespace xg ;
 
-string FontManager::font_face_key(const string &family_name, FontStyle font_style, FontWeight font_weight) {
-    string key = family_name  + '-' ;
+// family names without surrounding white space, as given in lists like "Arial, sans-serif"
+
+static string trim(const string &s) {
+    size_t first = s.find_first_not_of(" \t\r\n") ;
+    if ( first == string::npos ) return string() ;
+    size_t last = s.find_last_not_of(" \t\r\n") ;
+    return s.substr(first, last - first + 1) ;
+}
+
+// fontconfig family names are case insensitive, so are the keys
+
+string FontManager::font_face_key(const string &family_name, FontStyle font_style, int font_weight, int font_stretch) {
+    string key ;
+    for( char c: trim(family_name) ) key += static_cast<char>(tolower(static_cast<unsigned char>(c))) ;
+    key += '-' ;
 
     switch ( font_style )
     {
@@ -19,15 +40,7 @@ string FontManager::font_face_key(const string &family_name, FontStyle font_styl
         break ;
     }
 
-    switch ( font_weight )
-    {
-    case FontWeight::Normal:
-        key += "normal" ;
-        break ;
-    case FontWeight::Bold:
-        key += "bold" ;
-        break ;
-    }
+    key += to_string(font_weight) + '-' + to_string(font_stretch) ;
 
     return key ;
 }
@@ -39,19 +52,31 @@ static bool iequals(const string& a, const string& b) {
     if (b.size() != sz) return false;
 
     for (unsigned int i = 0; i < sz; ++i)
-        if (tolower(a[i]) != tolower(b[i]))
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i])))
             return false;
     return true;
 }
 
-cairo_font_face_t *FontManager::queryFace(const std::string &family_name, FontStyle font_style, FontWeight font_weight)
-{
-    string key = font_face_key(family_name, font_style, font_weight) ;
+FontCoverage::FontCoverage(FcCharSet *cs) {
+    if ( !cs ) return ;
+
+    FcChar32 map[FC_CHARSET_MAP_SIZE], next ;
 
-    cairo_font_face_t *face = find(key) ;
+    for( FcChar32 base = FcCharSetFirstPage(cs, map, &next) ; base != FC_CHARSET_DONE ; base = FcCharSetNextPage(cs, map, &next) ) {
+        uint32_t page = base >> 8 ;
+        if ( page >= index_.size() ) index_.resize(page + 1, -1) ;
+        index_[page] = pages_.size() ;
+
+        std::array<uint32_t, 8> bits ;
+        for( int k=0 ; k<8 ; k++ ) bits[k] = map[k] ;
+        pages_.push_back(bits) ;
+    }
+}
 
-    if ( face ) return face ;
+// fontconfig pattern of the font after configuration and default substitutions
 
+FcPattern *FontManager::make_pattern(const std::string &family_name, FontStyle font_style, int font_weight, int font_stretch)
+{
     FcPattern* pat = FcPatternCreate() ;
 
     FcPatternAddString(pat, FC_FAMILY, (const FcChar8*)(family_name.c_str()));
@@ -63,100 +88,526 @@ cairo_font_face_t *FontManager::queryFace(const std::string &family_name, FontSt
     else
         FcPatternAddInteger(pat, FC_SLANT, FC_SLANT_ROMAN) ;
 
-    if ( font_weight == FontWeight::Bold )
-        FcPatternAddInteger(pat, FC_WEIGHT, FC_WEIGHT_BOLD) ;
-    else
-        FcPatternAddInteger(pat, FC_WEIGHT, FC_WEIGHT_NORMAL) ;
+    // CSS (OpenType) weights are mapped to the fontconfig scale, stretch percentages are FC_WIDTH values
+    FcPatternAddInteger(pat, FC_WEIGHT, FcWeightFromOpenType(font_weight)) ;
+    FcPatternAddInteger(pat, FC_WIDTH, font_stretch) ;
 
     FcPatternAddBool(pat, FC_SCALABLE, FcTrue);
 
-
     cairo_font_options_t *font_options =  cairo_font_options_create ();
 
-
-    //cairo_font_options_set_antialias(font_options, CAIRO_ANTIALIAS_DEFAULT) ;
-
-
     cairo_font_options_set_antialias (font_options, CAIRO_ANTIALIAS_SUBPIXEL);
     cairo_font_options_set_hint_style (font_options, CAIRO_HINT_STYLE_FULL);
     cairo_font_options_set_hint_metrics (font_options, CAIRO_HINT_METRICS_ON);
     cairo_font_options_set_subpixel_order (font_options, CAIRO_SUBPIXEL_ORDER_RGB);
 
-    cairo_font_options_destroy (font_options);
-
     cairo_ft_font_options_substitute(font_options, pat) ;
 
+    cairo_font_options_destroy (font_options);
+
     FcConfigSubstitute(0, pat, FcMatchPattern);
     FcDefaultSubstitute(pat);
 
-    FcChar8* fontConfigFamilyNameAfterConfiguration;
-    FcPatternGetString(pat, FC_FAMILY, 0, &fontConfigFamilyNameAfterConfiguration);
+    return pat ;
+}
 
-    FcResult fontConfigResult;
-    FcPattern *resultPattern = FcFontMatch(0, pat, &fontConfigResult);
-    if (!resultPattern) // No match.
-        return 0;
+// identity of the face of a fontconfig match: font file, face index and the styles cairo synthesizes
 
-    FcChar8* fc_family_name_str;
-    FcPatternGetString(resultPattern, FC_FAMILY, 0, &fc_family_name_str);
-    string fc_family_name((char *)fc_family_name_str) ;
+string FontManager::face_id(FcPattern *pat)
+{
+    string id ;
 
-    if (!iequals(family_name, fc_family_name)
-            && !(iequals(family_name, "sans") || iequals(family_name, "sans-serif")
-              || iequals(family_name, "serif") || iequals(family_name, "monospace")
-              || iequals(family_name, "fantasy") || iequals(family_name, "cursive")))
-        face = nullptr ;
-    else
-        face = cairo_ft_font_face_create_for_pattern(resultPattern) ;
+    FcChar8 *file = nullptr ;
+    if ( FcPatternGetString(pat, FC_FILE, 0, &file) == FcResultMatch ) id = (const char *)file ;
 
-    cairo_font_options_destroy(font_options) ;
+    int index = 0 ;
+    FcPatternGetInteger(pat, FC_INDEX, 0, &index) ;
+    id += ':' + to_string(index) ;
 
-    FcPatternDestroy(pat) ;
+    FcBool embolden = FcFalse ;
+    FcPatternGetBool(pat, FC_EMBOLDEN, 0, &embolden) ;
+    if ( embolden ) id += ":b" ;
 
-    FcPatternDestroy(resultPattern) ;
+    FcMatrix *m = nullptr ;
+    if ( FcPatternGetMatrix(pat, FC_MATRIX, 0, &m) == FcResultMatch && m )
+        id += ":m" + to_string(m->xx) + ',' + to_string(m->xy) + ',' + to_string(m->yx) + ',' + to_string(m->yy) ;
 
-    save(key, face) ;
+    return id ;
+}
 
-    return face ;
+std::pair<string, int> FontManager::font_file(FcPattern *pat)
+{
+    FcChar8 *file = nullptr ;
+    int index = 0 ;
+
+    FcPatternGetString(pat, FC_FILE, 0, &file) ;
+    FcPatternGetInteger(pat, FC_INDEX, 0, &index) ;
+
+    return std::make_pair(file ? string((const char *)file) : string(), index) ;
 }
 
+FontManager::Synthesis FontManager::font_synthesis(FcPattern *pat)
+{
+    Synthesis syn ;
 
-cairo_scaled_font_t *FontManager::createFont(const Font &font)
+    FcBool embolden = FcFalse ;
+    FcPatternGetBool(pat, FC_EMBOLDEN, 0, &embolden) ;
+    syn.embolden_ = embolden ;
+
+    FcMatrix *m = nullptr ;
+    if ( FcPatternGetMatrix(pat, FC_MATRIX, 0, &m) == FcResultMatch && m ) {
+        syn.xx_ = m->xx ; syn.xy_ = m->xy ;
+        syn.yx_ = m->yx ; syn.yy_ = m->yy ;
+    }
+
+    return syn ;
+}
+
+FontManager::Synthesis FontManager::synthesis(cairo_font_face_t *face)
+{
+    std::lock_guard<std::mutex> g(mx_) ;
+    auto it = synthesis_.find(face) ;
+    return it == synthesis_.end() ? Synthesis() : it->second ;
+}
+
+cairo_font_face_t *FontManager::queryFace(const std::string &family, FontStyle font_style, int font_weight, int font_stretch)
+{
+    font_weight = std::max(1, std::min(font_weight, 1000)) ;
+    font_stretch = std::max(50, std::min(font_stretch, 200)) ;
+
+    string family_name = trim(family) ;
+    string key = font_face_key(family_name, font_style, font_weight, font_stretch) ;
+
+    cairo_font_face_t *face = nullptr ;
+
+    if ( find(key, face) ) return face ;
+
+    // match stored by a previous run (loadCache) or query fontconfig
+
+    FcPattern *resultPattern = nullptr ;
+    bool cached = false ;
+
+    {
+        std::lock_guard<std::mutex> g(mx_) ;
+        auto it = matches_.find(key) ;
+        if ( it != matches_.end() ) {
+            cached = true ;
+            if ( !it->second.empty() ) resultPattern = FcNameParse((const FcChar8 *)it->second.c_str()) ;
+        }
+    }
+
+    if ( !cached ) {
+        FcPattern *pat = make_pattern(family_name, font_style, font_weight, font_stretch) ;
+
+        FcResult fontConfigResult;
+        resultPattern = FcFontMatch(0, pat, &fontConfigResult);
+
+        FcPatternDestroy(pat) ;
+
+        if ( resultPattern ) {
+            FcChar8* fc_family_name_str;
+            FcPatternGetString(resultPattern, FC_FAMILY, 0, &fc_family_name_str);
+            string fc_family_name((char *)fc_family_name_str) ;
+
+            if (!iequals(family_name, fc_family_name)
+                    && !(iequals(family_name, "sans") || iequals(family_name, "sans-serif")
+                      || iequals(family_name, "serif") || iequals(family_name, "monospace")
+                      || iequals(family_name, "fantasy") || iequals(family_name, "cursive"))) {
+                FcPatternDestroy(resultPattern) ;
+                resultPattern = nullptr ;
+            }
+        }
+
+        string match ;
+
+        if ( resultPattern ) {
+            FcChar8 *str = FcNameUnparse(resultPattern) ;
+            if ( str ) {
+                match = (const char *)str ;
+                FcStrFree(str) ;
+            }
+        }
+
+        std::lock_guard<std::mutex> g(mx_) ;
+        matches_[key] = match ;
+    }
+
+    // requests resolving to the same font file and synthesized styles (e.g. weights 500 and 600 of a family with
+    // regular and bold faces only) share one face
+
+    string id ;
+    if ( resultPattern ) id = face_id(resultPattern) ;
+
+    std::lock_guard<std::mutex> g(mx_) ;
+
+    // failed lookups are stored too. Another thread may have resolved the same key meanwhile, keep its face.
+
+    auto it = cache_.find(key) ;
+    if ( it != cache_.end() ) {
+        if ( resultPattern ) FcPatternDestroy(resultPattern) ;
+        return it->second ;
+    }
+
+    if ( resultPattern ) {
+        auto fit = faces_.find(id) ;
+        if ( fit != faces_.end() ) face = fit->second ;
+        else {
+            face = cairo_ft_font_face_create_for_pattern(resultPattern) ;
+
+            FcCharSet *cs = nullptr ;
+            FcPatternGetCharSet(resultPattern, FC_CHARSET, 0, &cs) ;
+            coverage_[face] = std::make_shared<FontCoverage>(cs) ;
+            files_[face] = font_file(resultPattern) ;
+            synthesis_[face] = font_synthesis(resultPattern) ;
+
+            faces_.insert(std::make_pair(id, face)) ;
+        }
+
+        FcPatternDestroy(resultPattern) ;
+    }
+
+    cache_.insert(std::make_pair(key, face)) ;
+
+    return face ;
+}
+
+cairo_font_face_t *FontManager::findFace(const Font &font)
 {
     vector<string> q_family_names(font.familyNames()) ;
     q_family_names.emplace_back("serif") ; // fallback family (OS dependent)
 
     for( const auto &family: q_family_names ) {
-        cairo_font_face_t *face = FontManager::instance().queryFace(family, font.style(), font.weight()) ;
-        if ( face ) {
-            // create scaled font
+        if ( cairo_font_face_t *face = queryFace(family, font.style(), font.weight(), font.stretch()) )
+            return face ;
+    }
+
+    return nullptr ;
+}
+
+void FontManager::preload(const std::vector<Font> &fonts)
+{
+    if ( fonts.empty() ) return ;
+
+    // load the configuration and font caches once before matching from several threads
+    FcInit() ;
+
+    static const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency()) ;
+    size_t n_threads = std::min<size_t>(max_threads, fonts.size()) ;
+
+    std::atomic<size_t> next(0) ;
+
+    auto worker = [&]() {
+        for( size_t i ; ( i = next++ ) < fonts.size() ; )
+            findFace(fonts[i]) ;
+    } ;
+
+    vector<thread> threads ;
+    for( size_t k=1 ; k<n_threads ; k++ )
+        threads.emplace_back(worker) ;
+
+    worker() ;
+
+    for( auto &t: threads ) t.join() ;
+}
+
+// FNV-1a hash of the fontconfig version, configuration files and font directories with their modification times,
+// changes whenever fonts are installed or removed or the configuration is edited
+
+static void hash_bytes(uint64_t &h, const void *data, size_t n) {
+    const unsigned char *p = static_cast<const unsigned char *>(data) ;
+    for( size_t i=0 ; i<n ; i++ ) {
+        h ^= p[i] ;
+        h *= 1099511628211ull ;
+    }
+}
+
+static void hash_files(uint64_t &h, FcStrList *files) {
+    if ( !files ) return ;
+
+    while ( FcChar8 *file = FcStrListNext(files) ) {
+        hash_bytes(h, file, strlen((const char *)file)) ;
+
+        struct stat st ;
+        if ( stat((const char *)file, &st) == 0 ) {
+            int64_t mtime = st.st_mtime ;
+            hash_bytes(h, &mtime, sizeof(mtime)) ;
+        }
+    }
+
+    FcStrListDone(files) ;
+}
+
+string FontManager::config_hash()
+{
+    FcInit() ;
+
+    uint64_t h = 14695981039346656037ull ;
+
+    int version = FcGetVersion() ;
+    hash_bytes(h, &version, sizeof(version)) ;
+
+    hash_files(h, FcConfigGetConfigFiles(0)) ;
+    hash_files(h, FcConfigGetFontDirs(0)) ;
+
+    char buf[17] ;
+    snprintf(buf, 17, "%016llx", (unsigned long long)h) ;
+    return buf ;
+}
+
+static const char *cache_signature = "xg-font-cache-2" ;
+
+bool FontManager::loadCache(const std::string &path)
+{
+    ifstream strm(path.c_str()) ;
+    if ( !strm ) return false ;
 
-            cairo_matrix_t ctm, font_matrix;
-            cairo_font_options_t *font_options;
+    string line ;
+    if ( !getline(strm, line) || line != string(cache_signature) + ' ' + config_hash() ) return false ;
 
-            double font_size = font.size()  ;
+    std::lock_guard<std::mutex> g(mx_) ;
 
-            cairo_matrix_init_identity (&ctm);
-            cairo_matrix_init_scale (&font_matrix, font_size, font_size);
-            font_options = cairo_font_options_create ();
-            cairo_font_options_set_hint_style (font_options, CAIRO_HINT_STYLE_MEDIUM);
-            cairo_font_options_set_hint_metrics (font_options, CAIRO_HINT_METRICS_OFF);
+    // one "key<TAB>pattern" line per match, the pattern is empty when nothing matched
+    while ( getline(strm, line) ) {
+        size_t pos = line.find('\t') ;
+        if ( pos == string::npos ) continue ;
+        matches_.insert(std::make_pair(line.substr(0, pos), line.substr(pos + 1))) ;
+    }
+
+    return true ;
+}
 
-            cairo_scaled_font_t *scaled_font = cairo_scaled_font_create (face,
-                                                                 &font_matrix,
-                                                                 &ctm,
-                                                                 font_options);
+bool FontManager::saveCache(const std::string &path)
+{
+    // written to a temporary file and renamed so that concurrent readers never see a partial file
+    string tmp = path + ".tmp" ;
+
+    {
+        ofstream strm(tmp.c_str()) ;
+        if ( !strm ) return false ;
+
+        strm << cache_signature << ' ' << config_hash() << '\n' ;
+
+        std::lock_guard<std::mutex> g(mx_) ;
+        for( const auto &m: matches_ )
+            strm << m.first << '\t' << m.second << '\n' ;
+
+        if ( !strm ) return false ;
+    }
+
+    return std::rename(tmp.c_str(), path.c_str()) == 0 ;
+}
+
+bool FontManager::covers(cairo_font_face_t *face, uint32_t ch) {
+    std::lock_guard<std::mutex> g(mx_) ;
+    auto it = coverage_.find(face) ;
+    return it != coverage_.end() && it->second->covers(ch) ;
+}
+
+cairo_font_face_t *FontManager::fallbackFace(const Font &font, uint32_t ch)
+{
+    string family = font.familyNames().empty() ? string("serif") : trim(font.familyNames().front()) ;
 
-            cairo_font_options_destroy (font_options);
+    std::lock_guard<std::mutex> g(fallback_mx_) ;
 
-            if ( cairo_scaled_font_status(scaled_font) != CAIRO_STATUS_SUCCESS ) {
-                cairo_font_face_destroy (face);
-                return nullptr ;
+    FallbackList &fl = fallback_[font_face_key(family, font.style(), font.weight(), font.stretch())] ;
+
+    auto it = fl.chars_.find(ch) ;
+    if ( it != fl.chars_.end() ) return it->second ;
+
+    if ( !fl.pattern_ ) {
+        fl.pattern_ = make_pattern(family, font.style(), font.weight(), font.stretch()) ;
+
+        // trimmed so that fonts adding no coverage to the ones before them are skipped
+        FcResult result ;
+        fl.fonts_ = FcFontSort(0, fl.pattern_, FcTrue, nullptr, &result) ;
+        if ( fl.fonts_ ) {
+            fl.faces_.resize(fl.fonts_->nfont, nullptr) ;
+            fl.coverage_.resize(fl.fonts_->nfont) ;
+        }
+    }
+
+    cairo_font_face_t *face = nullptr ;
+
+    for( size_t k=0 ; k<fl.faces_.size() ; k++ ) {
+        if ( !fl.coverage_[k] ) {
+            FcCharSet *cs = nullptr ;
+            FcPatternGetCharSet(fl.fonts_->fonts[k], FC_CHARSET, 0, &cs) ;
+            fl.coverage_[k] = std::make_shared<FontCoverage>(cs) ;
+        }
+
+        if ( !fl.coverage_[k]->covers(ch) ) continue ;
+
+        if ( !fl.faces_[k] ) {
+            FcPattern *render = FcFontRenderPrepare(0, fl.pattern_, fl.fonts_->fonts[k]) ;
+            string id = face_id(render) ;
+
+            std::lock_guard<std::mutex> cg(mx_) ;
+
+            auto fit = faces_.find(id) ;
+            if ( fit != faces_.end() ) fl.faces_[k] = fit->second ;
+            else {
+                fl.faces_[k] = cairo_ft_font_face_create_for_pattern(render) ;
+                coverage_[fl.faces_[k]] = fl.coverage_[k] ;
+                files_[fl.faces_[k]] = font_file(render) ;
+                synthesis_[fl.faces_[k]] = font_synthesis(render) ;
+                faces_.insert(std::make_pair(id, fl.faces_[k])) ;
             }
 
-            return scaled_font ;
+            FcPatternDestroy(render) ;
         }
+
+        face = fl.faces_[k] ;
+        break ;
     }
 
-    return nullptr ;
+    fl.chars_[ch] = face ;
+
+    return face ;
+}
+
+ShapingFont::ShapingFont(cairo_scaled_font_t *scaled_font, hb_face_t *face, double size): scaled_font_(scaled_font) {
+    cairo_scaled_font_extents(scaled_font_, &extents_) ;
+
+    if ( face ) {
+        // same scale as hb_ft_font_create for a face set to this size (26.6 fixed point pixels)
+        hb_font_ = hb_font_create(face) ;
+        int scale = static_cast<int>(std::lround(size * 64)) ;
+        hb_font_set_scale(hb_font_, scale, scale) ;
+    }
+}
+
+ShapingFont::~ShapingFont() {
+    if ( hb_font_ ) hb_font_destroy(hb_font_) ;
+    cairo_scaled_font_destroy(scaled_font_) ;
+}
+
+const cairo_text_extents_t &ShapingFont::glyphExtents(unsigned int glyph) {
+    std::lock_guard<std::mutex> g(mutex_) ;
+
+    auto it = glyphs_.find(glyph) ;
+    if ( it != glyphs_.end() ) return it->second ;
+
+    cairo_text_extents_t &e = glyphs_[glyph] ;
+
+    hb_glyph_extents_t hb_extents ;
+    if ( hb_font_ && hb_font_get_glyph_extents(hb_font_, glyph, &hb_extents) ) {
+        // HarfBuzz extents have the y axis up
+        e.x_bearing = hb_extents.x_bearing / 64.0 ;
+        e.y_bearing = -hb_extents.y_bearing / 64.0 ;
+        e.width = hb_extents.width / 64.0 ;
+        e.height = -hb_extents.height / 64.0 ;
+        e.x_advance = e.y_advance = 0 ;
+    }
+    else {
+        cairo_glyph_t cg = { glyph, 0, 0 } ;
+        cairo_scaled_font_glyph_extents(scaled_font_, &cg, 1, &e) ;
+    }
+
+    return e ;
+}
+
+hb_face_t *FontManager::hbFace(cairo_font_face_t *face)
+{
+    std::lock_guard<std::mutex> g(mx_) ;
+
+    auto it = hb_faces_.find(face) ;
+    if ( it != hb_faces_.end() ) return it->second ;
+
+    hb_face_t *hb_face = nullptr ;
+
+    auto fit = files_.find(face) ;
+    if ( fit != files_.end() && !fit->second.first.empty() ) {
+        if ( hb_blob_t *blob = hb_blob_create_from_file(fit->second.first.c_str()) ) {
+            // the upper bits of a fontconfig index select a named instance of a variable font, not supported here
+            if ( ( fit->second.second >> 16 ) == 0 )
+                hb_face = hb_face_create(blob, fit->second.second) ;
+            hb_blob_destroy(blob) ;
+
+            // missing or unreadable files give an empty face
+            if ( hb_face && hb_face_get_glyph_count(hb_face) == 0 ) {
+                hb_face_destroy(hb_face) ;
+                hb_face = nullptr ;
+            }
+        }
+    }
+
+    hb_faces_[face] = hb_face ;
+    return hb_face ;
+}
+
+std::shared_ptr<ShapingFont> FontManager::shapingFont(const Font &font)
+{
+    cairo_font_face_t *face = findFace(font) ;
+
+    return face ? shapingFont(face, font.size()) : nullptr ;
+}
+
+std::shared_ptr<ShapingFont> FontManager::shapingFont(cairo_font_face_t *face, double size)
+{
+    std::lock_guard<std::mutex> g(shaping_mx_) ;
+
+    auto key = std::make_pair(face, size) ;
+
+    auto it = shaping_.find(key) ;
+    if ( it != shaping_.end() ) return it->second ;
+
+    // fonts still in use are kept alive by their users
+    if ( shaping_.size() >= max_shaping_fonts ) shaping_.clear() ;
+
+    cairo_scaled_font_t *scaled_font = createFont(face, size) ;
+    if ( !scaled_font ) return nullptr ;
+
+    std::shared_ptr<ShapingFont> font = std::make_shared<ShapingFont>(scaled_font, hbFace(face), size) ;
+    shaping_.insert(std::make_pair(key, font)) ;
+
+    return font ;
+}
+
+cairo_scaled_font_t *FontManager::createFont(const Font &font)
+{
+    cairo_font_face_t *face = findFace(font) ;
+
+    return face ? createFont(face, font.size()) : nullptr ;
+}
+
+cairo_scaled_font_t *FontManager::createFont(cairo_font_face_t *face, double font_size)
+{
+    cairo_matrix_t ctm, font_matrix;
+    cairo_font_options_t *font_options;
+
+    cairo_matrix_init_identity (&ctm);
+    cairo_matrix_init_scale (&font_matrix, font_size, font_size);
+    font_options = cairo_font_options_create ();
+    cairo_font_options_set_hint_style (font_options, CAIRO_HINT_STYLE_MEDIUM);
+    cairo_font_options_set_hint_metrics (font_options, CAIRO_HINT_METRICS_OFF);
+
+    cairo_scaled_font_t *scaled_font = cairo_scaled_font_create (face,
+                                                         &font_matrix,
+                                                         &ctm,
+                                                         font_options);
+
+    cairo_font_options_destroy (font_options);
+
+    if ( cairo_scaled_font_status(scaled_font) != CAIRO_STATUS_SUCCESS ) {
+        cairo_scaled_font_destroy (scaled_font);
+        return nullptr ;
+    }
+
+    return scaled_font ;
+}
+
+namespace xg {
+
+void preloadFonts(const std::vector<Font> &fonts) {
+    FontManager::instance().preload(fonts) ;
+}
+
+bool loadFontCache(const std::string &path) {
+    return FontManager::instance().loadCache(path) ;
+}
+
+bool saveFontCache(const std::string &path) {
+    return FontManager::instance().saveCache(path) ;
+}
+
 }
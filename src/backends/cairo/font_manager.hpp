@@ -4,22 +4,69 @@
 #include <xg/font.hpp>
 
 #include <cairo/cairo-ft.h>
+#include <fontconfig/fontconfig.h>
+#include <harfbuzz/hb.h>
 #include <mutex>
 #include <map>
+#include <vector>
+#include <array>
+#include <memory>
+#include <unordered_map>
 
-class FontManager {
+// Unicode coverage of a font as a two level bitmap (256 character pages) built from its fontconfig character set
+
+class FontCoverage {
 public:
+    FontCoverage(FcCharSet *cs) ;
 
-    cairo_font_face_t *find(const std::string &key) {
-        std::lock_guard<std::mutex> g(mx_) ;
-        std::map<std::string, cairo_font_face_t *>::const_iterator it = cache_.find(key) ;
-        if ( it != cache_.end() ) return it->second ;
-        else return 0 ;
+    bool covers(uint32_t ch) const {
+        uint32_t page = ch >> 8 ;
+        if ( page >= index_.size() || index_[page] < 0 ) return false ;
+        return pages_[index_[page]][( ch & 0xff ) >> 5] & ( 1u << ( ch & 0x1f ) ) ;
     }
 
-    void save(const std::string &key, cairo_font_face_t *face) {
+private:
+    std::vector<int> index_ ;                       // page number to index in pages_ or -1
+    std::vector<std::array<uint32_t, 8>> pages_ ;
+} ;
+
+// A scaled font kept by the manager with what is needed to shape and measure text with it: the font extents, a
+// HarfBuzz font reading the font file directly (no FreeType face to lock, so it may be used from several threads)
+// and the ink extents of the glyphs measured so far.
+
+class ShapingFont {
+public:
+    ShapingFont(cairo_scaled_font_t *scaled_font, hb_face_t *face, double size) ;
+    ~ShapingFont() ;
+
+    cairo_scaled_font_t *scaledFont() const { return scaled_font_ ; }
+
+    // nullptr if HarfBuzz cannot read the font file, text should then be shaped with the FreeType face
+    hb_font_t *hbFont() const { return hb_font_ ; }
+
+    const cairo_font_extents_t &extents() const { return extents_ ; }
+
+    // ink extents of a glyph relative to its origin in user units, y axis down (advances are not set)
+    const cairo_text_extents_t &glyphExtents(unsigned int glyph) ;
+
+private:
+    cairo_scaled_font_t *scaled_font_ ;
+    hb_font_t *hb_font_ = nullptr ;
+    cairo_font_extents_t extents_ ;
+    std::unordered_map<unsigned int, cairo_text_extents_t> glyphs_ ;
+    std::mutex mutex_ ;
+} ;
+
+class FontManager {
+public:
+
+    // cached face of a key, the face is null for failed lookups
+    bool find(const std::string &key, cairo_font_face_t *&face) {
         std::lock_guard<std::mutex> g(mx_) ;
-        cache_.insert(std::make_pair(key, face)) ;
+        std::map<std::string, cairo_font_face_t *>::const_iterator it = cache_.find(key) ;
+        if ( it == cache_.end() ) return false ;
+        face = it->second ;
+        return true ;
     }
 
     static FontManager &instance() {
@@ -28,20 +75,79 @@ public:
     }
 
     // Use FreeType library and FontConfig to query system for desired font
-    cairo_font_face_t *queryFace(const std::string &family_name, xg::FontStyle font_style, xg::FontWeight font_weight) ;
+    cairo_font_face_t *queryFace(const std::string &family_name, xg::FontStyle font_style, int font_weight, int font_stretch = 100) ;
+
+    // face of the first family of the font (or the serif fallback) found
+    cairo_font_face_t *findFace(const xg::Font &font) ;
 
     // Calls query face and if sucessfull scales the font found
     cairo_scaled_font_t *createFont(const xg::Font &font) ;
 
+    // scaled font of a face returned by the manager with the same options as above
+    cairo_scaled_font_t *createFont(cairo_font_face_t *face, double size) ;
+
+    // shared shaping font of the font or of a face at the given size, nullptr if no face is found
+    std::shared_ptr<ShapingFont> shapingFont(const xg::Font &font) ;
+    std::shared_ptr<ShapingFont> shapingFont(cairo_font_face_t *face, double size) ;
+
+    // HarfBuzz face reading the font file of a face returned by the manager, nullptr if not possible
+    hb_face_t *hbFace(cairo_font_face_t *face) ;
+
+    // styles cairo synthesizes for a face as set by fontconfig in the matched pattern (FC_EMBOLDEN, FC_MATRIX e.g.
+    // the shear of a synthetic oblique), none for faces not created by the manager
+    struct Synthesis {
+        bool embolden_ = false ;
+        double xx_ = 1, xy_ = 0, yx_ = 0, yy_ = 1 ;
+    } ;
+
+    Synthesis synthesis(cairo_font_face_t *face) ;
+
+    // whether the face has a glyph for the character, faces not created by the manager cover nothing
+    bool covers(cairo_font_face_t *face, uint32_t ch) ;
+
+    // Face for a character missing from the primary face of the font: the first font of the fontconfig fallback
+    // list of the font that covers it, or nullptr. Decisions are memoized per font and character.
+    cairo_font_face_t *fallbackFace(const xg::Font &font, uint32_t ch) ;
+
+    // resolve the faces of the fonts on several threads
+    void preload(const std::vector<xg::Font> &fonts) ;
+
+    // fontconfig matches persisted across runs, valid only for the configuration hash they were saved with
+    bool loadCache(const std::string &path) ;
+    bool saveCache(const std::string &path) ;
+
 private:
 
     FontManager() = default ;
 
-    static std::string font_face_key(const std::string &family_name, xg::FontStyle font_style, xg::FontWeight font_weight) ;
+    static std::string font_face_key(const std::string &family_name, xg::FontStyle font_style, int font_weight, int font_stretch) ;
+    static FcPattern *make_pattern(const std::string &family_name, xg::FontStyle font_style, int font_weight, int font_stretch) ;
+    static std::string config_hash() ;
+    static std::string face_id(FcPattern *pat) ;
+    static std::pair<std::string, int> font_file(FcPattern *pat) ;
+    static Synthesis font_synthesis(FcPattern *pat) ;
+
+    static const size_t max_shaping_fonts = 256 ;
 
+    // fonts sorted by fontconfig for a pattern, faces and coverage are created on first use
+    struct FallbackList {
+        FcPattern *pattern_ = nullptr ;
+        FcFontSet *fonts_ = nullptr ;
+        std::vector<cairo_font_face_t *> faces_ ;
+        std::vector<std::shared_ptr<FontCoverage>> coverage_ ;
+        std::unordered_map<uint32_t, cairo_font_face_t *> chars_ ;
+    } ;
 
     std::map<std::string, cairo_font_face_t *> cache_ ;
-    std::mutex mx_ ;
+    std::map<std::string, cairo_font_face_t *> faces_ ;     // faces by face_id
+    std::map<std::string, std::string> matches_ ;   // unparsed fontconfig match of each key, empty if none
+    std::map<cairo_font_face_t *, std::shared_ptr<FontCoverage>> coverage_ ;
+    std::map<cairo_font_face_t *, std::pair<std::string, int>> files_ ;    // font file and face index
+    std::map<cairo_font_face_t *, Synthesis> synthesis_ ;
+    std::map<cairo_font_face_t *, hb_face_t *> hb_faces_ ;
+    std::map<std::string, FallbackList> fallback_ ;
+    std::map<std::pair<cairo_font_face_t *, double>, std::shared_ptr<ShapingFont>> shaping_ ;
+    std::mutex mx_, fallback_mx_, shaping_mx_ ;
 
 
 
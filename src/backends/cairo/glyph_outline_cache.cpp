@@ -0,0 +1,156 @@
+#include "glyph_outline_cache.hpp"
+#include "font_manager.hpp"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+
+using namespace std ;
+
+namespace xg {
+
+GlyphOutlineCache &GlyphOutlineCache::instance() {
+    static GlyphOutlineCache s_instance ;
+    return s_instance ;
+}
+
+void GlyphOutlineCache::clear() {
+    lock_guard<mutex> g(mutex_) ;
+    faces_.clear() ;
+}
+
+GlyphOutlineCache::Face &GlyphOutlineCache::face(cairo_font_face_t *font_face, cairo_scaled_font_t *scaled_font) {
+    auto it = faces_.find(font_face) ;
+    if ( it != faces_.end() ) return it->second ;
+
+    Face &face = faces_[font_face] ;
+
+    if ( FT_Face ft_face = cairo_ft_scaled_font_lock_face(scaled_font) ) {
+        if ( ft_face->units_per_EM ) face.units_per_em_ = ft_face->units_per_EM ;
+        cairo_ft_scaled_font_unlock_face(scaled_font) ;
+    }
+
+    // synthesize the same styles as cairo does when rendering the face, i.e. those fontconfig set in its pattern
+    // (faces of different synthesized styles are distinct)
+
+    FontManager::Synthesis syn = FontManager::instance().synthesis(font_face) ;
+
+    face.embolden_ = syn.embolden_ ;
+    face.transform_ = syn.xx_ != 1 || syn.xy_ != 0 || syn.yx_ != 0 || syn.yy_ != 1 ;
+    face.matrix_.xx = static_cast<FT_Fixed>(syn.xx_ * 0x10000) ;
+    face.matrix_.xy = static_cast<FT_Fixed>(syn.xy_ * 0x10000) ;
+    face.matrix_.yx = static_cast<FT_Fixed>(syn.yx_ * 0x10000) ;
+    face.matrix_.yy = static_cast<FT_Fixed>(syn.yy_ * 0x10000) ;
+
+    return face ;
+}
+
+// FreeType outline decomposition callbacks, contours are closed when the next one starts and at the end
+
+namespace {
+
+struct OutlineBuilder {
+    Path &path_ ;
+    bool open_ ;
+} ;
+
+int outline_move_to(const FT_Vector *to, void *user) {
+    OutlineBuilder *b = static_cast<OutlineBuilder *>(user) ;
+    if ( b->open_ ) b->path_.closePath() ;
+    b->path_.moveTo(to->x, to->y) ;
+    b->open_ = true ;
+    return 0 ;
+}
+
+int outline_line_to(const FT_Vector *to, void *user) {
+    static_cast<OutlineBuilder *>(user)->path_.lineTo(to->x, to->y) ;
+    return 0 ;
+}
+
+int outline_conic_to(const FT_Vector *control, const FT_Vector *to, void *user) {
+    static_cast<OutlineBuilder *>(user)->path_.quadTo(control->x, control->y, to->x, to->y) ;
+    return 0 ;
+}
+
+int outline_cubic_to(const FT_Vector *control1, const FT_Vector *control2, const FT_Vector *to, void *user) {
+    static_cast<OutlineBuilder *>(user)->path_.curveTo(control1->x, control1->y, control2->x, control2->y, to->x, to->y) ;
+    return 0 ;
+}
+
+}
+
+const Path &GlyphOutlineCache::outline(Face &face, cairo_scaled_font_t *scaled_font, unsigned int glyph) {
+    auto it = face.glyphs_.find(glyph) ;
+    if ( it != face.glyphs_.end() ) return it->second ;
+
+    Path &path = face.glyphs_[glyph] ;
+
+    FT_Face ft_face = cairo_ft_scaled_font_lock_face(scaled_font) ;
+    if ( !ft_face ) return path ;
+
+    // glyphs without outlines (e.g. bitmap fonts) are cached as empty paths
+    if ( FT_Load_Glyph(ft_face, glyph, FT_LOAD_NO_SCALE | FT_LOAD_NO_BITMAP) == 0 &&
+         ft_face->glyph->format == FT_GLYPH_FORMAT_OUTLINE ) {
+
+        FT_Outline &outline = ft_face->glyph->outline ;
+
+        if ( face.embolden_ ) FT_Outline_Embolden(&outline, static_cast<FT_Pos>(face.units_per_em_ / 24)) ;
+
+        if ( face.transform_ ) FT_Outline_Transform(&outline, &face.matrix_) ;
+
+        FT_Outline_Funcs funcs ;
+        funcs.move_to = outline_move_to ;
+        funcs.line_to = outline_line_to ;
+        funcs.conic_to = outline_conic_to ;
+        funcs.cubic_to = outline_cubic_to ;
+        funcs.shift = 0 ;
+        funcs.delta = 0 ;
+
+        OutlineBuilder builder{path, false} ;
+        FT_Outline_Decompose(&outline, &funcs, &builder) ;
+        if ( builder.open_ ) path.closePath() ;
+    }
+
+    cairo_ft_scaled_font_unlock_face(scaled_font) ;
+
+    return path ;
+}
+
+void GlyphOutlineCache::append(Path &dst, const std::vector<Glyph> &glyphs, const std::vector<Point2d> &pos, const Font &font)
+{
+    cairo_scaled_font_t *scaled_font = FontManager::instance().createFont(font) ;
+    if ( !scaled_font ) return ;
+
+    // glyphs taken from fallback faces are appended in runs using a scaled font of that face
+
+    for ( size_t i=0 ; i<glyphs.size() ; ) {
+        size_t j = i + 1 ;
+        while ( j < glyphs.size() && glyphs[j].face_ == glyphs[i].face_ ) ++j ;
+
+        cairo_font_face_t *font_face = static_cast<cairo_font_face_t *>(glyphs[i].face_) ;
+        cairo_scaled_font_t *run_font = font_face ? FontManager::instance().createFont(font_face, font.size()) : scaled_font ;
+
+        if ( run_font ) {
+            lock_guard<mutex> g(mutex_) ;
+
+            Face &f = face(cairo_scaled_font_get_font_face(run_font), run_font) ;
+
+            // font units to user units, flipping the y axis
+            double scale = font.size() / f.units_per_em_ ;
+
+            for ( size_t k=i ; k<j ; k++ ) {
+                const Path &p = outline(f, run_font, glyphs[k].index_) ;
+                if ( !p.commands().empty() )
+                    dst.addPath(p, Matrix2d(scale, 0, 0, -scale, pos[k].x(), pos[k].y())) ;
+            }
+        }
+
+        if ( font_face && run_font ) cairo_scaled_font_destroy(run_font) ;
+
+        i = j ;
+    }
+
+    cairo_scaled_font_destroy(scaled_font) ;
+}
+
+}
@@ -0,0 +1,48 @@
+#ifndef __XG_CAIRO_GLYPH_OUTLINE_CACHE_HPP__
+#define __XG_CAIRO_GLYPH_OUTLINE_CACHE_HPP__
+
+#include <xg/path.hpp>
+#include <xg/font.hpp>
+
+#include <cairo/cairo.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <map>
+#include <unordered_map>
+#include <mutex>
+
+namespace xg {
+
+// Glyph outlines of each font face, extracted once with FreeType in unscaled font units (y axis up) so that
+// converting text to paths is a sequence of scaled and translated appends of the cached outlines.
+
+class GlyphOutlineCache {
+public:
+
+    static GlyphOutlineCache &instance() ;
+
+    // append the outlines of the glyphs positioned at pos (baseline origins in user units) using the given font
+    void append(Path &dst, const std::vector<Glyph> &glyphs, const std::vector<Point2d> &pos, const Font &font) ;
+
+    // forget all outlines
+    void clear() ;
+
+private:
+
+    struct Face {
+        double units_per_em_ = 1 ;
+        bool embolden_ = false, transform_ = false ;   // synthesized styles
+        FT_Matrix matrix_ ;
+        std::unordered_map<unsigned int, Path> glyphs_ ;
+    } ;
+
+    Face &face(cairo_font_face_t *face, cairo_scaled_font_t *scaled_font) ;
+    const Path &outline(Face &face, cairo_scaled_font_t *scaled_font, unsigned int glyph) ;
+
+    std::map<cairo_font_face_t *, Face> faces_ ;
+    std::mutex mutex_ ;
+} ;
+
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include "marker_atlas.hpp"
+#include "path_data.hpp"
+
+#include <cmath>
+#include <tuple>
+#include <algorithm>
+
+using namespace std ;
+
+namespace xg {
+
+// sprites larger than this are not cached
+static const int max_sprite_size = 128 ;
+
+bool MarkerAtlas::Key::operator < (const Key &o) const
+{
+    return std::tie(shape_, size_, line_width_, miter_limit_, cap_, join_, has_stroke_, has_fill_, bx_, by_,
+                    stroke_[0], stroke_[1], stroke_[2], stroke_[3], fill_[0], fill_[1], fill_[2], fill_[3]) <
+           std::tie(o.shape_, o.size_, o.line_width_, o.miter_limit_, o.cap_, o.join_, o.has_stroke_, o.has_fill_, o.bx_, o.by_,
+                    o.stroke_[0], o.stroke_[1], o.stroke_[2], o.stroke_[3], o.fill_[0], o.fill_[1], o.fill_[2], o.fill_[3]) ;
+}
+
+MarkerAtlas::MarkerAtlas(int width, int height): width_(width), height_(height)
+{
+    surf_ = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height) ;
+
+    for( int i=0 ; i<=static_cast<int>(MarkerShape::TriangleRight) ; i++ )
+        paths_[i] = markerPath(static_cast<MarkerShape>(i)) ;
+}
+
+MarkerAtlas::~MarkerAtlas()
+{
+    cairo_surface_destroy(surf_) ;
+}
+
+int MarkerAtlas::half_extent(const Key &key)
+{
+    double pad = 0 ;
+
+    if ( key.has_stroke_ ) {
+        pad = key.line_width_/2 ;
+        if ( key.join_ == static_cast<int>(LineJoin::Miter) ) pad *= std::max(key.miter_limit_, 1.0) ;
+    }
+
+    // one extra pixel for antialiasing and one for the subpixel shift
+    return static_cast<int>(ceil(key.size_/2 + pad)) + 2 ;
+}
+
+bool MarkerAtlas::makeKey(Key &key, MarkerShape shape, double size, double scale, const Pen *pen, const Color *fill) const
+{
+    key.shape_ = static_cast<int>(shape) ;
+    key.size_ = size * scale ;
+    key.bx_ = key.by_ = 0 ;
+
+    key.has_fill_ = ( fill != nullptr ) ;
+    std::fill(key.fill_, key.fill_ + 4, 0.0) ;
+
+    if ( fill ) {
+        key.fill_[0] = fill->r() ; key.fill_[1] = fill->g() ; key.fill_[2] = fill->b() ; key.fill_[3] = fill->a() ;
+    }
+
+    key.has_stroke_ = ( pen != nullptr ) ;
+    std::fill(key.stroke_, key.stroke_ + 4, 0.0) ;
+    key.line_width_ = key.miter_limit_ = 0 ;
+    key.cap_ = key.join_ = 0 ;
+
+    if ( pen ) {
+        if ( !pen->dashArray().empty() ) return false ;
+
+        Color clr = pen->lineColor() ;
+        key.stroke_[0] = clr.r() ; key.stroke_[1] = clr.g() ; key.stroke_[2] = clr.b() ; key.stroke_[3] = clr.a() ;
+        key.line_width_ = pen->lineWidth() * scale ;
+        key.miter_limit_ = pen->miterLimit() ;
+        key.cap_ = static_cast<int>(pen->lineCap()) ;
+        key.join_ = static_cast<int>(pen->lineJoin()) ;
+    }
+
+    return 2 * half_extent(key) + 1 <= max_sprite_size ;
+}
+
+void MarkerAtlas::reset()
+{
+    cairo_t *cr = cairo_create(surf_) ;
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR) ;
+    cairo_paint(cr) ;
+    cairo_destroy(cr) ;
+
+    sprites_.clear() ;
+    shelf_x_ = shelf_y_ = shelf_h_ = 0 ;
+    ++generation_ ;
+}
+
+// simple shelf packing, sprites of the same marker have the same size so this wastes little space
+
+bool MarkerAtlas::allocate(int w, int h, int &x, int &y)
+{
+    if ( shelf_x_ + w > width_ ) {
+        shelf_y_ += shelf_h_ ;
+        shelf_x_ = shelf_h_ = 0 ;
+    }
+
+    if ( shelf_y_ + h > height_ ) return false ;
+
+    x = shelf_x_ ;
+    y = shelf_y_ ;
+
+    shelf_x_ += w ;
+    shelf_h_ = std::max(shelf_h_, h) ;
+
+    return true ;
+}
+
+void MarkerAtlas::render(const Key &key, const Sprite &s)
+{
+    cairo_t *cr = cairo_create(surf_) ;
+
+    cairo_rectangle(cr, s.x_, s.y_, s.w_, s.h_) ;
+    cairo_clip(cr) ;
+
+    cairo_translate(cr, s.x_ + s.cx_ + key.bx_/(double)subpixel_steps, s.y_ + s.cy_ + key.by_/(double)subpixel_steps) ;
+
+    // the path is transformed to device space when appended so the line width is not affected by the scaling
+    cairo_save(cr) ;
+    cairo_scale(cr, key.size_, key.size_) ;
+    cairo_append_path(cr, PathData::cairoPath(paths_[key.shape_])) ;
+    cairo_restore(cr) ;
+
+    if ( key.has_fill_ ) {
+        cairo_set_source_rgba(cr, key.fill_[0], key.fill_[1], key.fill_[2], key.fill_[3]) ;
+        cairo_fill_preserve(cr) ;
+    }
+
+    if ( key.has_stroke_ ) {
+        Pen pen(Color(key.stroke_[0], key.stroke_[1], key.stroke_[2], key.stroke_[3]), key.line_width_) ;
+        pen.setMiterLimit(key.miter_limit_) ;
+        pen.setLineCap(static_cast<LineCap>(key.cap_)) ;
+        pen.setLineJoin(static_cast<LineJoin>(key.join_)) ;
+
+        cairo_set_source_rgba(cr, key.stroke_[0], key.stroke_[1], key.stroke_[2], key.stroke_[3]) ;
+        cairo_set_stroke_style(cr, pen) ;
+        cairo_stroke(cr) ;
+    }
+
+    cairo_destroy(cr) ;
+}
+
+const MarkerAtlas::Sprite *MarkerAtlas::get(const Key &key)
+{
+    auto it = sprites_.find(key) ;
+    if ( it != sprites_.end() ) return &it->second ;
+
+    Sprite s ;
+    s.cx_ = s.cy_ = half_extent(key) ;
+    s.w_ = s.h_ = 2 * s.cx_ + 1 ;
+
+    if ( !allocate(s.w_, s.h_, s.x_, s.y_) ) {
+        reset() ;
+        if ( !allocate(s.w_, s.h_, s.x_, s.y_) ) return nullptr ;
+    }
+
+    render(key, s) ;
+
+    return &(sprites_[key] = s) ;
+}
+
+}
@@ -0,0 +1,74 @@
+#ifndef __XG_CAIRO_MARKER_ATLAS_HPP__
+#define __XG_CAIRO_MARKER_ATLAS_HPP__
+
+#include <xg/marker.hpp>
+#include <xg/pen.hpp>
+
+#include <cairo/cairo.h>
+#include <map>
+
+namespace xg {
+
+// Sprite cache for plot markers. Each combination of marker shape, device size, pen, brush and subpixel offset
+// is rasterized once into a shared ARGB atlas surface. Placements are then composited from the atlas with
+// a single blit instead of filling and stroking the marker path.
+
+class MarkerAtlas {
+public:
+
+    // subpixel positions per pixel along each axis
+    static const int subpixel_steps = 4 ;
+
+    struct Key {
+        int shape_ ;
+        double size_ ;                  // device units
+        double line_width_, miter_limit_ ;
+        int cap_, join_ ;
+        double stroke_[4], fill_[4] ;
+        bool has_stroke_, has_fill_ ;
+        int bx_, by_ ;                  // subpixel offset bucket
+
+        bool operator < (const Key &other) const ;
+    } ;
+
+    // location of a sprite in the atlas. The marker center is at (cx_ + bx/steps, cy_ + by/steps)
+    // relative to the sprite origin.
+    struct Sprite {
+        int x_, y_, w_, h_ ;
+        int cx_, cy_ ;
+    } ;
+
+    MarkerAtlas(int width = 512, int height = 512) ;
+    ~MarkerAtlas() ;
+
+    // Fill in the key (apart from the subpixel bucket) for a marker drawn at the given scale with optional pen and
+    // fill color. Returns false if the marker cannot be cached (dashed pen or too large) and has to be drawn as a path.
+    bool makeKey(Key &key, MarkerShape shape, double size, double scale, const Pen *pen, const Color *fill) const ;
+
+    // return the sprite for the key rasterizing it if needed. May clear the atlas when it is full, invalidating
+    // previously returned sprites, in which case generation() changes.
+    const Sprite *get(const Key &key) ;
+
+    unsigned int generation() const { return generation_ ; }
+
+    cairo_surface_t *surface() const { return surf_ ; }
+
+private:
+
+    bool allocate(int w, int h, int &x, int &y) ;
+    void reset() ;
+    void render(const Key &key, const Sprite &s) ;
+
+    static int half_extent(const Key &key) ;
+
+    cairo_surface_t *surf_ ;
+    int width_, height_ ;
+    int shelf_x_ = 0, shelf_y_ = 0, shelf_h_ = 0 ;
+    unsigned int generation_ = 0 ;
+    std::map<Key, Sprite> sprites_ ;
+    Path paths_[static_cast<int>(MarkerShape::TriangleRight) + 1] ;
+} ;
+
+}
+
+#endif
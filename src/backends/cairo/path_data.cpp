@@ -0,0 +1,332 @@
+#include "path_data.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std ;
+
+namespace xg {
+
+static inline void push_header(vector<cairo_path_data_t> &data, cairo_path_data_type_t type, int length) {
+    cairo_path_data_t d ;
+    d.header.type = type ;
+    d.header.length = length ;
+    data.push_back(d) ;
+}
+
+static inline void push_point(vector<cairo_path_data_t> &data, double x, double y) {
+    cairo_path_data_t d ;
+    d.point.x = x ;
+    d.point.y = y ;
+    data.push_back(d) ;
+}
+
+void PathData::build(const Path &p)
+{
+    const auto &cmds = p.commands() ;
+
+    data_.clear() ;
+    data_.reserve(cmds.size() * 2) ;
+
+    for( const auto &pcb: cmds ) {
+        switch( pcb.cmd_ ) {
+        case Path::MoveToCmd:
+            push_header(data_, CAIRO_PATH_MOVE_TO, 2) ;
+            push_point(data_, pcb.arg0_, pcb.arg1_) ;
+            break ;
+        case Path::LineToCmd:
+            push_header(data_, CAIRO_PATH_LINE_TO, 2) ;
+            push_point(data_, pcb.arg0_, pcb.arg1_) ;
+            break ;
+        case Path::CurveToCmd:
+            push_header(data_, CAIRO_PATH_CURVE_TO, 4) ;
+            push_point(data_, pcb.arg0_, pcb.arg1_) ;
+            push_point(data_, pcb.arg2_, pcb.arg3_) ;
+            push_point(data_, pcb.arg4_, pcb.arg5_) ;
+            break ;
+        case Path::ClosePathCmd:
+            push_header(data_, CAIRO_PATH_CLOSE_PATH, 1) ;
+            break ;
+        default:
+            break ;
+        }
+    }
+
+    path_.status = CAIRO_STATUS_SUCCESS ;
+    path_.data = data_.data() ;
+    path_.num_data = data_.size() ;
+}
+
+// Threads drawing the same path may both build the data, the first one stored is kept by all of them. The
+// returned path stays valid until the path is modified.
+
+const cairo_path_t *PathData::cairoPath(const Path &p)
+{
+    std::shared_ptr<PathData> data = std::atomic_load(&p.data_) ;
+
+    if ( !data ) {
+        std::shared_ptr<PathData> built(new PathData) ;
+        built->build(p) ;
+        if ( std::atomic_compare_exchange_strong(&p.data_, &data, built) ) data = built ;
+    }
+
+    return &data->path_ ;
+}
+
+// bezier control point distance for a quarter circle
+static const double circle_kappa = 0.5522847498 ;
+
+void PathBatch::addCircle(double cx, double cy, double r)
+{
+    double k = circle_kappa * r ;
+
+    push_header(data_, CAIRO_PATH_MOVE_TO, 2) ;
+    push_point(data_, cx + r, cy) ;
+
+    push_header(data_, CAIRO_PATH_CURVE_TO, 4) ;
+    push_point(data_, cx + r, cy + k) ;
+    push_point(data_, cx + k, cy + r) ;
+    push_point(data_, cx, cy + r) ;
+
+    push_header(data_, CAIRO_PATH_CURVE_TO, 4) ;
+    push_point(data_, cx - k, cy + r) ;
+    push_point(data_, cx - r, cy + k) ;
+    push_point(data_, cx - r, cy) ;
+
+    push_header(data_, CAIRO_PATH_CURVE_TO, 4) ;
+    push_point(data_, cx - r, cy - k) ;
+    push_point(data_, cx - k, cy - r) ;
+    push_point(data_, cx, cy - r) ;
+
+    push_header(data_, CAIRO_PATH_CURVE_TO, 4) ;
+    push_point(data_, cx + k, cy - r) ;
+    push_point(data_, cx + r, cy - k) ;
+    push_point(data_, cx + r, cy) ;
+
+    push_header(data_, CAIRO_PATH_CLOSE_PATH, 1) ;
+}
+
+void PathBatch::addRect(double x, double y, double w, double h)
+{
+    // keep a consistent orientation so that overlapping rectangles do not cancel under the winding rule
+    if ( w < 0 ) { x += w ; w = -w ; }
+    if ( h < 0 ) { y += h ; h = -h ; }
+
+    push_header(data_, CAIRO_PATH_MOVE_TO, 2) ;
+    push_point(data_, x, y) ;
+    push_header(data_, CAIRO_PATH_LINE_TO, 2) ;
+    push_point(data_, x + w, y) ;
+    push_header(data_, CAIRO_PATH_LINE_TO, 2) ;
+    push_point(data_, x + w, y + h) ;
+    push_header(data_, CAIRO_PATH_LINE_TO, 2) ;
+    push_point(data_, x, y + h) ;
+    push_header(data_, CAIRO_PATH_CLOSE_PATH, 1) ;
+}
+
+void PathBatch::addLine(double x0, double y0, double x1, double y1)
+{
+    push_header(data_, CAIRO_PATH_MOVE_TO, 2) ;
+    push_point(data_, x0, y0) ;
+    push_header(data_, CAIRO_PATH_LINE_TO, 2) ;
+    push_point(data_, x1, y1) ;
+}
+
+void PathBatch::addPath(const cairo_path_t *path, double x, double y, double s)
+{
+    size_t offset = data_.size() ;
+
+    data_.insert(data_.end(), path->data, path->data + path->num_data) ;
+
+    for ( size_t i = offset ; i < data_.size() ; i += data_[i].header.length ) {
+        for ( int j = 1 ; j < data_[i].header.length ; j++ ) {
+            cairo_path_data_t &d = data_[i + j] ;
+            d.point.x = d.point.x * s + x ;
+            d.point.y = d.point.y * s + y ;
+        }
+    }
+}
+
+const cairo_path_t *PathBatch::path()
+{
+    path_.status = CAIRO_STATUS_SUCCESS ;
+    path_.data = data_.data() ;
+    path_.num_data = data_.size() ;
+    return &path_ ;
+}
+
+void cairo_set_stroke_style(cairo_t *cr, const Pen &pen)
+{
+    cairo_set_line_width (cr, pen.lineWidth());
+
+    cairo_set_miter_limit (cr, pen.miterLimit()) ;
+
+    switch ( pen.lineCap() ) {
+    case LineCap::Butt:
+        cairo_set_line_cap(cr, CAIRO_LINE_CAP_BUTT) ;
+        break ;
+    case LineCap::Round:
+        cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND) ;
+        break ;
+    case LineCap::Square:
+        cairo_set_line_cap(cr, CAIRO_LINE_CAP_SQUARE) ;
+        break ;
+    }
+
+    switch ( pen.lineJoin() ) {
+    case LineJoin::Miter:
+        cairo_set_line_join(cr, CAIRO_LINE_JOIN_MITER) ;
+        break ;
+    case LineJoin::Round:
+        cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND) ;
+        break ;
+    case LineJoin::Bevel:
+        cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL) ;
+        break ;
+    }
+
+    double dash_offset = pen.dashOffset() ;
+
+    const auto &dash_array = pen.dashArray() ;
+
+    if ( dash_array.empty() )
+        cairo_set_dash(cr, 0, 0, 0) ;
+    else
+        cairo_set_dash(cr, &dash_array[0], dash_array.size(), dash_offset) ;
+}
+
+// masks larger than this (in pixels) are not cached, the path is drawn directly instead
+static const double max_mask_area = 4096.0 * 4096.0 ;
+
+CachedPathData::~CachedPathData()
+{
+    if ( fill_.surf_ ) cairo_surface_destroy(fill_.surf_) ;
+    if ( stroke_.surf_ ) cairo_surface_destroy(stroke_.surf_) ;
+}
+
+CachedPathData &CachedPathData::get(const CachedPath &p)
+{
+    if ( !p.data_ ) p.data_.reset(new CachedPathData) ;
+    return *p.data_ ;
+}
+
+// the mask may be reused if the linear part is the same and the translation differs by whole pixels
+
+static bool mask_reusable(const CachedPathData::Mask &m, const cairo_matrix_t &dev, double &x, double &y)
+{
+    if ( !m.surf_ ) return false ;
+
+    const cairo_matrix_t &o = m.matrix_ ;
+
+    if ( o.xx != dev.xx || o.yx != dev.yx || o.xy != dev.xy || o.yy != dev.yy ) return false ;
+
+    double dx = dev.x0 - o.x0, dy = dev.y0 - o.y0 ;
+
+    if ( dx != std::floor(dx) || dy != std::floor(dy) ) return false ;
+
+    x = m.x_ + dx ;
+    y = m.y_ + dy ;
+
+    return true ;
+}
+
+const CachedPathData::Mask *CachedPathData::fillMask(const CachedPath &p, const cairo_matrix_t &dev, cairo_fill_rule_t rule, double &x, double &y)
+{
+    if ( fill_.rule_ == rule && mask_reusable(fill_, dev, x, y) ) return &fill_ ;
+
+    if ( !render(fill_, p, dev, rule, nullptr) ) return nullptr ;
+
+    x = fill_.x_ ; y = fill_.y_ ;
+    return &fill_ ;
+}
+
+const CachedPathData::Mask *CachedPathData::strokeMask(const CachedPath &p, const cairo_matrix_t &dev, double &x, double &y)
+{
+    if ( mask_reusable(stroke_, dev, x, y) ) return &stroke_ ;
+
+    if ( !render(stroke_, p, dev, CAIRO_FILL_RULE_WINDING, p.pen()) ) return nullptr ;
+
+    x = stroke_.x_ ; y = stroke_.y_ ;
+    return &stroke_ ;
+}
+
+bool CachedPathData::render(Mask &m, const CachedPath &p, const cairo_matrix_t &dev, cairo_fill_rule_t rule, const Pen *pen)
+{
+    if ( m.surf_ ) {
+        cairo_surface_destroy(m.surf_) ;
+        m.surf_ = nullptr ;
+    }
+
+    Rectangle2d ext = p.path().extents() ;
+    if ( ext.empty() ) return false ;
+
+    // full transformation from path to device space
+
+    Matrix2d tr = p.transform() ;
+    tr.postmult(Matrix2d(dev.xx, dev.yx, dev.xy, dev.yy, dev.x0, dev.y0)) ;
+
+    double pad = 0 ;
+
+    if ( pen ) {
+        // largest singular value of the linear part, i.e. the longest a unit vector may become
+        double a = tr.m1(), b = tr.m2(), c = tr.m3(), d = tr.m4() ;
+        double s = a*a + b*b + c*c + d*d, q = a*a + b*b - c*c - d*d, r = a*c + b*d ;
+        double scale = std::sqrt((s + std::sqrt(q*q + 4*r*r))/2) ;
+
+        // miter joins may extend up to miterLimit half widths from the path and square caps up to sqrt(2)
+        double extent = 1.0 ;
+        if ( pen->lineJoin() == LineJoin::Miter ) extent = std::max(pen->miterLimit(), 1.0) ;
+        if ( pen->lineCap() == LineCap::Square ) extent = std::max(extent, M_SQRT2) ;
+
+        pad = pen->lineWidth() * 0.5 * extent * scale ;
+    }
+
+    double minx = std::numeric_limits<double>::max(), miny = minx, maxx = -minx, maxy = -minx ;
+
+    for( const Point2d &c: { ext.topLeft(), ext.topRight(), ext.bottomLeft(), ext.bottomRight() } ) {
+        Point2d d = tr.transform(c) ;
+        minx = std::min(minx, d.x()) ; maxx = std::max(maxx, d.x()) ;
+        miny = std::min(miny, d.y()) ; maxy = std::max(maxy, d.y()) ;
+    }
+
+    // one extra pixel for antialiasing
+
+    double x0 = std::floor(minx - pad) - 1, y0 = std::floor(miny - pad) - 1 ;
+    double x1 = std::ceil(maxx + pad) + 1, y1 = std::ceil(maxy + pad) + 1 ;
+
+    double w = x1 - x0, h = y1 - y0 ;
+
+    if ( w * h > max_mask_area ) return false ;
+
+    m.surf_ = cairo_image_surface_create(CAIRO_FORMAT_A8, (int)w, (int)h) ;
+
+    cairo_t *cr = cairo_create(m.surf_) ;
+
+    cairo_translate(cr, -x0, -y0) ;
+    cairo_transform(cr, &dev) ;
+
+    cairo_matrix_t pm ;
+    const Matrix2d &ptr = p.transform() ;
+    cairo_matrix_init(&pm, ptr.m1(), ptr.m2(), ptr.m3(), ptr.m4(), ptr.m5(), ptr.m6()) ;
+    cairo_transform(cr, &pm) ;
+
+    cairo_append_path(cr, PathData::cairoPath(p.path())) ;
+
+    if ( pen ) {
+        cairo_set_stroke_style(cr, *pen) ;
+        cairo_stroke(cr) ;
+    } else {
+        cairo_set_fill_rule(cr, rule) ;
+        cairo_fill(cr) ;
+    }
+
+    cairo_destroy(cr) ;
+
+    m.matrix_ = dev ;
+    m.rule_ = rule ;
+    m.x_ = x0 ;
+    m.y_ = y0 ;
+
+    return true ;
+}
+
+}
@@ -0,0 +1,86 @@
+#ifndef __XG_CAIRO_PATH_DATA_HPP__
+#define __XG_CAIRO_PATH_DATA_HPP__
+
+#include <xg/path.hpp>
+#include <xg/cached_path.hpp>
+
+#include <cairo/cairo.h>
+#include <vector>
+
+namespace xg {
+
+// cairo representation of a Path. It is built the first time a path is drawn and cached in the Path
+// object so that subsequent draws cost a single cairo_append_path call.
+
+class PathData {
+public:
+
+    // cairo path data corresponding to p, built on demand
+    static const cairo_path_t *cairoPath(const Path &p) ;
+
+private:
+
+    void build(const Path &p) ;
+
+    std::vector<cairo_path_data_t> data_ ;
+    cairo_path_t path_ ;
+} ;
+
+// Accumulates many small shapes (scatter points, markers, segments) into a single cairo path so that they
+// can be painted with one fill/stroke.
+
+class PathBatch {
+public:
+
+    void addCircle(double cx, double cy, double r) ;
+    void addRect(double x, double y, double w, double h) ;
+    void addLine(double x0, double y0, double x1, double y1) ;
+    // append path scaled by s and translated to (x, y)
+    void addPath(const cairo_path_t *path, double x, double y, double s) ;
+
+    bool empty() const { return data_.empty() ; }
+    void clear() { data_.clear() ; }
+
+    const cairo_path_t *path() ;
+
+private:
+
+    std::vector<cairo_path_data_t> data_ ;
+    cairo_path_t path_ ;
+} ;
+
+// Rasterized coverage (A8 masks) of a CachedPath in device space
+
+class CachedPathData {
+public:
+
+    struct Mask {
+        cairo_surface_t *surf_ = nullptr ;
+        cairo_matrix_t matrix_ ;    // device transform the mask was rendered with
+        cairo_fill_rule_t rule_ ;
+        double x_ = 0, y_ = 0 ;     // device position of the mask origin
+    } ;
+
+    ~CachedPathData() ;
+
+    static CachedPathData &get(const CachedPath &p) ;
+
+    // Return the fill (stroke) coverage mask for the given device transform, re-rendering it if the transform
+    // changed by more than an integer translation. The device position to composite the mask at is returned
+    // in x, y. Returns nullptr if the path is too large to be cached, in which case it should be drawn directly.
+    const Mask *fillMask(const CachedPath &p, const cairo_matrix_t &dev, cairo_fill_rule_t rule, double &x, double &y) ;
+    const Mask *strokeMask(const CachedPath &p, const cairo_matrix_t &dev, double &x, double &y) ;
+
+private:
+
+    bool render(Mask &m, const CachedPath &p, const cairo_matrix_t &dev, cairo_fill_rule_t rule, const Pen *pen) ;
+
+    Mask fill_, stroke_ ;
+} ;
+
+// set line width, cap, join, miter limit and dashes of the context from the pen
+void cairo_set_stroke_style(cairo_t *cr, const Pen &pen) ;
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+#include "surface_pool.hpp"
+
+#include <cstring>
+
+using namespace std ;
+
+namespace xg {
+
+SurfaceLease::SurfaceLease(SurfaceLease &&other) noexcept:
+    pool_(other.pool_), surf_(other.surf_), data_(other.data_), capacity_(other.capacity_) {
+    other.pool_ = nullptr ;
+    other.surf_ = nullptr ;
+    other.data_ = nullptr ;
+}
+
+SurfaceLease &SurfaceLease::operator = (SurfaceLease &&other) noexcept {
+    if ( this != &other ) {
+        release() ;
+        std::swap(pool_, other.pool_) ;
+        std::swap(surf_, other.surf_) ;
+        std::swap(data_, other.data_) ;
+        std::swap(capacity_, other.capacity_) ;
+    }
+    return *this ;
+}
+
+SurfaceLease::~SurfaceLease() {
+    release() ;
+}
+
+void SurfaceLease::release() {
+    if ( surf_ ) {
+        // make sure that no remaining reference touches the buffer once it is reused
+        cairo_surface_finish(surf_) ;
+        cairo_surface_destroy(surf_) ;
+        surf_ = nullptr ;
+    }
+
+    if ( data_ ) {
+        pool_->release(data_, capacity_) ;
+        data_ = nullptr ;
+    }
+}
+
+SurfacePool &SurfacePool::instance() {
+    static SurfacePool pool ;
+    return pool ;
+}
+
+SurfacePool::~SurfacePool() {
+    trim() ;
+}
+
+// powers of two up to 1 MB, above that steps of a sixteenth of the next power of two so that large buffers (e.g. a
+// whole page) waste at most an eighth of their size
+
+static size_t bucket_size(size_t sz) {
+    size_t b = 4096 ;
+    while ( b < sz ) b <<= 1 ;
+
+    if ( b <= ( 1 << 20 ) ) return b ;
+
+    size_t step = b / 16 ;
+    return ( sz + step - 1 ) / step * step ;
+}
+
+SurfaceLease SurfacePool::acquire(cairo_format_t fmt, int width, int height) {
+
+    SurfaceLease lease ;
+
+    int stride = cairo_format_stride_for_width(fmt, width) ;
+    size_t sz = (size_t)stride * height ;
+    size_t capacity = bucket_size(sz) ;
+
+    {
+        lock_guard<mutex> lock(mutex_) ;
+
+        auto it = free_.find(capacity) ;
+        if ( it != free_.end() && !it->second.empty() ) {
+            lease.data_ = it->second.back() ;
+            it->second.pop_back() ;
+            cached_bytes_ -= capacity ;
+        }
+        else ++allocations_ ;
+    }
+
+    if ( !lease.data_ ) lease.data_ = new unsigned char [capacity] ;
+
+    memset(lease.data_, 0, sz) ;
+
+    lease.pool_ = this ;
+    lease.capacity_ = capacity ;
+    lease.surf_ = cairo_image_surface_create_for_data(lease.data_, fmt, width, height, stride) ;
+
+    return lease ;
+}
+
+void SurfacePool::release(unsigned char *data, size_t capacity) {
+    {
+        lock_guard<mutex> lock(mutex_) ;
+
+        // a single large buffer should not take over the pool
+        if ( capacity <= max_cached_bytes_ / 4 && cached_bytes_ + capacity <= max_cached_bytes_ ) {
+            free_[capacity].push_back(data) ;
+            cached_bytes_ += capacity ;
+            return ;
+        }
+    }
+
+    delete [] data ;
+}
+
+void SurfacePool::trim() {
+    lock_guard<mutex> lock(mutex_) ;
+
+    for( auto &b: free_ ) {
+        for( unsigned char *data: b.second ) delete [] data ;
+    }
+    free_.clear() ;
+    cached_bytes_ = 0 ;
+}
+
+size_t SurfacePool::allocations() const {
+    lock_guard<mutex> lock(mutex_) ;
+    return allocations_ ;
+}
+
+size_t SurfacePool::cachedBytes() const {
+    lock_guard<mutex> lock(mutex_) ;
+    return cached_bytes_ ;
+}
+
+}
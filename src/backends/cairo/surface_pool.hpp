@@ -0,0 +1,79 @@
+#ifndef __XG_CAIRO_SURFACE_POOL_HPP__
+#define __XG_CAIRO_SURFACE_POOL_HPP__
+
+#include <cairo/cairo.h>
+#include <map>
+#include <vector>
+#include <mutex>
+
+namespace xg {
+
+class SurfacePool ;
+
+// Image surface borrowed from a SurfacePool. The pixel buffer goes back to the pool when the lease is destroyed,
+// after which the surface is finished and may no longer be drawn on, even if other references to it remain.
+
+class SurfaceLease {
+public:
+
+    SurfaceLease() = default ;
+    SurfaceLease(SurfaceLease &&other) noexcept ;
+    SurfaceLease &operator = (SurfaceLease &&other) noexcept ;
+    ~SurfaceLease() ;
+
+    SurfaceLease(const SurfaceLease &) = delete ;
+    SurfaceLease &operator = (const SurfaceLease &) = delete ;
+
+    cairo_surface_t *surface() const { return surf_ ; }
+
+    void release() ;
+
+private:
+
+    friend class SurfacePool ;
+
+    SurfacePool *pool_ = nullptr ;
+    cairo_surface_t *surf_ = nullptr ;
+    unsigned char *data_ = nullptr ;
+    size_t capacity_ = 0 ;
+} ;
+
+// Pool of pixel buffers for short lived image surfaces (canvases, clip mask proxies). Buffers are bucketed by
+// size (powers of two, finer steps above 1 MB) so that rendering a document repeatedly reuses the same few
+// allocations. Buffers larger than a quarter of the cache limit are freed on release. Only the part of a buffer
+// covered by the new surface is cleared on reuse.
+
+class SurfacePool {
+public:
+
+    // process wide pool, safe to use from several threads
+    static SurfacePool &instance() ;
+
+    SurfacePool(size_t max_cached_bytes = 64 << 20): max_cached_bytes_(max_cached_bytes) {}
+    ~SurfacePool() ;
+
+    // image surface with all pixels zero
+    SurfaceLease acquire(cairo_format_t fmt, int width, int height) ;
+
+    // free all cached buffers
+    void trim() ;
+
+    // number of buffers allocated so far
+    size_t allocations() const ;
+    // bytes held by buffers that are not leased
+    size_t cachedBytes() const ;
+
+private:
+
+    friend class SurfaceLease ;
+
+    void release(unsigned char *data, size_t capacity) ;
+
+    mutable std::mutex mutex_ ;
+    std::map<size_t, std::vector<unsigned char *>> free_ ;  // by capacity
+    size_t max_cached_bytes_, cached_bytes_ = 0, allocations_ = 0 ;
+} ;
+
+}
+
+#endif
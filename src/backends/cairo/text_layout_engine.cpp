@@ -3,8 +3,17 @@
 
 #include <memory>
 #include <iostream>
+#include <algorithm>
+#include <functional>
+#include <array>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
 
 #include <unicode/brkiter.h>
+#include <unicode/uchar.h>
+#include <unicode/utf16.h>
 #include <xg/canvas.hpp>
 
 using namespace std ;
@@ -53,9 +62,9 @@ bool TextLayoutEngine::itemizeBiDi(vector<DirectionRun> &d_runs, int32_t s_begin
 
 
 
-bool TextLayoutEngine::itemizeScript(vector<LangScriptRun> &runs) {
+bool TextLayoutEngine::itemizeScript(vector<LangScriptRun> &runs, int32_t start, int32_t end) {
 
-    ScriptRun script_run(us_.getBuffer(), us_.length());
+    ScriptRun script_run(us_.getBuffer(), start, end - start);
 
     while ( script_run.next() ) {
         int32_t run_start = script_run.getScriptStart();
@@ -141,34 +150,35 @@ public:
 
 } ;
 
-void TextLayoutEngine::breakLine(int32_t start, int32_t end) {
+// Shape the paragraph once and choose line breaks on the advances of its code units. Lines are sliced from the
+// shaped glyphs, only lines whose ends fall where shaping depends on the context (e.g. inside a ligature or
+// joining script) are shaped again on their own.
 
-    TextLine line(start, end);
+void TextLayoutEngine::breakLine(int32_t start, int32_t end) {
 
-    shape(line);
+    vector<ShapedItem> items ;
+    shapeItems(start, end, items) ;
 
-    if ( wrap_width_ < 0 || line.width_ < wrap_width_ ) {
-        addLine(std::move(line)) ;
-        return ;
-    }
+    double width = 0 ;
+    for( int32_t i = start ; i < end ; i++ ) width += advances_[i] ;
 
     BreakIterator *breakitr = ICUBreakIterator::instance().iterator() ;
 
-    if ( !breakitr ) {
-        addLine(std::move(line));
-        return;
+    if ( wrap_width_ < 0 || width < wrap_width_ || !breakitr ) {
+        sliceLine(items, start, end) ;
+        return ;
     }
 
-    breakitr->setText(us_) ;
-
+    if ( break_mode_ == xg::LineBreakMode::OptimalFit ) {
+        breakLineOptimal(items, start, end) ;
+        return ;
+    }
 
     double current_line_length = 0;
-    int last_break_position = static_cast<int>(line.first_);
-    for ( unsigned i=line.first_; i < line.last_; ++i )
+    int last_break_position = start ;
+    for ( int i=start; i < end; ++i )
     {
-        const auto width_itr = width_map_.find(i);
-        if ( width_itr != width_map_.end() )
-            current_line_length += width_itr->second;
+        current_line_length += advances_[i] ;
         if ( current_line_length <= wrap_width_ ) continue;
 
         int break_position = wrap_before_ ? breakitr->preceding(i + 1) : breakitr->following(i);
@@ -176,226 +186,659 @@ void TextLayoutEngine::breakLine(int32_t start, int32_t end) {
         if ( break_position <= last_break_position || break_position == static_cast<int>(BreakIterator::DONE) ) {
             break_position = breakitr->following(i) ;
             if ( break_position == static_cast<int>(BreakIterator::DONE) )
-                break_position = line.last_ ;
+                break_position = end ;
         }
-        if ( break_position < line.first_ )
-            break_position = line.first_ ;
 
-        if ( break_position > line.last_ )
-            break_position = line.last_ ;
+        if ( break_position > end )
+            break_position = end ;
+
+        bool adjust_for_space_character = break_position > 0 && charAt(break_position - 1) == 0x0020;
+        bool hyphen = break_position > 0 && charAt(break_position - 1) == 0x00AD ;
 
-        bool adjust_for_space_character = break_position > 0 && us_[break_position - 1] == 0x0020;
+        sliceLine(items, last_break_position, adjust_for_space_character ? break_position - 1 : break_position,
+                  hyphen, break_position == end) ;
 
-        TextLine new_line(last_break_position, adjust_for_space_character ? break_position - 1 : break_position);
-        clearWidths(last_break_position, adjust_for_space_character ? break_position - 1 : break_position);
-        shape(new_line);
-        addLine(std::move(new_line));
         last_break_position = break_position ;
         i = break_position - 1;
         current_line_length = 0;
     }
-    if ( last_break_position == line.first_ )
-        addLine(std::move(line));
-    else if ( last_break_position != line.last_ ) {
-        TextLine new_line(last_break_position, line.last_);
-        clearWidths(last_break_position, line.last_);
-        shape(new_line);
-        addLine(std::move(new_line));
+
+    if ( last_break_position != end )
+        sliceLine(items, last_break_position, end) ;
+}
+
+// Optimal fit line breaking (Knuth-Plass) over the break opportunities of the paragraph. For each break only the
+// previous breaks less than a line width away are tried, so the cost is the paragraph length times the number
+// of breaks per line. Best predecessors are kept per fitness class (tight, normal, loose, very loose) so that
+// adjacent lines of very different tightness can be penalized.
+
+void TextLayoutEngine::breakLineOptimal(const vector<ShapedItem> &items, int32_t start, int32_t end) {
+
+    BreakIterator *breakitr = ICUBreakIterator::instance().iterator() ;
+
+    vector<int32_t> breaks ;
+    breaks.push_back(start) ;
+    for( int32_t b = breakitr->following(start) ; b != static_cast<int32_t>(BreakIterator::DONE) && b < end ; b = breakitr->following(b) )
+        breaks.push_back(b) ;
+    breaks.push_back(end) ;
+
+    // prefix sums of the advances of all code units and of the spaces of the paragraph
+    size_t length = end - start ;
+    vector<double> advance(length + 1, 0.0), space(length + 1, 0.0) ;
+
+    for( size_t i=0 ; i<length ; i++ ) {
+        double adv = advances_[start + i] ;
+        advance[i+1] = advance[i] + adv ;
+        space[i+1] = space[i] + ( charAt(start + i) == 0x0020 ? adv : 0.0 ) ;
+    }
+
+    auto content_end = [&](int32_t a, int32_t b) {
+        while ( b > a && charAt(b-1) == 0x0020 ) --b ;
+        return b ;
+    } ;
+
+    auto is_hyphen = [&](int32_t b) {
+        return b > start && b < end && charAt(b-1) == 0x00AD ;
+    } ;
+
+    const double inf = std::numeric_limits<double>::infinity() ;
+    const double W = wrap_width_ ;
+
+    struct Node {
+        double demerits_ = std::numeric_limits<double>::infinity() ;
+        int prev_ = -1, prev_fitness_ = -1 ;
+    } ;
+
+    size_t n = breaks.size() ;
+    vector<std::array<Node, 4>> nodes(n) ;
+    nodes[0][1].demerits_ = 0 ;
+
+    for( size_t j=1 ; j<n ; j++ ) {
+        int32_t b = breaks[j] ;
+        bool last = ( j == n - 1 ), hyphen = is_hyphen(b) ;
+
+        for( int i = j - 1 ; i >= 0 ; i-- ) {
+            int32_t a = breaks[i] ;
+            int32_t e = content_end(a, b) ;
+
+            double w = advance[e - start] - advance[a - start] + ( hyphen ? hyphenWidth() : 0.0 ) ;
+            double spaces = space[e - start] - space[a - start] ;
+            double stretch = justify_ ? spaces * 0.5 : W / 3.0 ;
+            double shrink = justify_ ? spaces / 3.0 : 0.0 ;
+
+            // adjustment ratio of the line and its badness
+            double r ;
+            if ( w <= W ) r = last ? 0.0 : ( stretch > 0 ? ( W - w ) / stretch : inf ) ;
+            else r = shrink > 0 ? ( W - w ) / shrink : -inf ;
+
+            bool overfull = r < -1 ;
+
+            // longer lines can only be more overfull, a single overfull chunk is kept when it has no alternative
+            if ( overfull && i + 1 < (int)j ) break ;
+
+            double badness = overfull ? 10000 : std::min(100 * fabs(r * r * r), 10000.0) ;
+            int fitness = ( r < -0.5 ) ? 0 : ( r <= 0.5 ) ? 1 : ( r <= 1 ) ? 2 : 3 ;
+
+            double d = ( penalties_.line_ + badness ) * ( penalties_.line_ + badness ) ;
+            if ( hyphen ) d += penalties_.hyphen_ * penalties_.hyphen_ ;
+            if ( hyphen && is_hyphen(a) ) d += penalties_.consecutive_hyphens_ ;
+            if ( overfull ) d += 1.0e10 ;
+
+            for( int f=0 ; f<4 ; f++ ) {
+                const Node &pn = nodes[i][f] ;
+                if ( pn.demerits_ == inf ) continue ;
+
+                double total = pn.demerits_ + d ;
+                if ( !last && abs(fitness - f) > 1 ) total += penalties_.fitness_ ;
+
+                Node &node = nodes[j][fitness] ;
+                if ( total < node.demerits_ ) {
+                    node.demerits_ = total ;
+                    node.prev_ = i ;
+                    node.prev_fitness_ = f ;
+                }
+            }
+
+            if ( overfull ) break ;
+        }
+    }
+
+    // walk back from the best node at the paragraph end
+
+    int f = 0 ;
+    for( int k=1 ; k<4 ; k++ )
+        if ( nodes[n-1][k].demerits_ < nodes[n-1][f].demerits_ ) f = k ;
+
+    vector<size_t> chosen ;
+    for( int j = n - 1 ; j > 0 ; ) {
+        chosen.push_back(j) ;
+        const Node &node = nodes[j][f] ;
+        j = node.prev_ ;
+        f = node.prev_fitness_ ;
+        if ( j < 0 ) break ;
+    }
+
+    int32_t a = start ;
+    for( auto it = chosen.rbegin() ; it != chosen.rend() ; ++it ) {
+        int32_t b = breaks[*it] ;
+        sliceLine(items, a, content_end(a, b), is_hyphen(b), b == end) ;
+        a = b ;
     }
+}
 
+// range of glyphs of the item belonging to the code units [start, end). Clusters increase along the glyphs
+// of left to right items and decrease along right to left ones.
+
+static std::pair<size_t, size_t> glyph_range(const std::vector<uint> &clusters, bool rtl, uint start, uint end) {
+    if ( rtl ) {
+        auto first = std::upper_bound(clusters.begin(), clusters.end(), end, std::greater<uint>()) ;
+        auto last = std::upper_bound(clusters.begin(), clusters.end(), start, std::greater<uint>()) ;
+        return { first - clusters.begin(), last - clusters.begin() } ;
+    } else {
+        auto first = std::lower_bound(clusters.begin(), clusters.end(), start) ;
+        auto last = std::lower_bound(clusters.begin(), clusters.end(), end) ;
+        return { first - clusters.begin(), last - clusters.begin() } ;
+    }
 }
 
-bool TextLayoutEngine::getGlyphsAndClusters(hb_buffer_t *buffer,  GlyphCollection &glyphs) {
+// Itemize and shape the text span, recording the advances of each code unit
 
-    unsigned num_glyphs = hb_buffer_get_length(buffer);
-    if ( num_glyphs == 0 ) return false ;
+void TextLayoutEngine::shapeItems(int32_t start, int32_t end, vector<ShapedItem> &shaped)
+{
+    std::size_t length = end - start;
+
+    if ( !length ) return ;
+
+    // itemize text span
+    vector<TextItem> items ;
+    itemize(start, end, items);
 
-    glyphs.num_glyphs_ = num_glyphs ;
+    // prepare HarfBuzz shaping engine, unless a buffer was given
 
+    auto hb_buffer_deleter = [](hb_buffer_t * buffer) { hb_buffer_destroy(buffer);};
+    const std::unique_ptr<hb_buffer_t, decltype(hb_buffer_deleter)> own_buffer(buffer_ ? nullptr : hb_buffer_create(), hb_buffer_deleter);
+    hb_buffer_t *buffer = buffer_ ? buffer_ : own_buffer.get() ;
+
+    hb_buffer_pre_allocate(buffer, length);
+
+    for ( int32_t i = start ; i < end ; i++ ) advances_[i] = 0 ;
+
+    // perform shaping for each item, with unique script, direction
+
+    for ( const auto & text_item : items ) {
+
+        shaped.emplace_back() ;
+        ShapedItem &item = shaped.back() ;
+        item.start_ = text_item.start_ ;
+        item.end_ = text_item.end_ ;
+        item.dir_ = text_item.dir_ ;
+
+        shapeRun(buffer, text_item, text_item.start_, text_item.end_, nullptr, item) ;
+
+        // reshape the clusters that the font has no glyphs for with fallback fonts
+        for( const Glyph &g: item.glyphs_ ) {
+            if ( g.index_ == 0 ) {
+                applyFallback(buffer, text_item, item) ;
+                break ;
+            }
+        }
+
+        for( size_t i=0 ; i<item.glyphs_.size() ; i++ )
+            advances_[item.clusters_[i]] += item.glyphs_[i].x_advance_ ;
+    }
+}
+
+// Shape the code units [start, end) of the item with the face (the font itself when nullptr) and append the
+// glyphs to the shaped item. The whole text is given to HarfBuzz as context.
+
+void TextLayoutEngine::shapeRun(hb_buffer_t *buffer, const TextItem &text_item, uint start, uint end, cairo_font_face_t *face, ShapedItem &item)
+{
+    ShapingFont *font = shapingFont(face) ;
+    if ( !font ) return ;
+
+    // shape with the FreeType face when HarfBuzz cannot read the font file itself
+
+    hb_font_t *hb_font = font->hbFont() ;
+    FT_Face ft_face = nullptr ;
+
+    if ( !hb_font ) {
+        ft_face = cairo_ft_scaled_font_lock_face(font->scaledFont()) ;
+        if ( ft_face == 0 ) return ;
+        hb_font = hb_ft_font_create(ft_face, nullptr);
+    }
+
+    // initialize buffer with subtext and corresponding direction and script
+
+    hb_buffer_clear_contents(buffer);
+    if ( latin1_ )
+        hb_buffer_add_latin1(buffer, reinterpret_cast<const uint8_t *>(text_.data()), text_.size(), start, static_cast<int>(end - start));
+    else
+        hb_buffer_add_utf16(buffer, us_.getBuffer(), us_.length(), start, static_cast<int>(end - start));
+    hb_buffer_set_direction(buffer, text_item.dir_);
+
+    if ( !text_item.lang_.empty() )
+        hb_buffer_set_language(buffer, hb_language_from_string(text_item.lang_.c_str(), -1));
+
+    hb_buffer_set_script(buffer, text_item.script_);
+
+    // run shaper on this segment and font
+
+    hb_shape(hb_font, buffer, 0, 0);
+
+    unsigned num_glyphs = 0 ;
     hb_glyph_info_t *hb_glyphs = hb_buffer_get_glyph_infos(buffer, &num_glyphs);
     hb_glyph_position_t *hb_positions = hb_buffer_get_glyph_positions(buffer, &num_glyphs);
 
-    unsigned cluster = hb_glyphs[0].cluster ;
-    bool in_cluster = false;
+    item.glyphs_.reserve(item.glyphs_.size() + num_glyphs) ;
+    item.clusters_.reserve(item.clusters_.size() + num_glyphs) ;
+    item.unsafe_.reserve(item.unsafe_.size() + num_glyphs) ;
 
-    // collect clusters and associated glyphs
+    for ( unsigned i=0 ; i<num_glyphs ; i++ ) {
+        Glyph g(hb_glyphs[i].codepoint);
 
-    glyphs.clusters_.push_back(cluster) ;
+        g.x_advance_ = hb_positions[i].x_advance/64.0 ;
+        g.y_advance_ = hb_positions[i].y_advance/64.0 ;
+        g.x_offset_ = hb_positions[i].x_offset/64.0;
+        g.y_offset_ = hb_positions[i].y_offset/64.0 ;
+        g.face_ = face ;
 
-    for ( unsigned i = 0; i < num_glyphs; ++i ) {
-        if (cluster != hb_glyphs[i].cluster) {
-            cluster = hb_glyphs[i].cluster;
-            glyphs.clusters_.push_back(cluster) ;
-            in_cluster = false;
-        }
-        else in_cluster = true ;
+        item.glyphs_.emplace_back(std::move(g)) ;
+        item.clusters_.push_back(hb_glyphs[i].cluster) ;
+        item.unsafe_.push_back(hb_glyph_info_get_glyph_flags(&hb_glyphs[i]) & HB_GLYPH_FLAG_UNSAFE_TO_BREAK) ;
+    }
+
+    if ( ft_face ) {
+        hb_font_destroy(hb_font);
+        cairo_ft_scaled_font_unlock_face(font->scaledFont()) ;
+    }
+}
+
+// Replace the glyphs of clusters shaped to .notdef. The code points of these clusters are assigned to the first
+// fallback font covering them (combining marks and joiners stay with the preceding character) and each run of
+// code points with the same font is shaped again. The rest of the item keeps the glyphs of the first pass.
+
+void TextLayoutEngine::applyFallback(hb_buffer_t *buffer, const TextItem &text_item, ShapedItem &item)
+{
+    bool rtl = item.dir_ == HB_DIRECTION_RTL ;
+
+    // cluster start positions in logical order
+    vector<uint> starts(item.clusters_) ;
+    std::sort(starts.begin(), starts.end()) ;
+    starts.erase(std::unique(starts.begin(), starts.end()), starts.end()) ;
+
+    vector<bool> missing(item.end_ - item.start_, false) ;
 
-        if ( glyphs.glyphs_.size() <= cluster )
-            glyphs.glyphs_.resize(cluster + 1);
+    for( size_t i=0 ; i<item.glyphs_.size() ; i++ ) {
+        if ( item.glyphs_[i].index_ != 0 ) continue ;
 
-        auto &c = glyphs.glyphs_[cluster];
-        if (c.empty())
-            c.push_back({hb_glyphs[i], hb_positions[i]});
-        else if (c.front().glyph_.codepoint == 0)
-            c.front() = { hb_glyphs[i], hb_positions[i] };
-        else if (in_cluster)
-            c.push_back({ hb_glyphs[i], hb_positions[i] });
+        uint c = item.clusters_[i] ;
+        auto next = std::upper_bound(starts.begin(), starts.end(), c) ;
+        uint c_end = ( next == starts.end() ) ? item.end_ : *next ;
+
+        for( uint k = c ; k < c_end ; k++ ) missing[k - item.start_] = true ;
     }
 
-    // check if all clusters/characters have associated glyphs
+    // split the item in runs of code units kept from the first pass (reshape_ = false) or shaped with a face
 
-    bool all_set = true;
+    struct Run {
+        uint start_, end_ ;
+        bool reshape_ ;
+        cairo_font_face_t *face_ ;
+    } ;
 
-    for (const auto &c : glyphs.glyphs_)
-    {
-        if ( c.empty() || c.front().glyph_.codepoint == 0 ) {
-            all_set = false;
-            break;
+    vector<Run> runs ;
+    const UChar *text = unicodeText().getBuffer() ;
+
+    for( int32_t i = item.start_ ; i < (int32_t)item.end_ ; ) {
+        int32_t pos = i ;
+
+        if ( !missing[pos - item.start_] ) {
+            while ( i < (int32_t)item.end_ && !missing[i - item.start_] ) ++i ;
+            runs.push_back({(uint)pos, (uint)i, false, nullptr}) ;
+            continue ;
         }
+
+        UChar32 cp ;
+        U16_NEXT(text, i, (int32_t)item.end_, cp) ;
+
+        bool extend = u_hasBinaryProperty(cp, UCHAR_GRAPHEME_EXTEND) || cp == 0x200D ;
+
+        if ( extend && !runs.empty() && runs.back().reshape_ && runs.back().end_ == (uint)pos ) {
+            runs.back().end_ = i ;
+            continue ;
+        }
+
+        cairo_font_face_t *face = FontManager::instance().fallbackFace(desc_, cp) ;
+
+        if ( !runs.empty() && runs.back().reshape_ && runs.back().face_ == face && runs.back().end_ == (uint)pos )
+            runs.back().end_ = i ;
+        else
+            runs.push_back({(uint)pos, (uint)i, true, face}) ;
     }
 
-    return all_set ;
+    // assemble the glyphs of the runs in visual order
 
-}
+    ShapedItem result ;
+    result.start_ = item.start_ ;
+    result.end_ = item.end_ ;
+    result.dir_ = item.dir_ ;
 
+    if ( rtl ) std::reverse(runs.begin(), runs.end()) ;
 
-void TextLayoutEngine::clearWidths(int32_t start, int32_t end) {
-    for ( int32_t i = start; i<end; ++i )
-        width_map_[i] = 0 ;
+    for( const Run &run: runs ) {
+        if ( run.reshape_ ) {
+            shapeRun(buffer, text_item, run.start_, run.end_, run.face_, result) ;
+        } else {
+            auto r = glyph_range(item.clusters_, rtl, run.start_, run.end_) ;
+            for( size_t k = r.first ; k < r.second ; k++ ) {
+                result.glyphs_.push_back(item.glyphs_[k]) ;
+                result.clusters_.push_back(item.clusters_[k]) ;
+                result.unsafe_.push_back(item.unsafe_[k]) ;
+            }
+        }
+    }
+
+    item = std::move(result) ;
 }
 
-void TextLayoutEngine::fillGlyphInfo(GlyphCollection &glyphs, TextLine &line)
+// shaping font of a fallback face at the size of the font, the font itself for nullptr
+
+ShapingFont *TextLayoutEngine::shapingFont(cairo_font_face_t *face)
 {
+    if ( !face ) return font_.get() ;
 
-    // iterate all clusters
+    auto it = fallback_fonts_.find(face) ;
+    if ( it != fallback_fonts_.end() ) return it->second.get() ;
 
-    for (auto c_id : glyphs.clusters_)
-    {
-        // iterate over all glyphs in this cluster
+    std::shared_ptr<ShapingFont> font = FontManager::instance().shapingFont(face, desc_.size()) ;
+    fallback_fonts_[face] = font ;
+    return font.get() ;
+}
+
+bool TextLayoutEngine::unsafeToBreak(const vector<ShapedItem> &items, uint pos) const {
+    for( const ShapedItem &item: items ) {
+        // items are shaped independently so their boundaries are always safe
+        if ( pos <= item.start_ || pos >= item.end_ ) continue ;
+
+        bool rtl = item.dir_ == HB_DIRECTION_RTL ;
+        auto r = glyph_range(item.clusters_, rtl, pos, item.end_) ;
+
+        if ( r.first == r.second ) return true ;
+
+        // first glyph at or after pos in logical order
+        size_t idx = rtl ? r.second - 1 : r.first ;
+
+        // breaking inside a cluster
+        if ( item.clusters_[idx] != pos ) return true ;
+
+        return item.unsafe_[idx] ;
+    }
+
+    return false ;
+}
+
+void TextLayoutEngine::sliceLine(const vector<ShapedItem> &items, uint start, uint end, bool hyphen, bool last) {
 
-        auto &c = glyphs.glyphs_[c_id] ;
+    TextLine line(start, end) ;
 
-        for ( auto const& info : c ) {
+    // the line has to be shaped on its own if breaking changes the shaping of the glyphs at its ends
+    vector<ShapedItem> reshaped ;
+    const vector<ShapedItem> *src = &items ;
 
-            auto const& gpos = info.position_ ;
-            auto const& glyph = info.glyph_ ;
+    if ( unsafeToBreak(items, start) || unsafeToBreak(items, end) ) {
+        shapeItems(start, end, reshaped) ;
+        src = &reshaped ;
+    }
 
-            unsigned char_index = glyph.cluster;
-            Glyph g(glyph.codepoint);
+    vector<uint> clusters ;
 
-            g.x_advance_ = gpos.x_advance/64.0 ;
-            g.y_advance_ = gpos.y_advance/64.0 ;
-            g.x_offset_ = gpos.x_offset/64.0;
-            g.y_offset_ = gpos.y_offset/64.0 ;
+    for( const ShapedItem &item: *src ) {
+        if ( item.end_ <= start || item.start_ >= end ) continue ;
 
-            width_map_[char_index] += g.x_advance_  ;
+        auto r = glyph_range(item.clusters_, item.dir_ == HB_DIRECTION_RTL, start, end) ;
 
+        for( size_t i = r.first ; i < r.second ; i++ ) {
+            Glyph g(item.glyphs_[i]) ;
             line.addGlyph(std::move(g)) ;
+            clusters.push_back(item.clusters_[i]) ;
         }
     }
+
+    if ( hyphen && hyphenWidth() > 0 ) {
+        Glyph g(hyphen_glyph_) ;
+        g.x_advance_ = hyphen_width_ ;
+        g.y_advance_ = g.x_offset_ = g.y_offset_ = 0 ;
+        line.addGlyph(std::move(g)) ;
+        clusters.push_back(end) ;
+    }
+
+    if ( justify_ && !last ) justifyLine(line, clusters) ;
+
+    computeLineMetrics(line) ;
+
+    addLine(std::move(line)) ;
 }
 
-void TextLayoutEngine::makeCairoGlyphsAndMetrics(TextLine &line) {
+// Metrics of the text shaped with the font alone, one line per paragraph, without building lines of glyphs. Text
+// that needs fallback fonts (or a font HarfBuzz cannot read) is laid out instead.
 
-    cairo_font_extents_t f_extents ;
-    cairo_scaled_font_extents (font_, &f_extents);
+xg::TextMetrics TextLayoutEngine::measure(hb_buffer_t *buffer)
+{
+    xg::TextMetrics m ;
 
-    line.height_ = f_extents.height ;
+    if ( !font_ ) return m ;
 
-    uint num_glyphs = line.glyphs_.size() ;
+    const cairo_font_extents_t &fe = font_->extents() ;
+    m.ascent_ = fe.ascent ;
+    m.descent_ = fe.descent ;
 
-    double x = 0, y = 0 ;
-    cairo_glyph_t *cairo_glyphs = cairo_glyph_allocate (num_glyphs + 1);
+    hb_font_t *hb_font = font_->hbFont() ;
+    if ( !hb_font ) return measureLines() ;
 
-    unsigned i ;
+    int32_t start = 0, length = textLength() ;
+    double y = 0 ;
 
-    for (i=0; i<num_glyphs; i++) {
-        cairo_glyphs[i].index = line.glyphs_[i].index_ ;
-        cairo_glyphs[i].x = x + line.glyphs_[i].x_offset_ ;
-        cairo_glyphs[i].y = y - line.glyphs_[i].y_offset_ ;
+    while ( true ) {
+        int32_t end = indexOf('\n', start) ;
+        if ( end < 0 ) end = length ;
 
-        x +=  line.glyphs_[i].x_advance_;
-    }
+        vector<TextItem> items ;
+        if ( start < end && !itemize(start, end, items) ) return measureLines() ;
 
-    cairo_text_extents_t extents ;
-    cairo_scaled_font_glyph_extents(font_, cairo_glyphs, num_glyphs, &extents);
+        double x = 0 ;
 
-    double ascent = -extents.y_bearing ;
-    double descent = extents.height + extents.y_bearing ;
+        for( const TextItem &item: items ) {
+            hb_buffer_clear_contents(buffer) ;
+            if ( latin1_ )
+                hb_buffer_add_latin1(buffer, reinterpret_cast<const uint8_t *>(text_.data()), length, item.start_, static_cast<int>(item.end_ - item.start_)) ;
+            else
+                hb_buffer_add_utf16(buffer, us_.getBuffer(), length, item.start_, static_cast<int>(item.end_ - item.start_)) ;
+            hb_buffer_set_direction(buffer, item.dir_) ;
+            if ( !item.lang_.empty() )
+                hb_buffer_set_language(buffer, hb_language_from_string(item.lang_.c_str(), -1)) ;
+            hb_buffer_set_script(buffer, item.script_) ;
 
- //   line.glyphs_ = cairo_glyphs ;
-    line.ascent_ = ascent ;
-    line.descent_ = descent ;
+            hb_shape(hb_font, buffer, 0, 0) ;
+
+            unsigned num_glyphs = 0 ;
+            hb_glyph_info_t *hb_glyphs = hb_buffer_get_glyph_infos(buffer, &num_glyphs) ;
+            hb_glyph_position_t *hb_positions = hb_buffer_get_glyph_positions(buffer, &num_glyphs) ;
+
+            for( unsigned i=0 ; i<num_glyphs ; i++ ) {
+                if ( hb_glyphs[i].codepoint == 0 ) return measureLines() ;
+
+                const cairo_text_extents_t &e = font_->glyphExtents(hb_glyphs[i].codepoint) ;
+                if ( e.width > 0 && e.height > 0 ) {
+                    double gx = x + hb_positions[i].x_offset/64.0, gy = y - hb_positions[i].y_offset/64.0 ;
+                    m.ink_ = m.ink_.united(xg::Rectangle2d(gx + e.x_bearing, gy + e.y_bearing, e.width, e.height)) ;
+                }
+
+                x += hb_positions[i].x_advance/64.0 ;
+            }
+        }
+
+        m.width_ = std::max(m.width_, x) ;
+        m.height_ += fe.height ;
+
+        if ( end == length ) break ;
+
+        start = end + 1 ;
+        y += fe.height ;
+    }
+
+    return m ;
 }
 
-bool TextLayoutEngine::shape(TextLine &line)
+// metrics of the laid out lines, the ink box of each line spans its ascent and descent
+
+xg::TextMetrics TextLayoutEngine::measureLines()
 {
-    unsigned start = line.first_ ;
-    unsigned end = line.last_ ;
-    std::size_t length = end - start;
+    xg::TextMetrics m ;
 
-    if ( !length ) return true ;
+    run() ;
 
-    // itemize text span
-    vector<TextItem> items ;
-    itemize(start, end, items);
+    if ( font_ ) {
+        m.ascent_ = font_->extents().ascent ;
+        m.descent_ = font_->extents().descent ;
+    }
 
-    // prepare HarfBuzz shaping engine
+    m.width_ = width_ ;
 
-    line.glyphs_.reserve(length);
+    for( const TextLine &line: lines_ ) {
+        if ( line.width_ > 0 )
+            m.ink_ = m.ink_.united(xg::Rectangle2d(0, m.height_ - line.ascent_, line.width_, line.ascent_ + line.descent_)) ;
+        m.height_ += line.height_ ;
+    }
 
-    auto hb_buffer_deleter = [](hb_buffer_t * buffer) { hb_buffer_destroy(buffer);};
-    const std::unique_ptr<hb_buffer_t, decltype(hb_buffer_deleter)> buffer(hb_buffer_create(), hb_buffer_deleter);
+    return m ;
+}
 
-    hb_buffer_pre_allocate(buffer.get(), length);
+// Lay out the text without wrapping and append its glyphs with their origins relative to the first baseline
 
-    // perform shaping for each item, with unique script, direction
+xg::TextMetrics TextLayoutEngine::layoutGlyphs(hb_buffer_t *buffer, vector<Glyph> &glyphs, vector<xg::Point2d> &positions)
+{
+    buffer_ = buffer ;
+    xg::TextMetrics m = measureLines() ;
+    buffer_ = nullptr ;
 
-    for ( const auto & text_item : items ) {
+    double y = 0 ;
+
+    for( const TextLine &line: lines_ ) {
+        double x = 0 ;
+
+        for( const Glyph &g: line.glyphs_ ) {
+            positions.emplace_back(x + g.x_offset_, y - g.y_offset_) ;
+            glyphs.push_back(g) ;
+            x += g.x_advance_ ;
+        }
+
+        y += line.height_ ;
+    }
+
+    return m ;
+}
 
-        GlyphCollection glyphs ;
+// distribute the space left up to the wrap width evenly to the space glyphs of the line
 
-        // initialize buffer with subtext and corresponding direction and script
+void TextLayoutEngine::justifyLine(TextLine &line, const vector<uint> &clusters) {
+    double extra = wrap_width_ - line.width_ ;
+    if ( extra <= 0 ) return ;
 
-        hb_buffer_clear_contents(buffer.get());
-        hb_buffer_add_utf16(buffer.get(), us_.getBuffer(), us_.length(), text_item.start_, static_cast<int>(text_item.end_ - text_item.start_));
-        hb_buffer_set_direction(buffer.get(), text_item.dir_);
+    unsigned n_spaces = 0 ;
+    for( uint c: clusters ) if ( charAt(c) == 0x0020 ) ++n_spaces ;
 
-        if ( !text_item.lang_.empty() )
-            hb_buffer_set_language(buffer.get(), hb_language_from_string(text_item.lang_.c_str(), -1));
+    if ( n_spaces == 0 ) return ;
 
-        hb_buffer_set_script(buffer.get(), text_item.script_);
+    for( size_t i=0 ; i<clusters.size() ; i++ )
+        if ( charAt(clusters[i]) == 0x0020 ) line.glyphs_[i].x_advance_ += extra / n_spaces ;
 
-        //   hb_ft_font_set_load_flags(font,FT_LOAD_DEFAULT | FT_LOAD_NO_HINTING);
+    line.width_ += extra ;
+}
 
-        FT_Face ft_face = cairo_ft_scaled_font_lock_face(font_) ;
+// width of the hyphen drawn at lines broken at a soft hyphen, 0 if the font has no hyphen glyph
 
-        if ( ft_face == 0 ) continue ;
+double TextLayoutEngine::hyphenWidth() {
+    if ( hyphen_glyph_ >= 0 ) return hyphen_width_ ;
 
-        hb_font_t *hb_font = hb_ft_font_create(ft_face, nullptr);
+    hyphen_glyph_ = 0 ;
 
-        // run shaper on this segment and font
+    if ( !font_ ) return hyphen_width_ ;
+
+    hb_font_t *hb_font = font_->hbFont() ;
+    FT_Face ft_face = nullptr ;
+
+    if ( !hb_font ) {
+        ft_face = cairo_ft_scaled_font_lock_face(font_->scaledFont()) ;
+        if ( !ft_face ) return hyphen_width_ ;
+        hb_font = hb_ft_font_create(ft_face, nullptr);
+    }
 
-        hb_shape(hb_font, buffer.get(), 0, 0);
+    hb_codepoint_t glyph ;
+    if ( hb_font_get_glyph(hb_font, 0x2010, 0, &glyph) || hb_font_get_glyph(hb_font, '-', 0, &glyph) ) {
+        hyphen_glyph_ = glyph ;
+        hyphen_width_ = hb_font_get_glyph_h_advance(hb_font, glyph)/64.0 ;
+    }
 
+    if ( ft_face ) {
         hb_font_destroy(hb_font);
+        cairo_ft_scaled_font_unlock_face(font_->scaledFont()) ;
+    }
 
-        cairo_ft_scaled_font_unlock_face(font_) ;
+    return hyphen_width_ ;
+}
 
-        // get resulting glyphs and find which of the characters were correctly mapped by the current font face
+// line height from the font extents, ascent and descent from the ink extents of the glyphs (cached per font)
 
-        getGlyphsAndClusters(buffer.get(), glyphs) ;
+void TextLayoutEngine::computeLineMetrics(TextLine &line) {
 
-        fillGlyphInfo(glyphs, line);
-    }
+    line.ascent_ = line.descent_ = 0 ;
+
+    if ( !font_ ) return ;
+
+    line.height_ = font_->extents().height * line_spacing_ ;
+
+    double ascent = 0, descent = 0 ;
 
-    makeCairoGlyphsAndMetrics(line) ;
+    for ( const Glyph &g: line.glyphs_ ) {
+        ShapingFont *font = shapingFont(static_cast<cairo_font_face_t *>(g.face_)) ;
+        if ( !font ) continue ;
 
+        const cairo_text_extents_t &e = font->glyphExtents(g.index_) ;
+        if ( e.width <= 0 || e.height <= 0 ) continue ;
+
+        ascent = std::max(ascent, g.y_offset_ - e.y_bearing) ;
+        descent = std::max(descent, e.height + e.y_bearing - g.y_offset_) ;
+    }
+
+    line.ascent_ = ascent ;
+    line.descent_ = descent ;
 }
 
 bool TextLayoutEngine::itemize(int32_t start, int32_t end, vector<TextItem> &items) {
     using namespace icu ;
 
+    // Latin-1 has no right to left characters and its letters are all Latin, so the text is a single item
+    if ( latin1_ ) {
+        static const string latin_lang = ScriptRun::detectLanguage(HB_SCRIPT_LATIN) ;
+        static const string common_lang = ScriptRun::detectLanguage(HB_SCRIPT_COMMON) ;
+
+        bool letters = false ;
+        for( int32_t i = start ; i < end && !letters ; i++ ) {
+            unsigned char c = text_[i] ;
+            letters = ( ( c | 0x20 ) >= 'a' && ( c | 0x20 ) <= 'z' ) || ( c >= 0xC0 && c != 0xD7 && c != 0xF7 ) || c == 0xAA || c == 0xBA ;
+        }
+
+        TextItem item ;
+        item.start_ = start ;
+        item.end_ = end ;
+        item.script_ = letters ? HB_SCRIPT_LATIN : HB_SCRIPT_COMMON ;
+        item.lang_ = letters ? latin_lang : common_lang ;
+        item.dir_ = bidi_mode_ == xg::TextDirection::RightToLeft ? HB_DIRECTION_RTL : HB_DIRECTION_LTR ;
+        items.push_back(item) ;
+
+        return true ;
+    }
+
     // itemize directions
     vector<DirectionRun> dir_runs ;
     if ( bidi_mode_ == xg::TextDirection::Auto ) {
@@ -408,7 +851,7 @@ bool TextLayoutEngine::itemize(int32_t start, int32_t end, vector<TextItem> &ite
 
     // itemize scripts
     vector<LangScriptRun> script_runs ;
-    if ( !itemizeScript(script_runs) ) return false ;
+    if ( !itemizeScript(script_runs, start, end) ) return false ;
 
     mergeRuns(script_runs, dir_runs, items);
 
@@ -416,29 +859,97 @@ bool TextLayoutEngine::itemize(int32_t start, int32_t end, vector<TextItem> &ite
 }
 
 
-TextLayoutEngine::TextLayoutEngine(const string &text, const Font &f) {
-    font_ =  FontManager::instance().createFont(f) ;
-    us_ = UnicodeString::fromUTF8(text) ;
+TextLayoutEngine::TextLayoutEngine(const string &text, const Font &f):
+    TextLayoutEngine(text, f, FontManager::instance().shapingFont(f)) {
 }
 
-void TextLayoutEngine::setWrapWidth(double w) {
-    wrap_width_ = w ;
+// Convert UTF-8 text to Latin-1 if all its characters are below U+0100. The ASCII prefix (usually all of it) is
+// checked eight bytes at a time.
+
+static bool to_latin1(const string &text, string &latin1) {
+    const char *p = text.data(), *e = p + text.size() ;
+
+    for( ; e - p >= 8 ; p += 8 ) {
+        uint64_t w ;
+        memcpy(&w, p, 8) ;
+        if ( w & 0x8080808080808080ull ) break ;
+    }
+
+    while ( p < e && !( *p & 0x80 ) ) ++p ;
+
+    if ( p == e ) {
+        latin1 = text ;
+        return true ;
+    }
+
+    latin1.assign(text.data(), p) ;
+
+    while ( p < e ) {
+        unsigned char c = *p ;
+
+        if ( c < 0x80 ) {
+            latin1 += static_cast<char>(c) ;
+            ++p ;
+        }
+        else if ( ( c == 0xC2 || c == 0xC3 ) && e - p >= 2 && ( p[1] & 0xC0 ) == 0x80 ) {
+            latin1 += static_cast<char>( ( ( c & 0x03 ) << 6 ) | ( p[1] & 0x3F ) ) ;
+            p += 2 ;
+        }
+        else return false ;
+    }
+
+    return true ;
 }
 
-TextLayoutEngine::~TextLayoutEngine() {
-    cairo_scaled_font_destroy(font_) ;
+TextLayoutEngine::TextLayoutEngine(const string &text, const Font &f, const std::shared_ptr<ShapingFont> &font):
+    desc_(f), font_(font) {
+    latin1_ = to_latin1(text, text_) ;
+    if ( !latin1_ ) {
+        text_.clear() ;
+        us_ = UnicodeString::fromUTF8(text) ;
+    }
 }
 
+int32_t TextLayoutEngine::indexOf(UChar c, int32_t start) const {
+    if ( !latin1_ ) return us_.indexOf(c, start) ;
+
+    size_t pos = text_.find(static_cast<char>(c), start) ;
+    return pos == string::npos ? -1 : static_cast<int32_t>(pos) ;
+}
+
+const UnicodeString &TextLayoutEngine::unicodeText() {
+    if ( latin1_ && us_.length() != textLength() ) {
+        int32_t n = textLength() ;
+        UChar *buf = us_.getBuffer(n) ;
+        for( int32_t i=0 ; i<n ; i++ ) buf[i] = static_cast<unsigned char>(text_[i]) ;
+        us_.releaseBuffer(n) ;
+    }
+
+    return us_ ;
+}
+
+void TextLayoutEngine::setWrapWidth(double w) {
+    wrap_width_ = w ;
+}
 
 bool TextLayoutEngine::run() {
     int32_t start = 0, end = 0;
 
-    while ( (end = us_.indexOf('\n', start)) > 0 ) {
+    lines_.clear() ;
+    width_ = 0 ;
+    advances_.assign(textLength(), 0.0) ;
+
+    if ( wrap_width_ >= 0 ) {
+        if ( BreakIterator *breakitr = ICUBreakIterator::instance().iterator() )
+            breakitr->setText(unicodeText()) ;
+    }
+
+    while ( (end = indexOf('\n', start)) > 0 ) {
         breakLine(start, end) ;
         start = end+1;
     }
 
-    breakLine(start, us_.length()) ;
+    breakLine(start, textLength()) ;
 
     computeHeight() ;
 
@@ -12,10 +12,13 @@
 #include <unicode/ubidi.h>
 
 #include "scrptrun.h"
+#include "font_manager.hpp"
 #include <cairo/cairo.h>
 
 #include <string>
+#include <vector>
 #include <map>
+#include <memory>
 
 using xg::Glyph ;
 using xg::TextLine ;
@@ -23,18 +26,28 @@ using xg::TextLine ;
 class TextLayoutEngine {
 public:
     TextLayoutEngine(const std::string &text, const xg::Font &f) ;
+    // shape with the given font of f, e.g. one shared by many layouts
+    TextLayoutEngine(const std::string &text, const xg::Font &f, const std::shared_ptr<ShapingFont> &font) ;
 
     void setWrapWidth(double w) ;
     void setTextDirection(xg::TextDirection dir) { bidi_mode_ = dir ; }
+    void setLineSpacing(double ls) { line_spacing_ = ls ; }
+    void setLineBreakMode(xg::LineBreakMode mode) { break_mode_ = mode ; }
+    void setLineBreakPenalties(const xg::LineBreakPenalties &p) { penalties_ = p ; }
+    void setJustify(bool justify) { justify_ = justify ; }
     bool run() ;
 
+    // metrics of the text without line wrapping, the buffer is used for shaping
+    xg::TextMetrics measure(hb_buffer_t *buffer) ;
+
+    // glyphs and metrics of the text laid out without wrapping (lines at newlines), shaping with the buffer
+    xg::TextMetrics layoutGlyphs(hb_buffer_t *buffer, std::vector<Glyph> &glyphs, std::vector<xg::Point2d> &positions) ;
+
     const std::vector<TextLine> &lines() const { return lines_ ; }
 
     double width() const { return width_ ; }
     double height() const { return height_ ; }
 
-    ~TextLayoutEngine();
-
 private:
 
 
@@ -54,44 +67,63 @@ private:
     using DirectionRun = std::tuple<hb_direction_t, uint, uint> ;
     using LangScriptRun = std::tuple<hb_script_t, uint, uint> ;
 
+    // glyphs of an item shaped by HarfBuzz in visual order, with the code unit (cluster) each glyph belongs to
+    struct ShapedItem {
+        uint start_, end_ ;
+        hb_direction_t dir_ ;
+        std::vector<Glyph> glyphs_ ;
+        std::vector<uint> clusters_ ;
+        std::vector<bool> unsafe_ ;  // breaking before the cluster of the glyph changes shaping
+    } ;
+
     bool itemize(int32_t start, int32_t end, std::vector<TextItem> &items) ;
     bool itemizeBiDi(std::vector<DirectionRun> &d_runs, int32_t start, int32_t end) ;
-    bool itemizeScript(std::vector<LangScriptRun> &runs) ;
+    bool itemizeScript(std::vector<LangScriptRun> &runs, int32_t start, int32_t end) ;
     void mergeRuns(const std::vector<LangScriptRun> &script_runs, const std::vector<DirectionRun> &dir_runs, std::vector<TextItem> &items) ;
     void breakLine(int32_t start, int32_t end) ;
-    bool shape(TextLine &line) ;
-
-    struct GlyphInfo {
-        hb_glyph_info_t glyph_;
-        hb_glyph_position_t position_;
-    };
-
-    struct GlyphCollection {
-        unsigned num_glyphs_ ;
-        std::vector<std::vector<GlyphInfo>> glyphs_ ;
-        std::vector<unsigned> clusters_ ;
-    } ;
-
-    bool getGlyphsAndClusters(hb_buffer_t *buffer, GlyphCollection &glyphs) ;
-    void fillGlyphInfo(GlyphCollection &glyphs, TextLine &line) ;
-    void clearWidths(int32_t start, int32_t end) ;
+    void breakLineOptimal(const std::vector<ShapedItem> &items, int32_t start, int32_t end) ;
+    void shapeItems(int32_t start, int32_t end, std::vector<ShapedItem> &items) ;
+    void shapeRun(hb_buffer_t *buffer, const TextItem &text_item, uint start, uint end, cairo_font_face_t *face, ShapedItem &item) ;
+    void applyFallback(hb_buffer_t *buffer, const TextItem &text_item, ShapedItem &item) ;
+    ShapingFont *shapingFont(cairo_font_face_t *face) ;
+    bool unsafeToBreak(const std::vector<ShapedItem> &items, uint pos) const ;
+    void sliceLine(const std::vector<ShapedItem> &items, uint start, uint end, bool hyphen = false, bool last = true) ;
+    void justifyLine(TextLine &line, const std::vector<uint> &clusters) ;
+    double hyphenWidth() ;
     void addLine(TextLine&& line) ;
-    void makeCairoGlyphsAndMetrics(TextLine &line);
+    void computeLineMetrics(TextLine &line);
+    xg::TextMetrics measureLines() ;
     void computeHeight();
 
+    // code units of the text, Latin-1 text is kept as bytes which are also its UTF-16 code units
+    int32_t textLength() const { return latin1_ ? static_cast<int32_t>(text_.size()) : us_.length() ; }
+    UChar charAt(int32_t i) const { return latin1_ ? static_cast<unsigned char>(text_[i]) : us_[i] ; }
+    int32_t indexOf(UChar c, int32_t start) const ;
+    const UnicodeString &unicodeText() ;
+
 private:
-    UnicodeString us_ ;
-    cairo_scaled_font_t *font_ ;
-    std::map<unsigned,double> width_map_ ;
+    std::string text_ ;     // Latin-1 text, shaped without itemization
+    bool latin1_ = false ;
+    UnicodeString us_ ;     // UTF-16 text, converted on first use (e.g. by the break iterator) for Latin-1 text
+    xg::Font desc_ ;
+    std::shared_ptr<ShapingFont> font_ ;
+    std::map<cairo_font_face_t *, std::shared_ptr<ShapingFont>> fallback_fonts_ ;
+    std::vector<double> advances_ ;  // advance of the glyphs of each code unit of us_
     double wrap_width_ = -1 ;
 
     std::vector<TextLine> lines_ ;
     double width_ = 0, height_ = 0 ;
-    unsigned glyphs_count_ ;
     char wrap_char_ = ' ';
     bool wrap_before_ = true ;
     bool repeat_wrap_char_ = false;
     xg::TextDirection bidi_mode_ = xg::TextDirection::Auto;
+    xg::LineBreakMode break_mode_ = xg::LineBreakMode::Greedy ;
+    xg::LineBreakPenalties penalties_ ;
+    double line_spacing_ = 1.0 ;
+    bool justify_ = false ;
+    int hyphen_glyph_ = -1 ;        // glyph drawn at the end of lines broken at a soft hyphen
+    double hyphen_width_ = 0 ;
+    hb_buffer_t *buffer_ = nullptr ;    // shaping buffer given by the caller, a new one is created for each paragraph otherwise
 
 
 } ;
@@ -2,6 +2,7 @@
 
 #include <png.h>
 #include <cassert>
+#include <cstring>
 #include <sstream>
 
 using namespace std ;
@@ -88,6 +89,8 @@ bool Image::png_write(W &writer) {
         color_type = PNG_COLOR_TYPE_RGB ;
     else if ( format_ == ImageFormat::ARGB32 )
         color_type = PNG_COLOR_TYPE_RGBA ;
+    else
+        color_type = PNG_COLOR_TYPE_GRAY ;
 
     bit_depth = 8 ;
 
@@ -136,6 +139,10 @@ bool Image::png_write(W &writer) {
                 *dst++ = src[3] ;
             }
 
+            row_pointers[row] = (png_bytep)data ;
+        } else if ( format_ == ImageFormat::A8 ) {
+            png_bytep data = new png_byte [width_] ;
+            memcpy(data, p, width_) ;
             row_pointers[row] = (png_bytep)data ;
         } else {
             png_bytep data = new png_byte [width_ * 3], dst = data ;
@@ -282,6 +289,9 @@ Image::Image(unsigned int width, unsigned int height, ImageFormat fmt): width_(w
     case ImageFormat::ARGB32:
         stride_ = bytes_per_line(width_, 8, 4) ;
         break ;
+    case ImageFormat::A8:
+        stride_ = bytes_per_line(width_, 8, 1) ;
+        break ;
     }
 
     pixels_.reset(new char [height_ * stride_]) ;
@@ -0,0 +1,73 @@
+#include <xg/marker.hpp>
+
+#include <cmath>
+
+using namespace std ;
+
+namespace xg {
+
+static void regular_polygon(Path &p, int n, double r, double start_angle) {
+    for( int i=0 ; i<n ; i++ ) {
+        double a = start_angle + 2 * M_PI * i / n ;
+        if ( i == 0 ) p.moveTo(r * cos(a), r * sin(a)) ;
+        else p.lineTo(r * cos(a), r * sin(a)) ;
+    }
+    p.closePath() ;
+}
+
+Path markerPath(MarkerShape shape)
+{
+    Path p ;
+
+    switch ( shape ) {
+    case MarkerShape::Circle:
+        p.addEllipse(0, 0, 0.5, 0.5) ;
+        break ;
+    case MarkerShape::Point:
+        p.addEllipse(0, 0, 0.15, 0.15) ;
+        break ;
+    case MarkerShape::Square:
+        p.addRect(-0.5, -0.5, 1, 1) ;
+        break ;
+    case MarkerShape::Diamond:
+        regular_polygon(p, 4, 0.5, -M_PI/2) ;
+        break ;
+    case MarkerShape::XMark:
+        p.moveTo(-0.5, -0.5).lineTo(0.5, 0.5) ;
+        p.moveTo(-0.5, 0.5).lineTo(0.5, -0.5) ;
+        break ;
+    case MarkerShape::Plus:
+        p.moveTo(-0.5, 0).lineTo(0.5, 0) ;
+        p.moveTo(0, -0.5).lineTo(0, 0.5) ;
+        break ;
+    case MarkerShape::Star: {
+        // five pointed star, alternating outer and inner vertices
+        const double ri = 0.5 * 0.381966 ;
+        for( int i=0 ; i<10 ; i++ ) {
+            double a = -M_PI/2 + M_PI * i / 5 ;
+            double r = ( i % 2 ) ? ri : 0.5 ;
+            if ( i == 0 ) p.moveTo(r * cos(a), r * sin(a)) ;
+            else p.lineTo(r * cos(a), r * sin(a)) ;
+        }
+        p.closePath() ;
+        break ;
+    }
+    // y axis points down
+    case MarkerShape::TriangleUp:
+        regular_polygon(p, 3, 0.5, -M_PI/2) ;
+        break ;
+    case MarkerShape::TriangleDown:
+        regular_polygon(p, 3, 0.5, M_PI/2) ;
+        break ;
+    case MarkerShape::TriangleLeft:
+        regular_polygon(p, 3, 0.5, M_PI) ;
+        break ;
+    case MarkerShape::TriangleRight:
+        regular_polygon(p, 3, 0.5, 0) ;
+        break ;
+    }
+
+    return p ;
+}
+
+}
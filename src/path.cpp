@@ -1,12 +1,37 @@
 #include <xg/path.hpp>
 
 #include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cassert>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace std ;
 
 namespace xg {
 
+Path::Path(const Path &other): data_(std::atomic_load(&other.data_)), cmds_(other.cmds_),
+    cx_(other.cx_), cy_(other.cy_), rx_(other.rx_), ry_(other.ry_), previous_cmd_(other.previous_cmd_) {
+}
+
+Path &Path::operator=(const Path &other) {
+    if ( this != &other ) {
+        data_ = std::atomic_load(&other.data_) ;
+        cmds_ = other.cmds_ ;
+        cx_ = other.cx_ ; cy_ = other.cy_ ;
+        rx_ = other.rx_ ; ry_ = other.ry_ ;
+        previous_cmd_ = other.previous_cmd_ ;
+    }
+    return *this ;
+}
+
 void Path::addCommand(Command cmd, double arg0, double arg1, double arg2, double arg3, double arg4, double arg5)
 {
+    data_.reset() ;
+
     switch ( cmd )
     {
     case MoveToCmd:
@@ -416,6 +441,7 @@ Path &Path::addRoundedRect(double xp, double yp, double wp, double hp, double rx
 }
 
 Path & Path::addPath(const Path &other) {
+    data_.reset() ;
     std::copy(other.cmds_.begin(), other.cmds_.end(),
               std::back_inserter(cmds_)) ;
 
@@ -444,69 +470,470 @@ Path &Path::addPolyline(const std::vector<Point2d> &pts)
 
 }
 
+// Batch transformation kernels. A point (x, y) is mapped as x * [m1 m2] + y * [m3 m4] + [m5 m6]
+// which maps directly to two packed multiply-adds when SSE2 is available.
+
+namespace {
+
+#ifdef __SSE2__
+
+class PointTransform {
+public:
+    PointTransform(const Matrix2d &m):
+        c0_(_mm_set_pd(m.m2(), m.m1())), c1_(_mm_set_pd(m.m4(), m.m3())), t_(_mm_set_pd(m.m6(), m.m5())) {}
+
+    void apply(double &x, double &y) const {
+        __m128d r = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(x), c0_),
+                                          _mm_mul_pd(_mm_set1_pd(y), c1_)), t_) ;
+        _mm_storel_pd(&x, r) ;
+        _mm_storeh_pd(&y, r) ;
+    }
+
+private:
+    __m128d c0_, c1_, t_ ;
+} ;
+
+// accumulates min/max of (x, y) pairs in a single register each
+
+class ExtentAccumulator {
+public:
+    ExtentAccumulator():
+        min_(_mm_set1_pd(std::numeric_limits<double>::max())),
+        max_(_mm_set1_pd(-std::numeric_limits<double>::max())) {}
+
+    void extend(double x, double y) {
+        __m128d p = _mm_set_pd(y, x) ;
+        min_ = _mm_min_pd(min_, p) ;
+        max_ = _mm_max_pd(max_, p) ;
+    }
+
+    Rectangle2d rect() const {
+        double lo[2], hi[2] ;
+        _mm_storeu_pd(lo, min_) ;
+        _mm_storeu_pd(hi, max_) ;
+        return Rectangle2d({lo[0], lo[1]}, {hi[0], hi[1]}) ;
+    }
+
+private:
+    __m128d min_, max_ ;
+} ;
+
+#else
+
+class PointTransform {
+public:
+    PointTransform(const Matrix2d &m): m_(m) {}
+
+    void apply(double &x, double &y) const {
+        double tx = x * m_.m1() + y * m_.m3() + m_.m5() ;
+        double ty = x * m_.m2() + y * m_.m4() + m_.m6() ;
+        x = tx ; y = ty ;
+    }
+
+private:
+    Matrix2d m_ ;
+} ;
+
+class ExtentAccumulator {
+public:
+    void extend(double x, double y) {
+        minx_ = std::min(minx_, x) ; miny_ = std::min(miny_, y) ;
+        maxx_ = std::max(maxx_, x) ; maxy_ = std::max(maxy_, y) ;
+    }
+
+    Rectangle2d rect() const {
+        return Rectangle2d({minx_, miny_}, {maxx_, maxy_}) ;
+    }
+
+private:
+    double minx_ = std::numeric_limits<double>::max(), miny_ = std::numeric_limits<double>::max() ;
+    double maxx_ = -std::numeric_limits<double>::max(), maxy_ = -std::numeric_limits<double>::max() ;
+} ;
+
+#endif
+
+// transform n command blocks from src into dst (src and dst may alias)
+
+void transform_blocks(const Path::CommandBlock *src, Path::CommandBlock *dst, size_t n, const PointTransform &xf)
+{
+    for( size_t i=0 ; i<n ; i++ ) {
+        Path::CommandBlock &b = dst[i] ;
+        if ( src != dst ) b = src[i] ;
+
+        switch ( b.cmd_ ) {
+        case Path::MoveToCmd:
+        case Path::LineToCmd:
+            xf.apply(b.arg0_, b.arg1_) ;
+            break ;
+        case Path::CurveToCmd:
+            xf.apply(b.arg0_, b.arg1_) ;
+            xf.apply(b.arg2_, b.arg3_) ;
+            xf.apply(b.arg4_, b.arg5_) ;
+            break ;
+        default:
+            break ;
+        }
+    }
+}
+
+// parameter values in (0, 1) where the derivative of a cubic bezier coordinate vanishes
+
+int cubic_extrema(double p0, double p1, double p2, double p3, double t[2])
+{
+    double a = -p0 + 3 * p1 - 3 * p2 + p3 ;
+    double b = 2 * (p0 - 2 * p1 + p2) ;
+    double c = p1 - p0 ;
+
+    int n = 0 ;
+
+    if ( fabs(a) < 1.0e-12 ) {
+        if ( fabs(b) > 1.0e-12 ) {
+            double r = -c / b ;
+            if ( r > 0 && r < 1 ) t[n++] = r ;
+        }
+        return n ;
+    }
+
+    double d = b * b - 4 * a * c ;
+    if ( d < 0 ) return 0 ;
+
+    double sd = sqrt(d) ;
+    double r1 = (-b + sd) / (2 * a) ;
+    double r2 = (-b - sd) / (2 * a) ;
+
+    if ( r1 > 0 && r1 < 1 ) t[n++] = r1 ;
+    if ( r2 > 0 && r2 < 1 ) t[n++] = r2 ;
+
+    return n ;
+}
+
+inline double cubic_eval(double p0, double p1, double p2, double p3, double t) {
+    double mt = 1 - t ;
+    return mt * mt * mt * p0 + 3 * mt * mt * t * p1 + 3 * mt * t * t * p2 + t * t * t * p3 ;
+}
+
+inline bool in_range(double v, double a, double b) {
+    return ( a <= b ) ? ( v >= a && v <= b ) : ( v >= b && v <= a ) ;
+}
+
+}
+
+Path &Path::transform(const Matrix2d &m)
+{
+    PointTransform xf(m) ;
+    transform_blocks(cmds_.data(), cmds_.data(), cmds_.size(), xf) ;
+    data_.reset() ;
+
+    xf.apply(cx_, cy_) ;
+    xf.apply(rx_, ry_) ;
+
+    return *this ;
+}
+
+void Path::transformed(const Matrix2d &m, Path &dst) const
+{
+    PointTransform xf(m) ;
+
+    dst.cmds_.resize(cmds_.size(), CommandBlock(ClosePathCmd)) ;
+    transform_blocks(cmds_.data(), dst.cmds_.data(), cmds_.size(), xf) ;
+    dst.data_.reset() ;
+
+    dst.cx_ = cx_ ; dst.cy_ = cy_ ;
+    dst.rx_ = rx_ ; dst.ry_ = ry_ ;
+    dst.previous_cmd_ = previous_cmd_ ;
+
+    xf.apply(dst.cx_, dst.cy_) ;
+    xf.apply(dst.rx_, dst.ry_) ;
+}
+
 Path Path::transformed(const Matrix2d &m) const
 {
     Path res ;
+    transformed(m, res) ;
+    return res ;
+}
+
+Path &Path::addPath(const Path &other, const Matrix2d &m)
+{
+    data_.reset() ;
+
+    size_t offset = cmds_.size() ;
+
+    cmds_.resize(offset + other.cmds_.size(), CommandBlock(ClosePathCmd)) ;
+    transform_blocks(other.cmds_.data(), cmds_.data() + offset, other.cmds_.size(), PointTransform(m)) ;
+
+    return *this ;
+}
+
+Rectangle2d Path::extents() const
+{
+    if ( cmds_.empty() ) return Rectangle2d() ;
+
+    ExtentAccumulator acc ;
+    double px = 0, py = 0, sx = 0, sy = 0 ;
 
     for ( const CommandBlock &block: cmds_ ) {
 
         switch ( block.cmd_ ) {
         case MoveToCmd:
-        case LineToCmd: {
-            auto v = m.transform(block.arg0_, block.arg1_) ;
-            res.cmds_.emplace_back(block.cmd_, v.x(), v.y()) ;
+            acc.extend(block.arg0_, block.arg1_) ;
+            sx = px = block.arg0_ ; sy = py = block.arg1_ ;
+            break ;
+        case LineToCmd:
+            acc.extend(block.arg0_, block.arg1_) ;
+            px = block.arg0_ ; py = block.arg1_ ;
             break ;
-        }
         case CurveToCmd: {
-            auto v1 = m.transform(block.arg0_, block.arg1_) ;
-            auto v2 = m.transform(block.arg2_, block.arg3_) ;
-            auto v3 = m.transform(block.arg4_, block.arg5_) ;
-            res.cmds_.emplace_back(block.cmd_, v1.x(), v1.y(), v2.x(), v2.y(), v3.x(), v3.y()) ;
+            double x1 = block.arg0_, y1 = block.arg1_ ;
+            double x2 = block.arg2_, y2 = block.arg3_ ;
+            double x3 = block.arg4_, y3 = block.arg5_ ;
+
+            acc.extend(x3, y3) ;
+
+            // the curve is contained in the hull of its control points so extrema need only be
+            // computed when a control point lies outside the box spanned by the end points
+
+            if ( !in_range(x1, px, x3) || !in_range(x2, px, x3) ) {
+                double t[2] ;
+                int n = cubic_extrema(px, x1, x2, x3, t) ;
+                for( int i=0 ; i<n ; i++ )
+                    acc.extend(cubic_eval(px, x1, x2, x3, t[i]), cubic_eval(py, y1, y2, y3, t[i])) ;
+            }
+
+            if ( !in_range(y1, py, y3) || !in_range(y2, py, y3) ) {
+                double t[2] ;
+                int n = cubic_extrema(py, y1, y2, y3, t) ;
+                for( int i=0 ; i<n ; i++ )
+                    acc.extend(cubic_eval(px, x1, x2, x3, t[i]), cubic_eval(py, y1, y2, y3, t[i])) ;
+            }
+
+            px = x3 ; py = y3 ;
             break ;
         }
         case ClosePathCmd:
-            res.cmds_.emplace_back(block.cmd_) ;
+            px = sx ; py = sy ;
+            break ;
+        default:
             break ;
         }
+    }
+
+    return acc.rect() ;
+}
+
+
+
+namespace {
+
+// Adaptive subdivision of a cubic Bezier. Segments are split at t=0.5 until they are flat within
+// tolerance; an explicit fixed size stack is used so no allocation happens per segment.
+// The flatness test bounds the distance of the curve from its chord (R. Willcocks).
+
+const int max_flatten_depth = 16 ;
+
+struct CubicSegment {
+    double x0, y0, x1, y1, x2, y2, x3, y3 ;
+    int depth ;
+} ;
+
+inline bool is_flat(const CubicSegment &c, double tol) {
+    double ux = 3.0 * c.x1 - 2.0 * c.x0 - c.x3 ; ux *= ux ;
+    double uy = 3.0 * c.y1 - 2.0 * c.y0 - c.y3 ; uy *= uy ;
+    double vx = 3.0 * c.x2 - 2.0 * c.x3 - c.x0 ; vx *= vx ;
+    double vy = 3.0 * c.y2 - 2.0 * c.y3 - c.y0 ; vy *= vy ;
+
+    if ( ux < vx ) ux = vx ;
+    if ( uy < vy ) uy = vy ;
+
+    return ux + uy <= 16.0 * tol * tol ;
+}
 
+void flatten_cubic(FlattenedPath &dst, double x0, double y0, double x1, double y1, double x2, double y2, double x3, double y3, double tol)
+{
+    CubicSegment stack[max_flatten_depth + 1] ;
+    int top = 0 ;
+
+    stack[0] = { x0, y0, x1, y1, x2, y2, x3, y3, 0 } ;
+
+    while ( top >= 0 ) {
+        CubicSegment c = stack[top--] ;
+
+        if ( c.depth == max_flatten_depth || is_flat(c, tol) ) {
+            dst.lineTo(c.x3, c.y3) ;
+            continue ;
+        }
+
+        // de Casteljau split at t = 0.5
+
+        double x01 = (c.x0 + c.x1) * 0.5, y01 = (c.y0 + c.y1) * 0.5 ;
+        double x12 = (c.x1 + c.x2) * 0.5, y12 = (c.y1 + c.y2) * 0.5 ;
+        double x23 = (c.x2 + c.x3) * 0.5, y23 = (c.y2 + c.y3) * 0.5 ;
+        double xa = (x01 + x12) * 0.5, ya = (y01 + y12) * 0.5 ;
+        double xb = (x12 + x23) * 0.5, yb = (y12 + y23) * 0.5 ;
+        double xm = (xa + xb) * 0.5, ym = (ya + yb) * 0.5 ;
+
+        // push the second half first so that the first half is processed next
+        stack[++top] = { xm, ym, xb, yb, x23, y23, c.x3, c.y3, c.depth + 1 } ;
+        stack[++top] = { c.x0, c.y0, x01, y01, xa, ya, xm, ym, c.depth + 1 } ;
     }
+}
 
-    return res ;
+// largest stretch factor of the linear part of the transform
+
+double max_scale(const Matrix2d &m) {
+    double e = m.m1() * m.m1() + m.m2() * m.m2() + m.m3() * m.m3() + m.m4() * m.m4() ;
+    double det = m.determinant() ;
+    double d = e * e - 4 * det * det ;
+    return sqrt(0.5 * (e + sqrt(std::max(d, 0.0)))) ;
 }
 
-inline void extent_box(double &minx, double &miny, double &maxx, double &maxy, double px, double py) {
-    minx = std::min(minx, px) ;
-    miny = std::min(miny, py) ;
-    maxx = std::max(maxx, px) ;
-    maxy = std::max(maxy, py) ;
 }
 
-Rectangle2d Path::extents() const
+void Path::flatten(FlattenedPath &dst, double tolerance, const Matrix2d &m) const
 {
-    double minx = std::numeric_limits<double>::max() ;
-    double miny = std::numeric_limits<double>::max() ;
+    dst.clear() ;
+
+    double scale = max_scale(m) ;
+    double tol = ( scale > 0 ) ? tolerance / scale : tolerance ;
 
-    double maxx = -std::numeric_limits<double>::max() ;
-    double maxy = -std::numeric_limits<double>::max() ;
+    double px = 0, py = 0, sx = 0, sy = 0 ;
 
     for ( const CommandBlock &block: cmds_ ) {
 
         switch ( block.cmd_ ) {
         case MoveToCmd:
+            dst.moveTo(block.arg0_, block.arg1_) ;
+            sx = px = block.arg0_ ; sy = py = block.arg1_ ;
+            break ;
         case LineToCmd:
-            extent_box(minx, miny, maxx, maxy, block.arg0_, block.arg1_) ;
+            dst.lineTo(block.arg0_, block.arg1_) ;
+            px = block.arg0_ ; py = block.arg1_ ;
             break ;
         case CurveToCmd:
-            extent_box(minx, miny, maxx, maxy, block.arg0_, block.arg1_) ;
-            extent_box(minx, miny, maxx, maxy, block.arg2_, block.arg3_) ;
-            extent_box(minx, miny, maxx, maxy, block.arg4_, block.arg5_) ;
+            flatten_cubic(dst, px, py, block.arg0_, block.arg1_, block.arg2_, block.arg3_, block.arg4_, block.arg5_, tol) ;
+            px = block.arg4_ ; py = block.arg5_ ;
+            break ;
+        case ClosePathCmd:
+            dst.close() ;
+            px = sx ; py = sy ;
+            break ;
+        default:
             break ;
         }
     }
+}
+
+Path Path::flattened(double tolerance) const
+{
+    FlattenedPath fp ;
+    flatten(fp, tolerance) ;
+
+    Path res ;
+    res.cmds_.reserve(fp.points().size() + 2 * fp.subPaths().size()) ;
+
+    const auto &pts = fp.points() ;
+
+    for( const auto &sp: fp.subPaths() ) {
+        // closed sub-paths repeat their start point which is implied by the close command
+        unsigned last = ( sp.closed_ ) ? sp.last_ - 1 : sp.last_ ;
+
+        res.moveTo(pts[sp.first_].x(), pts[sp.first_].y()) ;
+        for( unsigned i = sp.first_ + 1 ; i < last ; i++ )
+            res.lineTo(pts[i].x(), pts[i].y()) ;
+        if ( sp.closed_ ) res.closePath() ;
+    }
 
-    return Rectangle2d({minx, miny}, {maxx, maxy}) ;
+    return res ;
 }
 
+double Path::length(double tolerance) const
+{
+    FlattenedPath fp ;
+    flatten(fp, tolerance) ;
+    return fp.length() ;
+}
 
+void FlattenedPath::clear()
+{
+    points_.clear() ;
+    subpaths_.clear() ;
+    lengths_.clear() ;
+}
+
+void FlattenedPath::moveTo(double x, double y)
+{
+    // a sub-path consisting of a single move is dropped
+    if ( !subpaths_.empty() && subpaths_.back().last_ - subpaths_.back().first_ == 1 ) {
+        points_.pop_back() ;
+        lengths_.pop_back() ;
+        subpaths_.pop_back() ;
+    }
+
+    unsigned idx = points_.size() ;
+    subpaths_.push_back({ idx, idx + 1, false }) ;
+    lengths_.push_back(length()) ;
+    points_.emplace_back(x, y) ;
+}
+
+void FlattenedPath::lineTo(double x, double y)
+{
+    if ( subpaths_.empty() ) {
+        moveTo(x, y) ;
+        return ;
+    }
+
+    if ( subpaths_.back().closed_ ) {
+        // drawing after a close starts a new sub-path at the start of the closed one
+        Point2d s = points_[subpaths_.back().first_] ;
+        moveTo(s.x(), s.y()) ;
+    }
+
+    const Point2d &p = points_.back() ;
+    double dx = x - p.x(), dy = y - p.y() ;
+
+    lengths_.push_back(lengths_.back() + sqrt(dx * dx + dy * dy)) ;
+    points_.emplace_back(x, y) ;
+    subpaths_.back().last_ ++ ;
+}
+
+void FlattenedPath::close()
+{
+    if ( subpaths_.empty() || subpaths_.back().closed_ ) return ;
+
+    Point2d s = points_[subpaths_.back().first_] ;
+    const Point2d &e = points_.back() ;
+
+    if ( s.x() != e.x() || s.y() != e.y() )
+        lineTo(s.x(), s.y()) ;
+
+    subpaths_.back().closed_ = true ;
+}
+
+Point2d FlattenedPath::pointAtLength(double s, Vector2d *tangent) const
+{
+    assert( !points_.empty() ) ;
+
+    // first point with cumulative length larger than s
+    auto it = std::upper_bound(lengths_.begin(), lengths_.end(), s) ;
+    size_t i = it - lengths_.begin() ;
+
+    if ( i == 0 ) i = 1 ;
+    else if ( i == lengths_.size() ) i = lengths_.size() - 1 ;
+
+    if ( i >= points_.size() ) { // single point
+        if ( tangent ) *tangent = Vector2d(0, 0) ;
+        return points_[0] ;
+    }
+
+    const Point2d &p0 = points_[i-1], &p1 = points_[i] ;
+    double l0 = lengths_[i-1], l1 = lengths_[i] ;
+
+    double t = ( l1 > l0 ) ? ( s - l0 )/( l1 - l0 ) : 0.0 ;
+    t = std::max(0.0, std::min(1.0, t)) ;
+
+    if ( tangent ) *tangent = (p1 - p0).normalized() ;
+
+    return p0 + (p1 - p0) * t ;
+}
 
 }
@@ -0,0 +1,1073 @@
+#include <xg/recording_canvas.hpp>
+#include <xg/canvas.hpp>
+#include <xg/text_layout.hpp>
+
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+using namespace std ;
+
+namespace xg {
+
+namespace {
+
+enum Op { OpSave, OpRestore, OpSetTransform, OpSetPen, OpSetSolidBrush, OpSetLinearBrush, OpSetRadialBrush,
+          OpSetFont, OpClearBrush, OpClearPen, OpSetAntialias, OpClipRect, OpClipPath,
+          // drawing commands
+          OpLine, OpRect, OpPath, OpCircle, OpEllipse, OpText, OpTextBox, OpGlyphs, OpImage,
+          // state commands added later, appended to keep the values of the commands above
+          OpSetTextRenderMode } ;
+
+// state a drawing command depends on
+enum { DependsPen = 0x01, DependsBrush = 0x02, DependsFont = 0x04 } ;
+
+const char magic[4] = { 'X', 'G', 'D', 'L' } ;
+const uint32_t format_version = 2 ;
+
+uint64_t fnv_hash(const char *p, size_t n) {
+    uint64_t h = 14695981039346656037ULL ;
+    for( size_t i=0 ; i<n ; i++ ) {
+        h ^= static_cast<unsigned char>(p[i]) ;
+        h *= 1099511628211ULL ;
+    }
+    return h ;
+}
+
+uint64_t hash_combine(uint64_t h, uint64_t v) {
+    return h ^ ( v + 0x9e3779b97f4a7c15ULL + ( h << 6 ) + ( h >> 2 ) ) ;
+}
+
+uint64_t matrix_hash(const Matrix2d &m) {
+    double v[6] = { m.m1(), m.m2(), m.m3(), m.m4(), m.m5(), m.m6() } ;
+    return fnv_hash(reinterpret_cast<const char *>(v), sizeof(v)) ;
+}
+
+Rectangle2d padded(const Rectangle2d &r, double d) {
+    if ( r.empty() ) return r ;
+    return Rectangle2d(r.x() - d, r.y() - d, r.width() + 2*d, r.height() + 2*d) ;
+}
+
+// Myers' O(ND) difference of two sequences: marks the elements of a and b that are not part of a longest common
+// subsequence. Returns false if the sequences differ in more than max_d elements.
+
+bool sequence_diff(const vector<uint64_t> &a, const vector<uint64_t> &b, int max_d, vector<bool> &in_a, vector<bool> &in_b)
+{
+    const int n = a.size(), m = b.size(), off = n + m + 1 ;
+
+    // furthest x reached on each diagonal k = x - y at v[off + k], and the part of it used by each step
+    vector<int> v(2 * off + 1, 0) ;
+    vector<vector<int>> trace ;
+
+    bool done = false ;
+
+    for( int d = 0 ; d <= n + m && !done ; d++ ) {
+        if ( d > max_d ) return false ;
+
+        for( int k = -d ; k <= d ; k += 2 ) {
+            int x = ( k == -d || ( k != d && v[off + k - 1] < v[off + k + 1] ) ) ? v[off + k + 1] : v[off + k - 1] + 1 ;
+            int y = x - k ;
+
+            while ( x < n && y < m && a[x] == b[y] ) { ++x ; ++y ; }
+
+            v[off + k] = x ;
+
+            if ( x >= n && y >= m ) {
+                done = true ;
+                break ;
+            }
+        }
+
+        trace.emplace_back(v.begin() + off - d, v.begin() + off + d + 1) ;
+    }
+
+    in_a.assign(n, false) ;
+    in_b.assign(m, false) ;
+
+    // walk the edit path back, each step is an element only in b (down) or only in a (right)
+    int x = n, y = m ;
+
+    for( int d = trace.size() - 1 ; d > 0 ; d-- ) {
+        const vector<int> &prev = trace[d-1] ;
+        int k = x - y ;
+
+        bool down = ( k == -d || ( k != d && prev[k - 1 + d - 1] < prev[k + 1 + d - 1] ) ) ;
+        int pk = down ? k + 1 : k - 1 ;
+        int px = prev[pk + d - 1], py = px - pk ;
+
+        if ( down ) in_b[py] = true ;
+        else in_a[px] = true ;
+
+        x = px ; y = py ;
+    }
+
+    return true ;
+}
+
+class Writer {
+public:
+    Writer(vector<char> &data): data_(data) {}
+
+    template<class T> void put(const T &v) {
+        const char *p = reinterpret_cast<const char *>(&v) ;
+        data_.insert(data_.end(), p, p + sizeof(T)) ;
+    }
+
+    void putBytes(const char *p, size_t n) {
+        data_.insert(data_.end(), p, p + n) ;
+    }
+
+    void putString(const string &s) {
+        put<uint32_t>(s.size()) ;
+        putBytes(s.data(), s.size()) ;
+    }
+
+    void putColor(const Color &clr) {
+        put(clr.r()) ; put(clr.g()) ; put(clr.b()) ; put(clr.a()) ;
+    }
+
+    void putMatrix(const Matrix2d &m) {
+        put(m.m1()) ; put(m.m2()) ; put(m.m3()) ; put(m.m4()) ; put(m.m5()) ; put(m.m6()) ;
+    }
+
+    void putPath(const Path &p) {
+        const auto &cmds = p.commands() ;
+        put<uint32_t>(cmds.size()) ;
+
+        for( const auto &c: cmds ) {
+            put<uint8_t>(c.cmd_) ;
+            switch ( c.cmd_ ) {
+            case Path::MoveToCmd:
+            case Path::LineToCmd:
+                put(c.arg0_) ; put(c.arg1_) ;
+                break ;
+            case Path::QuadCurveToCmd:
+                put(c.arg0_) ; put(c.arg1_) ; put(c.arg2_) ; put(c.arg3_) ;
+                break ;
+            case Path::CurveToCmd:
+                put(c.arg0_) ; put(c.arg1_) ; put(c.arg2_) ; put(c.arg3_) ; put(c.arg4_) ; put(c.arg5_) ;
+                break ;
+            case Path::ClosePathCmd:
+                break ;
+            }
+        }
+    }
+
+    void putPen(const Pen &pen) {
+        putColor(pen.lineColor()) ;
+        put(pen.lineWidth()) ;
+        put(pen.miterLimit()) ;
+        put<uint8_t>(static_cast<uint8_t>(pen.lineJoin())) ;
+        put<uint8_t>(static_cast<uint8_t>(pen.lineCap())) ;
+        put<uint8_t>(static_cast<uint8_t>(pen.lineStyle())) ;
+        put<uint32_t>(pen.dashArray().size()) ;
+        for( double d: pen.dashArray() ) put(d) ;
+        put(pen.dashOffset()) ;
+    }
+
+    void putBrush(const Brush &br) {
+        put<uint8_t>(static_cast<uint8_t>(br.fillRule())) ;
+        put(br.fillOpacity()) ;
+    }
+
+    void putGradient(const GradientBrush &br) {
+        putBrush(br) ;
+        put<uint8_t>(static_cast<uint8_t>(br.spread())) ;
+        putMatrix(br.transform()) ;
+        put<uint32_t>(br.stops().size()) ;
+        for( const auto &s: br.stops() ) {
+            put(s.offset_) ;
+            putColor(s.clr_) ;
+        }
+    }
+
+    void putFont(const Font &f) {
+        string family ;
+        for( const auto &name: f.familyNames() ) {
+            if ( !family.empty() ) family += ',' ;
+            family += name ;
+        }
+        putString(family) ;
+        put(f.size()) ;
+        put<uint8_t>(static_cast<uint8_t>(f.style())) ;
+        put<uint16_t>(static_cast<uint16_t>(f.weight())) ;
+        put<uint16_t>(static_cast<uint16_t>(f.stretch())) ;
+    }
+
+private:
+    vector<char> &data_ ;
+} ;
+
+class Reader {
+public:
+    Reader(const char *data, size_t n): start_(data), p_(data), end_(data + n) {}
+
+    template<class T> T get() {
+        T v = T() ;
+        if ( p_ + sizeof(T) > end_ ) { ok_ = false ; p_ = end_ ; return v ; }
+        memcpy(&v, p_, sizeof(T)) ;
+        p_ += sizeof(T) ;
+        return v ;
+    }
+
+    const char *getBytes(size_t n) {
+        if ( n > static_cast<size_t>(end_ - p_) ) { ok_ = false ; p_ = end_ ; return nullptr ; }
+        const char *p = p_ ;
+        p_ += n ;
+        return p ;
+    }
+
+    string getString() {
+        uint32_t n = get<uint32_t>() ;
+        const char *p = getBytes(n) ;
+        return p ? string(p, n) : string() ;
+    }
+
+    Color getColor() {
+        double r = get<double>(), g = get<double>(), b = get<double>(), a = get<double>() ;
+        return Color(r, g, b, a) ;
+    }
+
+    Matrix2d getMatrix() {
+        double m[6] ;
+        for( int i=0 ; i<6 ; i++ ) m[i] = get<double>() ;
+        return Matrix2d(m[0], m[1], m[2], m[3], m[4], m[5]) ;
+    }
+
+    Path getPath() {
+        Path p ;
+        uint32_t n = get<uint32_t>() ;
+
+        for( uint32_t i=0 ; i<n && ok_ ; i++ ) {
+            double a[6] ;
+            switch ( get<uint8_t>() ) {
+            case Path::MoveToCmd:
+                a[0] = get<double>() ; a[1] = get<double>() ;
+                p.moveTo(a[0], a[1]) ;
+                break ;
+            case Path::LineToCmd:
+                a[0] = get<double>() ; a[1] = get<double>() ;
+                p.lineTo(a[0], a[1]) ;
+                break ;
+            case Path::QuadCurveToCmd:
+                for( int k=0 ; k<4 ; k++ ) a[k] = get<double>() ;
+                p.quadTo(a[0], a[1], a[2], a[3]) ;
+                break ;
+            case Path::CurveToCmd:
+                for( int k=0 ; k<6 ; k++ ) a[k] = get<double>() ;
+                p.curveTo(a[0], a[1], a[2], a[3], a[4], a[5]) ;
+                break ;
+            case Path::ClosePathCmd:
+                p.closePath() ;
+                break ;
+            default:
+                ok_ = false ;
+            }
+        }
+
+        return p ;
+    }
+
+    Pen getPen() {
+        Pen pen(getColor()) ;
+        pen.setLineWidth(get<double>()) ;
+        pen.setMiterLimit(get<double>()) ;
+        pen.setLineJoin(static_cast<LineJoin>(get<uint8_t>())) ;
+        pen.setLineCap(static_cast<LineCap>(get<uint8_t>())) ;
+        pen.setLineStyle(static_cast<LineStyle>(get<uint8_t>())) ;
+
+        uint32_t n = get<uint32_t>() ;
+        vector<double> dashes ;
+        for( uint32_t i=0 ; i<n && ok_ ; i++ ) dashes.push_back(get<double>()) ;
+        pen.setDashArray(dashes) ;
+        pen.setDashOffset(get<double>()) ;
+
+        return pen ;
+    }
+
+    void getBrush(Brush &br) {
+        br.setFillRule(static_cast<FillRule>(get<uint8_t>())) ;
+        br.setFillOpacity(get<double>()) ;
+    }
+
+    void getGradient(GradientBrush &br) {
+        getBrush(br) ;
+        br.setSpread(static_cast<SpreadMethod>(get<uint8_t>())) ;
+        br.setTransform(getMatrix()) ;
+
+        uint32_t n = get<uint32_t>() ;
+        for( uint32_t i=0 ; i<n && ok_ ; i++ ) {
+            double offset = get<double>() ;
+            br.addStop(offset, getColor()) ;
+        }
+    }
+
+    Font getFont() {
+        string family = getString() ;
+        Font f(family, get<double>()) ;
+        f.setStyle(static_cast<FontStyle>(get<uint8_t>())) ;
+        f.setWeight(get<uint16_t>()) ;
+        f.setStretch(get<uint16_t>()) ;
+        return f ;
+    }
+
+    // stop decoding, e.g. on invalid values
+    void fail() { ok_ = false ; p_ = end_ ; }
+
+    size_t offset() const { return p_ - start_ ; }
+    bool atEnd() const { return p_ == end_ ; }
+    bool ok() const { return ok_ ; }
+
+private:
+    const char *start_, *p_, *end_ ;
+    bool ok_ = true ;
+} ;
+
+// largest image dimension accepted, the limit of cairo image surfaces
+const uint32_t max_image_size = 32767 ;
+
+Image read_image(Reader &r) {
+    uint32_t w = r.get<uint32_t>(), h = r.get<uint32_t>() ;
+    uint8_t format = r.get<uint8_t>() ;
+    uint32_t stride = r.get<uint32_t>() ;
+
+    // the header is untrusted: the rows have to hold the pixels of the format and the pixels to be in the stream
+    size_t bpp ;
+    switch ( static_cast<ImageFormat>(format) ) {
+    case ImageFormat::ARGB32: bpp = 4 ; break ;
+    case ImageFormat::RGB24: bpp = 3 ; break ;
+    case ImageFormat::A8: bpp = 1 ; break ;
+    default:
+        r.fail() ;
+        return Image() ;
+    }
+
+    if ( w > max_image_size || h > max_image_size || stride < w * bpp ) {
+        r.fail() ;
+        return Image() ;
+    }
+
+    ImageFormat fmt = static_cast<ImageFormat>(format) ;
+
+    const char *pixels = r.getBytes(size_t(stride) * h) ;
+    if ( !pixels || w == 0 || h == 0 ) return Image() ;
+
+    Image im(w, h, fmt) ;
+
+    size_t row = std::min<size_t>(stride, im.stride()) ;
+    for( uint32_t y=0 ; y<h ; y++ )
+        memcpy(im.pixels() + y * im.stride(), pixels + y * stride, row) ;
+
+    return im ;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns false if the stream could not be decoded to the end. Restores without a matching save are dropped and
+// saves left open are restored at the end, so that the state of the canvas is the same before and after.
+
+template<class C>
+bool DisplayList::play(C &c, const std::vector<Rectangle2d> *regions) const
+{
+    Reader r(data_.data(), data_.size()) ;
+
+    size_t next_item = 0 ;
+    int depth = 0 ;
+    bool valid = true ;
+
+    while ( valid && !r.atEnd() && r.ok() ) {
+        size_t offset = r.offset() ;
+
+        int op = r.get<uint8_t>() ;
+
+        // when replaying a region skip drawing commands that do not touch it
+        bool skip = false ;
+
+        if ( regions && op >= OpLine && op <= OpImage ) {
+            while ( next_item < items_.size() && items_[next_item].offset_ < offset ) ++next_item ;
+
+            skip = true ;
+
+            if ( next_item < items_.size() && items_[next_item].offset_ == offset ) {
+                for( const auto &r: *regions ) {
+                    if ( items_[next_item].bounds_.intersects(r) ) {
+                        skip = false ;
+                        break ;
+                    }
+                }
+            }
+        }
+
+        switch ( op ) {
+        case OpSave:
+            c.save() ;
+            ++depth ;
+            break ;
+        case OpRestore:
+            if ( depth > 0 ) {
+                c.restore() ;
+                --depth ;
+            }
+            break ;
+        case OpSetTransform:
+            c.setTransform(r.getMatrix()) ;
+            break ;
+        case OpSetPen:
+            c.setPen(r.getPen()) ;
+            break ;
+        case OpSetSolidBrush: {
+            SolidBrush br(r.getColor()) ;
+            r.getBrush(br) ;
+            c.setBrush(br) ;
+            break ;
+        }
+        case OpSetLinearBrush: {
+            double x0 = r.get<double>(), y0 = r.get<double>(), x1 = r.get<double>(), y1 = r.get<double>() ;
+            LinearGradientBrush br(x0, y0, x1, y1) ;
+            r.getGradient(br) ;
+            c.setBrush(br) ;
+            break ;
+        }
+        case OpSetRadialBrush: {
+            double cx = r.get<double>(), cy = r.get<double>(), rad = r.get<double>(), fx = r.get<double>(), fy = r.get<double>() ;
+            RadialGradientBrush br(cx, cy, rad, fx, fy) ;
+            r.getGradient(br) ;
+            c.setBrush(br) ;
+            break ;
+        }
+        case OpSetFont:
+            c.setFont(r.getFont()) ;
+            break ;
+        case OpClearBrush:
+            c.clearBrush() ;
+            break ;
+        case OpClearPen:
+            c.clearPen() ;
+            break ;
+        case OpSetAntialias:
+            c.setAntialias(r.get<uint8_t>() != 0) ;
+            break ;
+        case OpSetTextRenderMode:
+            c.setTextRenderMode(static_cast<TextRenderMode>(r.get<uint8_t>())) ;
+            break ;
+        case OpClipRect: {
+            double x = r.get<double>(), y = r.get<double>(), w = r.get<double>(), h = r.get<double>() ;
+            c.setClipRect(x, y, w, h) ;
+            break ;
+        }
+        case OpClipPath: {
+            FillRule rule = static_cast<FillRule>(r.get<uint8_t>()) ;
+            c.setClipPath(r.getPath(), rule) ;
+            break ;
+        }
+        case OpLine: {
+            double x0 = r.get<double>(), y0 = r.get<double>(), x1 = r.get<double>(), y1 = r.get<double>() ;
+            if ( !skip ) c.drawLine(x0, y0, x1, y1) ;
+            break ;
+        }
+        case OpRect: {
+            double x = r.get<double>(), y = r.get<double>(), w = r.get<double>(), h = r.get<double>() ;
+            if ( !skip ) c.drawRect(x, y, w, h) ;
+            break ;
+        }
+        case OpPath: {
+            Path p = r.getPath() ;
+            if ( !skip ) c.drawPath(p) ;
+            break ;
+        }
+        case OpCircle: {
+            double cx = r.get<double>(), cy = r.get<double>(), rad = r.get<double>() ;
+            if ( !skip ) c.drawCircle(cx, cy, rad) ;
+            break ;
+        }
+        case OpEllipse: {
+            double x = r.get<double>(), y = r.get<double>(), ax = r.get<double>(), ay = r.get<double>() ;
+            if ( !skip ) c.drawEllipse(x, y, ax, ay) ;
+            break ;
+        }
+        case OpText: {
+            string text = r.getString() ;
+            double x = r.get<double>(), y = r.get<double>() ;
+            if ( !skip ) c.drawText(text, x, y) ;
+            break ;
+        }
+        case OpTextBox: {
+            string text = r.getString() ;
+            double x = r.get<double>(), y = r.get<double>(), w = r.get<double>(), h = r.get<double>() ;
+            unsigned int flags = r.get<uint32_t>() ;
+            if ( !skip ) c.drawText(text, x, y, w, h, flags) ;
+            break ;
+        }
+        case OpGlyphs: {
+            uint32_t n = r.get<uint32_t>() ;
+            vector<Glyph> glyphs ;
+            vector<Point2d> pos ;
+            for( uint32_t i=0 ; i<n && r.ok() ; i++ ) {
+                Glyph g(r.get<uint32_t>()) ;
+                g.x_advance_ = r.get<double>() ; g.y_advance_ = r.get<double>() ;
+                g.x_offset_ = r.get<double>() ; g.y_offset_ = r.get<double>() ;
+                double x = r.get<double>(), y = r.get<double>() ;
+                glyphs.push_back(g) ;
+                pos.push_back(Point2d(x, y)) ;
+            }
+            if ( !skip ) c.drawGlyphs(glyphs, pos) ;
+            break ;
+        }
+        case OpImage: {
+            double opacity = r.get<double>() ;
+            Image im = read_image(r) ;
+            if ( !skip && im.width() > 0 ) c.drawImage(im, opacity) ;
+            break ;
+        }
+        default:
+            valid = false ;
+        }
+    }
+
+    for( ; depth > 0 ; depth-- ) c.restore() ;
+
+    return valid && r.ok() ;
+}
+
+void DisplayList::replay(Canvas &c) const {
+    play(c, nullptr) ;
+}
+
+void DisplayList::replay(Canvas &c, const Rectangle2d &r) const {
+    replay(c, vector<Rectangle2d>(1, r)) ;
+}
+
+void DisplayList::replay(Canvas &c, const vector<Rectangle2d> &regions) const {
+    if ( regions.empty() ) return ;
+
+    Path clip ;
+    for( const auto &r: regions )
+        clip.addRect(r.x(), r.y(), r.width(), r.height()) ;
+
+    c.save() ;
+    c.setClipPath(clip, FillRule::NonZero) ;
+    play(c, &regions) ;
+    c.restore() ;
+}
+
+void DisplayList::clear() {
+    data_.clear() ;
+    items_.clear() ;
+    count_ = 0 ;
+}
+
+void DisplayList::write(ostream &strm) const {
+    strm.write(magic, 4) ;
+    strm.write(reinterpret_cast<const char *>(&format_version), sizeof(format_version)) ;
+    strm.write(reinterpret_cast<const char *>(&width_), sizeof(width_)) ;
+    strm.write(reinterpret_cast<const char *>(&height_), sizeof(height_)) ;
+
+    uint64_t n = data_.size() ;
+    strm.write(reinterpret_cast<const char *>(&n), sizeof(n)) ;
+    strm.write(data_.data(), data_.size()) ;
+}
+
+bool DisplayList::read(istream &strm) {
+    char m[4] ;
+    uint32_t version ;
+    double w, h ;
+    uint64_t n ;
+
+    strm.read(m, 4) ;
+    strm.read(reinterpret_cast<char *>(&version), sizeof(version)) ;
+    strm.read(reinterpret_cast<char *>(&w), sizeof(w)) ;
+    strm.read(reinterpret_cast<char *>(&h), sizeof(h)) ;
+    strm.read(reinterpret_cast<char *>(&n), sizeof(n)) ;
+
+    if ( !strm || memcmp(m, magic, 4) != 0 || version != format_version ) return false ;
+
+    // the size is untrusted, check it against what is left in the stream before allocating
+    streampos pos = strm.tellg() ;
+    if ( pos != streampos(-1) ) {
+        strm.seekg(0, ios::end) ;
+        streampos end = strm.tellg() ;
+        strm.seekg(pos) ;
+        if ( !strm || end < pos || n > static_cast<uint64_t>(end - pos) ) return false ;
+    }
+
+    // streams that cannot seek are read in chunks so that a wrong size fails at the end of the stream
+    DisplayList stream ;
+    const uint64_t chunk = 1 << 20 ;
+
+    while ( stream.data_.size() < n ) {
+        size_t sz = stream.data_.size() ;
+        size_t k = std::min(chunk, n - sz) ;
+        stream.data_.resize(sz + k) ;
+        strm.read(stream.data_.data() + sz, k) ;
+        if ( !strm ) return false ;
+    }
+
+    // re-record the commands to rebuild the bounds and hashes of the drawing commands
+    RecordingCanvas rc(w, h) ;
+    if ( !stream.play(rc, nullptr) ) return false ;
+
+    *this = rc.displayList() ;
+    return true ;
+}
+
+bool DisplayList::save(const string &fname) const {
+    ofstream strm(fname.c_str(), ios::binary) ;
+    if ( !strm ) return false ;
+    write(strm) ;
+    return (bool)strm ;
+}
+
+bool DisplayList::load(const string &fname) {
+    ifstream strm(fname.c_str(), ios::binary) ;
+    if ( !strm ) return false ;
+    return read(strm) ;
+}
+
+vector<Rectangle2d> DisplayList::diff(const DisplayList &a, const DisplayList &b)
+{
+    // Items are compared in drawing order, so items drawn in a different order relative to each other are
+    // changed too. The common prefix and suffix are skipped before diffing the rest.
+
+    size_t na = a.items_.size(), nb = b.items_.size() ;
+
+    size_t first = 0 ;
+    while ( first < na && first < nb && a.items_[first].hash_ == b.items_[first].hash_ ) ++first ;
+
+    size_t last_a = na, last_b = nb ;
+    while ( last_a > first && last_b > first && a.items_[last_a - 1].hash_ == b.items_[last_b - 1].hash_ ) {
+        --last_a ; --last_b ;
+    }
+
+    vector<uint64_t> ha, hb ;
+    for( size_t i = first ; i < last_a ; i++ ) ha.push_back(a.items_[i].hash_) ;
+    for( size_t i = first ; i < last_b ; i++ ) hb.push_back(b.items_[i].hash_) ;
+
+    // too many edits for a fine grained diff, all of them have changed
+    const int max_edits = 2000 ;
+
+    vector<bool> in_a, in_b ;
+    if ( !sequence_diff(ha, hb, max_edits, in_a, in_b) ) {
+        in_a.assign(ha.size(), true) ;
+        in_b.assign(hb.size(), true) ;
+    }
+
+    vector<Rectangle2d> changed ;
+
+    for( size_t i=0 ; i<in_a.size() ; i++ )
+        if ( in_a[i] ) changed.push_back(a.items_[first + i].bounds_) ;
+    for( size_t i=0 ; i<in_b.size() ; i++ )
+        if ( in_b[i] ) changed.push_back(b.items_[first + i].bounds_) ;
+
+    // merge overlapping regions
+    vector<Rectangle2d> regions ;
+
+    for( const auto &r: changed ) {
+        Rectangle2d m = r ;
+        bool merged = true ;
+
+        while ( merged ) {
+            merged = false ;
+            for( size_t k=0 ; k<regions.size() ; k++ ) {
+                if ( regions[k].intersects(m) ) {
+                    m = m.united(regions[k]) ;
+                    regions.erase(regions.begin() + k) ;
+                    merged = true ;
+                    break ;
+                }
+            }
+        }
+
+        regions.push_back(m) ;
+    }
+
+    return regions ;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+RecordingCanvas::RecordingCanvas(double width, double height): width_(width), height_(height) {
+    reset() ;
+}
+
+void RecordingCanvas::reset() {
+    list_.clear() ;
+    list_.width_ = width_ ;
+    list_.height_ = height_ ;
+
+    State st ;
+    st.clip_ = Rectangle2d(0, 0, width_, height_) ;
+    states_.assign(1, st) ;
+}
+
+size_t RecordingCanvas::begin(int op) {
+    size_t offset = list_.data_.size() ;
+    list_.data_.push_back(static_cast<char>(op)) ;
+    ++list_.count_ ;
+    return offset ;
+}
+
+uint64_t RecordingCanvas::end(size_t offset) {
+    return fnv_hash(list_.data_.data() + offset, list_.data_.size() - offset) ;
+}
+
+Rectangle2d RecordingCanvas::to_device(const Rectangle2d &r) const {
+    if ( r.empty() ) return r ;
+
+    const Matrix2d &m = states_.back().ctm_ ;
+
+    Point2d p[4] = { m.transform(r.topLeft()), m.transform(r.topRight()),
+                     m.transform(r.bottomLeft()), m.transform(r.bottomRight()) } ;
+
+    double x0 = p[0].x(), y0 = p[0].y(), x1 = x0, y1 = y0 ;
+    for( int i=1 ; i<4 ; i++ ) {
+        x0 = std::min(x0, p[i].x()) ; x1 = std::max(x1, p[i].x()) ;
+        y0 = std::min(y0, p[i].y()) ; y1 = std::max(y1, p[i].y()) ;
+    }
+
+    return Rectangle2d(x0, y0, x1 - x0, y1 - y0) ;
+}
+
+void RecordingCanvas::end_draw(size_t offset, const Rectangle2d &user_bounds, unsigned int deps)
+{
+    const State &st = states_.back() ;
+
+    bool visible = ( deps == 0 ) || ( deps & DependsFont ) ||
+            ( st.has_pen_ && ( deps & DependsPen ) ) || ( st.has_brush_ && ( deps & DependsBrush ) ) ;
+
+    if ( !visible || user_bounds.empty() ) return ;
+
+    Rectangle2d bounds = to_device(user_bounds) ;
+
+    if ( st.has_pen_ && ( deps & DependsPen ) && !( deps & DependsFont ) ) {
+        const Matrix2d &m = st.ctm_ ;
+        double scale = std::max(hypot(m.m1(), m.m2()), hypot(m.m3(), m.m4())) ;
+        bounds = padded(bounds, st.line_width_/2 * std::max(st.miter_limit_, 1.0) * scale) ;
+    }
+
+    // antialiasing
+    bounds = padded(bounds, 1).intersected(st.clip_) ;
+
+    if ( bounds.empty() ) return ;
+
+    uint64_t h = end(offset) ;
+    h = hash_combine(h, matrix_hash(st.ctm_)) ;
+    h = hash_combine(h, st.clip_hash_) ;
+    h = hash_combine(h, st.antialias_) ;
+    if ( deps & DependsPen ) h = hash_combine(h, st.pen_hash_) ;
+    if ( deps & DependsBrush ) h = hash_combine(h, st.brush_hash_) ;
+    if ( deps & DependsFont ) h = hash_combine(h, hash_combine(st.font_hash_, static_cast<uint64_t>(st.text_mode_))) ;
+
+    DisplayList::DrawItem item ;
+    item.offset_ = offset ;
+    item.hash_ = h ;
+    item.bounds_ = bounds ;
+
+    list_.items_.push_back(item) ;
+}
+
+void RecordingCanvas::end_clip(size_t offset, const Rectangle2d &user_bounds)
+{
+    State &st = states_.back() ;
+
+    st.clip_hash_ = hash_combine(st.clip_hash_, hash_combine(end(offset), matrix_hash(st.ctm_))) ;
+    st.clip_ = st.clip_.intersected(to_device(user_bounds)) ;
+}
+
+void RecordingCanvas::save() {
+    begin(OpSave) ;
+    states_.push_back(states_.back()) ;
+}
+
+void RecordingCanvas::restore() {
+    // unmatched restores are not recorded
+    if ( states_.size() <= 1 ) return ;
+
+    begin(OpRestore) ;
+    states_.pop_back() ;
+}
+
+void RecordingCanvas::setTransform(const Matrix2d &tr) {
+    Writer w(list_.data_) ;
+    begin(OpSetTransform) ;
+    w.putMatrix(tr) ;
+
+    State &st = states_.back() ;
+    st.ctm_ = Matrix2d(tr).postmult(st.ctm_) ;
+}
+
+void RecordingCanvas::setPen(const Pen &pen) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpSetPen) ;
+    w.putPen(pen) ;
+
+    State &st = states_.back() ;
+    st.has_pen_ = true ;
+    st.line_width_ = pen.lineWidth() ;
+    st.miter_limit_ = pen.miterLimit() ;
+    st.pen_hash_ = end(offset) ;
+}
+
+void RecordingCanvas::setBrush(const SolidBrush &br) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpSetSolidBrush) ;
+    w.putColor(br.color()) ;
+    w.putBrush(br) ;
+
+    State &st = states_.back() ;
+    st.has_brush_ = true ;
+    st.brush_hash_ = end(offset) ;
+}
+
+void RecordingCanvas::setBrush(const LinearGradientBrush &br) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpSetLinearBrush) ;
+    w.put(br.x0()) ; w.put(br.y0()) ; w.put(br.x1()) ; w.put(br.y1()) ;
+    w.putGradient(br) ;
+
+    State &st = states_.back() ;
+    st.has_brush_ = true ;
+    st.brush_hash_ = end(offset) ;
+}
+
+void RecordingCanvas::setBrush(const RadialGradientBrush &br) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpSetRadialBrush) ;
+    w.put(br.cx()) ; w.put(br.cy()) ; w.put(br.radius()) ; w.put(br.fx()) ; w.put(br.fy()) ;
+    w.putGradient(br) ;
+
+    State &st = states_.back() ;
+    st.has_brush_ = true ;
+    st.brush_hash_ = end(offset) ;
+}
+
+void RecordingCanvas::setFont(const Font &font) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpSetFont) ;
+    w.putFont(font) ;
+
+    State &st = states_.back() ;
+    st.font_ = font ;
+    st.font_hash_ = end(offset) ;
+}
+
+void RecordingCanvas::clearBrush() {
+    begin(OpClearBrush) ;
+    states_.back().has_brush_ = false ;
+    states_.back().brush_hash_ = 0 ;
+}
+
+void RecordingCanvas::clearPen() {
+    begin(OpClearPen) ;
+    states_.back().has_pen_ = false ;
+    states_.back().pen_hash_ = 0 ;
+}
+
+void RecordingCanvas::setAntialias(bool anti_alias) {
+    Writer w(list_.data_) ;
+    begin(OpSetAntialias) ;
+    w.put<uint8_t>(anti_alias) ;
+    states_.back().antialias_ = anti_alias ;
+}
+
+void RecordingCanvas::setTextRenderMode(TextRenderMode mode) {
+    Writer w(list_.data_) ;
+    begin(OpSetTextRenderMode) ;
+    w.put<uint8_t>(static_cast<uint8_t>(mode)) ;
+    states_.back().text_mode_ = mode ;
+}
+
+void RecordingCanvas::setClipRect(double x0, double y0, double wd, double ht) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpClipRect) ;
+    w.put(x0) ; w.put(y0) ; w.put(wd) ; w.put(ht) ;
+    end_clip(offset, Rectangle2d(x0, y0, wd, ht)) ;
+}
+
+void RecordingCanvas::setClipRect(const Rectangle2d &r) {
+    setClipRect(r.x(), r.y(), r.width(), r.height()) ;
+}
+
+void RecordingCanvas::setClipPath(const Path &p, FillRule rule) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpClipPath) ;
+    w.put<uint8_t>(static_cast<uint8_t>(rule)) ;
+    w.putPath(p) ;
+    end_clip(offset, p.extents()) ;
+}
+
+Rectangle2d RecordingCanvas::clipExtents() const {
+    const State &st = states_.back() ;
+    if ( st.clip_.empty() || !st.ctm_.is_invertible() ) return Rectangle2d() ;
+
+    Matrix2d inv(st.ctm_) ;
+    inv.invert() ;
+
+    const Rectangle2d &r = st.clip_ ;
+    Point2d p[4] = { inv.transform(r.topLeft()), inv.transform(r.topRight()),
+                     inv.transform(r.bottomLeft()), inv.transform(r.bottomRight()) } ;
+
+    Rectangle2d bounds(p[0], p[0]) ;
+    for( int i=1 ; i<4 ; i++ ) bounds.extend(p[i]) ;
+    return bounds ;
+}
+
+void RecordingCanvas::drawLine(double x0, double y0, double x1, double y1) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpLine) ;
+    w.put(x0) ; w.put(y0) ; w.put(x1) ; w.put(y1) ;
+    end_draw(offset, Rectangle2d(x0, y0, x1 - x0, y1 - y0), DependsPen) ;
+}
+
+void RecordingCanvas::drawLine(const Point2d &p1, const Point2d &p2) {
+    drawLine(p1.x(), p1.y(), p2.x(), p2.y()) ;
+}
+
+void RecordingCanvas::drawRect(double x0, double y0, double wd, double ht) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpRect) ;
+    w.put(x0) ; w.put(y0) ; w.put(wd) ; w.put(ht) ;
+    end_draw(offset, Rectangle2d(x0, y0, wd, ht), DependsPen | DependsBrush) ;
+}
+
+void RecordingCanvas::drawRect(const Rectangle2d &r) {
+    drawRect(r.x(), r.y(), r.width(), r.height()) ;
+}
+
+void RecordingCanvas::drawPath(const Path &p) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpPath) ;
+    w.putPath(p) ;
+    end_draw(offset, p.extents(), DependsPen | DependsBrush) ;
+}
+
+void RecordingCanvas::drawPolyline(double *pts, int n) {
+    if ( n < 2 ) return ;
+
+    Path p ;
+    p.moveTo(pts[0], pts[1]) ;
+    for( int i=1 ; i<n ; i++ ) p.lineTo(pts[2*i], pts[2*i+1]) ;
+
+    drawPath(p) ;
+}
+
+void RecordingCanvas::drawPolygon(double *pts, int n) {
+    if ( n < 2 ) return ;
+
+    Path p ;
+    p.moveTo(pts[0], pts[1]) ;
+    for( int i=1 ; i<n ; i++ ) p.lineTo(pts[2*i], pts[2*i+1]) ;
+    p.closePath() ;
+
+    drawPath(p) ;
+}
+
+void RecordingCanvas::drawCircle(double cx, double cy, double r) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpCircle) ;
+    w.put(cx) ; w.put(cy) ; w.put(r) ;
+    end_draw(offset, Rectangle2d(cx - r, cy - r, 2*r, 2*r), DependsPen | DependsBrush) ;
+}
+
+void RecordingCanvas::drawCircle(const Point2d &center, double r) {
+    drawCircle(center.x(), center.y(), r) ;
+}
+
+void RecordingCanvas::drawEllipse(double xp, double yp, double ax, double ay) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpEllipse) ;
+    w.put(xp) ; w.put(yp) ; w.put(ax) ; w.put(ay) ;
+    end_draw(offset, Rectangle2d(xp - ax, yp - ay, 2*ax, 2*ay), DependsPen | DependsBrush) ;
+}
+
+void RecordingCanvas::drawText(const string &text, double x0, double y0) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpText) ;
+    w.putString(text) ;
+    w.put(x0) ; w.put(y0) ;
+
+    const Font &f = states_.back().font_ ;
+
+    TextMetrics m = measureText(text, f) ;
+
+    // ink and advance box, allowing for antialiasing
+    Rectangle2d box = m.ink_.united(Rectangle2d(0, -m.ascent_, m.width_, m.ascent_ + m.descent_)) ;
+    Rectangle2d bounds = padded(Rectangle2d(x0 + box.x(), y0 + box.y(), box.width(), box.height()), f.size()/4) ;
+
+    end_draw(offset, bounds, DependsPen | DependsBrush | DependsFont) ;
+}
+
+void RecordingCanvas::drawText(const string &text, double x0, double y0, double wd, double ht, unsigned int flags) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpTextBox) ;
+    w.putString(text) ;
+    w.put(x0) ; w.put(y0) ; w.put(wd) ; w.put(ht) ;
+    w.put<uint32_t>(flags) ;
+
+    const Font &f = states_.back().font_ ;
+
+    TextLayout layout(text, f) ;
+    layout.setWrapWidth(wd) ;
+    layout.compute() ;
+
+    // the text may overflow the box
+    Rectangle2d bounds = padded(Rectangle2d(x0, y0, std::max(wd, layout.width()), std::max(ht, layout.height())), f.size()/4) ;
+
+    end_draw(offset, bounds, DependsPen | DependsBrush | DependsFont) ;
+}
+
+void RecordingCanvas::drawText(const string &text, const Point2d &p) {
+    drawText(text, p.x(), p.y()) ;
+}
+
+void RecordingCanvas::drawText(const string &text, const Rectangle2d &r, unsigned int flags) {
+    drawText(text, r.x(), r.y(), r.width(), r.height(), flags) ;
+}
+
+void RecordingCanvas::drawGlyph(const Glyph &g, const Point2d &p) {
+    drawGlyphs(vector<Glyph>{g}, vector<Point2d>{p}) ;
+}
+
+void RecordingCanvas::drawGlyphs(const vector<Glyph> &glyphs, const vector<Point2d> &positions) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpGlyphs) ;
+
+    uint32_t n = std::min(glyphs.size(), positions.size()) ;
+    w.put(n) ;
+
+    Rectangle2d bounds ;
+    double sz = states_.back().font_.size() ;
+
+    for( uint32_t i=0 ; i<n ; i++ ) {
+        const Glyph &g = glyphs[i] ;
+        w.put<uint32_t>(g.index_) ;
+        w.put(g.x_advance_) ; w.put(g.y_advance_) ;
+        w.put(g.x_offset_) ; w.put(g.y_offset_) ;
+        w.put(positions[i].x()) ; w.put(positions[i].y()) ;
+
+        // a glyph is assumed to fit in a square of twice the font size around its origin
+        bounds = bounds.united(Rectangle2d(positions[i].x() - sz, positions[i].y() - sz, 2*sz, 2*sz)) ;
+    }
+
+    end_draw(offset, bounds, DependsPen | DependsBrush | DependsFont) ;
+}
+
+void RecordingCanvas::drawImage(const Image &im, double opacity) {
+    Writer w(list_.data_) ;
+    size_t offset = begin(OpImage) ;
+    w.put(opacity) ;
+
+    bool valid = im.pixels() != nullptr ;
+
+    w.put<uint32_t>(valid ? im.width() : 0) ;
+    w.put<uint32_t>(valid ? im.height() : 0) ;
+    w.put<uint8_t>(static_cast<uint8_t>(im.format())) ;
+    w.put<uint32_t>(valid ? im.stride() : 0) ;
+    if ( valid ) w.putBytes(im.pixels(), size_t(im.stride()) * im.height()) ;
+
+    end_draw(offset, Rectangle2d(0, 0, im.width(), im.height()), 0) ;
+}
+
+}
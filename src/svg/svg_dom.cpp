@@ -875,5 +875,137 @@ void TRefElement::parseAttributes(const Dictionary &attrs) {
 }
 
 
+static void parse_number_attribute(const Dictionary &attrs, const char *key, OptionalAttribute<float> &a) {
+    attrs.visit(key, [&](const string &val) {
+        float v ;
+        if ( !parse_number(val, v) )
+            throw SVGDOMAttributeValueException(key, val) ;
+        a.assign(v) ;
+    }) ;
+}
+
+void FilterPrimitiveElement::parsePrimitiveAttributes(const Dictionary &attrs) {
+    parseElementAttributes(attrs) ;
+    parseStyleAttributes(attrs, style_) ;
+
+    attrs.visit("in", [&](const string &val) { in_.assign(val) ; }) ;
+    attrs.visit("result", [&](const string &val) { result_.assign(val) ; }) ;
+}
+
+void FEGaussianBlurElement::parseAttributes(const Dictionary &attrs) {
+    parsePrimitiveAttributes(attrs) ;
+
+    attrs.visit("stdDeviation", [&](const string &val) {
+        vector<float> v ;
+        if ( !parse_coordinate_list(val, v) || v.empty() || v.size() > 2 || v[0] < 0 || v.back() < 0 )
+            throw SVGDOMAttributeValueException("stdDeviation", val) ;
+        std_dev_x_.assign(v[0]) ;
+        std_dev_y_.assign(v.back()) ;
+    }) ;
+}
+
+void FEOffsetElement::parseAttributes(const Dictionary &attrs) {
+    parsePrimitiveAttributes(attrs) ;
+
+    parse_number_attribute(attrs, "dx", dx_) ;
+    parse_number_attribute(attrs, "dy", dy_) ;
+}
+
+void FEFloodElement::parseAttributes(const Dictionary &attrs) {
+    parsePrimitiveAttributes(attrs) ;
+}
+
+void FEBlendElement::parseAttributes(const Dictionary &attrs) {
+    parsePrimitiveAttributes(attrs) ;
+
+    attrs.visit("in2", [&](const string &val) { in2_.assign(val) ; }) ;
+
+    attrs.visit("mode", [&](const string &val) {
+        if ( val == "normal" ) mode_.assign(BlendMode::Normal) ;
+        else if ( val == "multiply" ) mode_.assign(BlendMode::Multiply) ;
+        else if ( val == "screen" ) mode_.assign(BlendMode::Screen) ;
+        else if ( val == "darken" ) mode_.assign(BlendMode::Darken) ;
+        else if ( val == "lighten" ) mode_.assign(BlendMode::Lighten) ;
+        else throw SVGDOMAttributeValueException("mode", val) ;
+    }) ;
+}
+
+void FECompositeElement::parseAttributes(const Dictionary &attrs) {
+    parsePrimitiveAttributes(attrs) ;
+
+    attrs.visit("in2", [&](const string &val) { in2_.assign(val) ; }) ;
+
+    attrs.visit("operator", [&](const string &val) {
+        if ( val == "over" ) operator_.assign(CompositeOperator::Over) ;
+        else if ( val == "in" ) operator_.assign(CompositeOperator::In) ;
+        else if ( val == "out" ) operator_.assign(CompositeOperator::Out) ;
+        else if ( val == "atop" ) operator_.assign(CompositeOperator::Atop) ;
+        else if ( val == "xor" ) operator_.assign(CompositeOperator::Xor) ;
+        else if ( val == "arithmetic" ) operator_.assign(CompositeOperator::Arithmetic) ;
+        else throw SVGDOMAttributeValueException("operator", val) ;
+    }) ;
+
+    parse_number_attribute(attrs, "k1", k1_) ;
+    parse_number_attribute(attrs, "k2", k2_) ;
+    parse_number_attribute(attrs, "k3", k3_) ;
+    parse_number_attribute(attrs, "k4", k4_) ;
+}
+
+void FEMergeNodeElement::parseAttributes(const Dictionary &attrs) {
+    parseElementAttributes(attrs) ;
+
+    attrs.visit("in", [&](const string &val) { in_.assign(val) ; }) ;
+}
+
+void FEMergeElement::parseAttributes(const Dictionary &attrs) {
+    parseElementAttributes(attrs) ;
+    parseStyleAttributes(attrs, style_) ;
+
+    attrs.visit("result", [&](const string &val) { result_.assign(val) ; }) ;
+}
+
+void FEColorMatrixElement::parseAttributes(const Dictionary &attrs) {
+    parsePrimitiveAttributes(attrs) ;
+
+    attrs.visit("type", [&](const string &val) {
+        if ( val == "matrix" ) type_.assign(ColorMatrixType::Matrix) ;
+        else if ( val == "saturate" ) type_.assign(ColorMatrixType::Saturate) ;
+        else if ( val == "hueRotate" ) type_.assign(ColorMatrixType::HueRotate) ;
+        else if ( val == "luminanceToAlpha" ) type_.assign(ColorMatrixType::LuminanceToAlpha) ;
+        else throw SVGDOMAttributeValueException("type", val) ;
+    }) ;
+
+    attrs.visit("values", [&](const string &val) {
+        vector<float> v ;
+        if ( !parse_coordinate_list(val, v) )
+            throw SVGDOMAttributeValueException("values", val) ;
+        values_.assign(v) ;
+    }) ;
+}
+
+void FilterElement::parseAttributes(const Dictionary &attrs) {
+    parseElementAttributes(attrs) ;
+    parseStyleAttributes(attrs, style_) ;
+
+    attrs.visit("filterUnits", [&](const string &val) {
+        if ( val == "userSpaceOnUse" )
+            filter_units_.assign(FilterUnits::UserSpaceOnUse) ;
+        else if ( val == "objectBoundingBox" )
+            filter_units_.assign(FilterUnits::ObjectBoundingBox) ;
+    }) ;
+
+    attrs.visit("primitiveUnits", [&](const string &val) {
+        if ( val == "userSpaceOnUse" )
+            primitive_units_.assign(FilterUnits::UserSpaceOnUse) ;
+        else if ( val == "objectBoundingBox" )
+            primitive_units_.assign(FilterUnits::ObjectBoundingBox) ;
+    }) ;
+
+    parseOptionalAttribute("x", attrs, x_) ;
+    parseOptionalAttribute("y", attrs, y_) ;
+    parseOptionalAttribute("width", attrs, width_) ;
+    parseOptionalAttribute("height", attrs, height_) ;
+}
+
 }
 }
@@ -37,6 +37,7 @@ class TSpanElement ;
 class TRefElement ;
 class SVGElement ;
 class StyleElement ;
+class FilterElement ;
 class Element ;
 
 using ElementPtr = std::shared_ptr<Element> ;
@@ -131,7 +132,7 @@ struct Container<T, Ts...>: public Element {
 
 using GroupContainer =  Container<CircleElement, LineElement, PolylineElement, PolygonElement, RectElement, PathElement, EllipseElement,
 DefsElement, SVGElement, GroupElement, SymbolElement, UseElement, LinearGradientElement, RadialGradientElement,
-ClipPathElement, ImageElement, PatternElement, StyleElement, TextElement> ;
+ClipPathElement, ImageElement, PatternElement, StyleElement, TextElement, FilterElement> ;
 
 using ShapeContainer = Container<CircleElement, LineElement, PolylineElement, PolygonElement, RectElement, PathElement, EllipseElement, UseElement, TextElement> ;
 
@@ -491,6 +492,116 @@ public:
 
 } ;
 
+// Filter primitives. Only the primitive types below are supported and subregions (x, y, width, height) are ignored,
+// every primitive covers the whole filter region.
+
+class FilterPrimitiveElement: public Element, public Stylable {
+public:
+
+    void parsePrimitiveAttributes(const Dictionary &attrs) ;
+
+    // SourceGraphic, SourceAlpha, the result of a previous primitive or empty for the previous result
+    SVG_ELEMENT_ATTRIBUTE(in_, in, std::string, std::string())
+    SVG_ELEMENT_ATTRIBUTE(result_, result, std::string, std::string())
+} ;
+
+class FEGaussianBlurElement: public FilterPrimitiveElement {
+public:
+
+    void parseAttributes(const Dictionary &attrs) ;
+
+    SVG_ELEMENT_ATTRIBUTE(std_dev_x_, stdDeviationX, float, 0)
+    SVG_ELEMENT_ATTRIBUTE(std_dev_y_, stdDeviationY, float, 0)
+} ;
+
+class FEOffsetElement: public FilterPrimitiveElement {
+public:
+
+    void parseAttributes(const Dictionary &attrs) ;
+
+    SVG_ELEMENT_ATTRIBUTE(dx_, dx, float, 0)
+    SVG_ELEMENT_ATTRIBUTE(dy_, dy, float, 0)
+} ;
+
+// uses the flood-color and flood-opacity style properties
+class FEFloodElement: public FilterPrimitiveElement {
+public:
+
+    void parseAttributes(const Dictionary &attrs) ;
+} ;
+
+enum class BlendMode { Normal, Multiply, Screen, Darken, Lighten } ;
+
+class FEBlendElement: public FilterPrimitiveElement {
+public:
+
+    void parseAttributes(const Dictionary &attrs) ;
+
+    SVG_ELEMENT_ATTRIBUTE(in2_, in2, std::string, std::string())
+    SVG_ELEMENT_ATTRIBUTE(mode_, mode, BlendMode, BlendMode::Normal)
+} ;
+
+enum class CompositeOperator { Over, In, Out, Atop, Xor, Arithmetic } ;
+
+class FECompositeElement: public FilterPrimitiveElement {
+public:
+
+    void parseAttributes(const Dictionary &attrs) ;
+
+    SVG_ELEMENT_ATTRIBUTE(in2_, in2, std::string, std::string())
+    SVG_ELEMENT_ATTRIBUTE(operator_, op, CompositeOperator, CompositeOperator::Over)
+    SVG_ELEMENT_ATTRIBUTE(k1_, k1, float, 0)
+    SVG_ELEMENT_ATTRIBUTE(k2_, k2, float, 0)
+    SVG_ELEMENT_ATTRIBUTE(k3_, k3, float, 0)
+    SVG_ELEMENT_ATTRIBUTE(k4_, k4, float, 0)
+} ;
+
+class FEMergeNodeElement: public Element {
+public:
+
+    void parseAttributes(const Dictionary &attrs) ;
+
+    SVG_ELEMENT_ATTRIBUTE(in_, in, std::string, std::string())
+} ;
+
+class FEMergeElement: public Container<FEMergeNodeElement>, public Stylable {
+public:
+
+    void parseAttributes(const Dictionary &attrs) ;
+
+    SVG_ELEMENT_ATTRIBUTE(result_, result, std::string, std::string())
+} ;
+
+enum class ColorMatrixType { Matrix, Saturate, HueRotate, LuminanceToAlpha } ;
+
+class FEColorMatrixElement: public FilterPrimitiveElement {
+public:
+
+    void parseAttributes(const Dictionary &attrs) ;
+
+    SVG_ELEMENT_ATTRIBUTE(type_, type, ColorMatrixType, ColorMatrixType::Matrix)
+    SVG_ELEMENT_ATTRIBUTE(values_, values, std::vector<float>, std::vector<float>())
+} ;
+
+enum class FilterUnits { UserSpaceOnUse, ObjectBoundingBox } ;
+
+class FilterElement: public Container<FEGaussianBlurElement, FEOffsetElement, FEFloodElement, FEBlendElement,
+        FECompositeElement, FEMergeElement, FEColorMatrixElement>, public Stylable {
+public:
+
+    FilterElement() = default ;
+
+    void parseAttributes(const Dictionary &attrs) ;
+
+    SVG_ELEMENT_ATTRIBUTE(filter_units_, filterUnits, FilterUnits, FilterUnits::ObjectBoundingBox)
+    SVG_ELEMENT_ATTRIBUTE(primitive_units_, primitiveUnits, FilterUnits, FilterUnits::UserSpaceOnUse)
+
+    SVG_ELEMENT_ATTRIBUTE(x_, x, Length, Length(-10, LengthUnitType::Percentage))
+    SVG_ELEMENT_ATTRIBUTE(y_, y, Length, Length(-10, LengthUnitType::Percentage))
+    SVG_ELEMENT_ATTRIBUTE(width_, width, Length, 120.0_perc)
+    SVG_ELEMENT_ATTRIBUTE(height_, height, Length, 120.0_perc)
+} ;
+
 class UnsupportedElement: public Element {
 public:
     bool canHaveChild(const std::shared_ptr<Element> &p) const override { return true ; }
@@ -0,0 +1,536 @@
+#include "svg_filter.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <functional>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std ;
+
+namespace xg {
+namespace svg {
+
+namespace {
+
+// minimum number of pixels processed by a thread
+static const size_t min_work_per_thread = 64 * 1024 ;
+
+// call f(begin, end) over [0, n) split in bands processed in parallel when there is enough work
+void parallel_for(int n, size_t work, const std::function<void (int, int)> &f)
+{
+    static const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency()) ;
+
+    int n_threads = std::min<size_t>(max_threads, work / min_work_per_thread) ;
+    n_threads = std::min(n_threads, n) ;
+
+    if ( n_threads <= 1 ) {
+        f(0, n) ;
+        return ;
+    }
+
+    int chunk = ( n + n_threads - 1 ) / n_threads ;
+
+    vector<thread> threads ;
+    for( int b = chunk ; b < n ; b += chunk )
+        threads.emplace_back(f, b, std::min(n, b + chunk)) ;
+
+    f(0, chunk) ;
+
+    for( auto &t: threads ) t.join() ;
+}
+
+// running per channel sum of premultiplied pixels used by the box blur
+
+#ifdef __SSE2__
+
+class PixelSum {
+public:
+    PixelSum(): v_(_mm_setzero_si128()) {}
+
+    void add(uint32_t p) { v_ = _mm_add_epi32(v_, unpack(p)) ; }
+    void sub(uint32_t p) { v_ = _mm_sub_epi32(v_, unpack(p)) ; }
+
+    uint32_t average(float inv) const {
+        __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(v_), _mm_set1_ps(inv))) ;
+        a = _mm_packs_epi32(a, a) ;
+        a = _mm_packus_epi16(a, a) ;
+        return _mm_cvtsi128_si32(a) ;
+    }
+
+private:
+
+    static __m128i unpack(uint32_t p) {
+        __m128i z = _mm_setzero_si128() ;
+        return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(p), z), z) ;
+    }
+
+    __m128i v_ ;
+} ;
+
+#else
+
+class PixelSum {
+public:
+    void add(uint32_t p) {
+        for( int i=0 ; i<4 ; i++, p >>= 8 ) v_[i] += p & 0xff ;
+    }
+
+    void sub(uint32_t p) {
+        for( int i=0 ; i<4 ; i++, p >>= 8 ) v_[i] -= p & 0xff ;
+    }
+
+    uint32_t average(float inv) const {
+        uint32_t p = 0 ;
+        for( int i=3 ; i>=0 ; i-- ) p = ( p << 8 ) | std::min<int>(255, (int)( v_[i] * inv + 0.5f )) ;
+        return p ;
+    }
+
+private:
+    int v_[4] = { 0, 0, 0, 0 } ;
+} ;
+
+#endif
+
+// box blur along rows [y0, y1) with window [x - l, x + r], pixels outside of the buffer are transparent
+
+void box_blur_rows(const uint32_t *src, uint32_t *dst, int width, int y0, int y1, int l, int r)
+{
+    float inv = 1.0f / ( l + r + 1 ) ;
+
+    for( int y = y0 ; y < y1 ; y++ ) {
+        const uint32_t *s = src + (size_t)y * width ;
+        uint32_t *d = dst + (size_t)y * width ;
+
+        PixelSum sum ;
+        for( int x = 0 ; x <= r && x < width ; x++ ) sum.add(s[x]) ;
+
+        for( int x = 0 ; x < width ; x++ ) {
+            d[x] = sum.average(inv) ;
+            if ( x + r + 1 < width ) sum.add(s[x + r + 1]) ;
+            if ( x - l >= 0 ) sum.sub(s[x - l]) ;
+        }
+    }
+}
+
+// box blur along the columns [x0, x1) with window [y - l, y + r]. The sums of all columns in the band are
+// updated row by row so that memory is accessed sequentially.
+
+void box_blur_columns(const uint32_t *src, uint32_t *dst, int width, int height, int x0, int x1, int l, int r)
+{
+    float inv = 1.0f / ( l + r + 1 ) ;
+    int n = x1 - x0 ;
+
+    vector<PixelSum> sums(n) ;
+
+    for( int y = 0 ; y <= r && y < height ; y++ ) {
+        const uint32_t *s = src + (size_t)y * width + x0 ;
+        for( int i=0 ; i<n ; i++ ) sums[i].add(s[i]) ;
+    }
+
+    for( int y = 0 ; y < height ; y++ ) {
+        uint32_t *d = dst + (size_t)y * width + x0 ;
+        for( int i=0 ; i<n ; i++ ) d[i] = sums[i].average(inv) ;
+
+        if ( y + r + 1 < height ) {
+            const uint32_t *s = src + (size_t)( y + r + 1 ) * width + x0 ;
+            for( int i=0 ; i<n ; i++ ) sums[i].add(s[i]) ;
+        }
+
+        if ( y - l >= 0 ) {
+            const uint32_t *s = src + (size_t)( y - l ) * width + x0 ;
+            for( int i=0 ; i<n ; i++ ) sums[i].sub(s[i]) ;
+        }
+    }
+}
+
+// Three box blurs approximating a gaussian as described in the SVG specification. Returns the windows (l, r)
+// of the passes for the given standard deviation in pixels, none if it is too small to have an effect.
+
+int box_windows(double sigma, int l[3], int r[3])
+{
+    int d = (int)floor(sigma * 3 * sqrt(2 * M_PI) / 4 + 0.5) ;
+
+    if ( d <= 1 ) return 0 ;
+
+    if ( d % 2 ) {
+        for( int i=0 ; i<3 ; i++ ) l[i] = r[i] = ( d - 1 ) / 2 ;
+    } else {
+        l[0] = d/2 ; r[0] = d/2 - 1 ;
+        l[1] = d/2 - 1 ; r[1] = d/2 ;
+        l[2] = r[2] = d/2 ;
+    }
+
+    return 3 ;
+}
+
+// premultiplied pixel as floats in [0, 1]
+struct PixelF {
+    float a, r, g, b ;
+
+    PixelF() = default ;
+    PixelF(float a_, float r_, float g_, float b_): a(a_), r(r_), g(g_), b(b_) {}
+    PixelF(uint32_t p): a((p >> 24) / 255.0f), r(((p >> 16) & 0xff) / 255.0f), g(((p >> 8) & 0xff) / 255.0f), b((p & 0xff) / 255.0f) {}
+
+    uint32_t pack() const {
+        float ca = std::min(std::max(a, 0.0f), 1.0f) ;
+        auto channel = [ca](float v) { return (uint32_t)(std::min(std::max(v, 0.0f), ca) * 255.0f + 0.5f) ; } ;
+        return ((uint32_t)(ca * 255.0f + 0.5f) << 24) | ( channel(r) << 16 ) | ( channel(g) << 8 ) | channel(b) ;
+    }
+} ;
+
+}
+
+FilterEngine::BufferPtr FilterEngine::create() {
+    return std::make_shared<Buffer>((size_t)width_ * height_, 0) ;
+}
+
+FilterEngine::BufferPtr FilterEngine::input(const string &name) {
+    if ( name == "SourceGraphic" ) return source_ ;
+    else if ( name == "SourceAlpha" ) {
+        if ( !source_alpha_ ) {
+            source_alpha_ = create() ;
+            const uint32_t *s = source_->data() ;
+            uint32_t *d = source_alpha_->data() ;
+            for( size_t i=0, n = source_->size() ; i<n ; i++ ) d[i] = s[i] & 0xff000000 ;
+        }
+        return source_alpha_ ;
+    }
+    else if ( name == "BackgroundImage" || name == "BackgroundAlpha" || name == "FillPaint" || name == "StrokePaint" )
+        return create() ;
+
+    auto it = results_.find(name) ;
+    if ( it != results_.end() ) return it->second ;
+
+    // no or unknown reference, use the result of the previous primitive
+    return last_ ? last_ : source_ ;
+}
+
+double FilterEngine::unitScaleX() const {
+    double s = sqrt(tr_.m1() * tr_.m1() + tr_.m2() * tr_.m2()) ;
+    if ( filter_.primitiveUnits() == FilterUnits::ObjectBoundingBox ) s *= bbox_.width() ;
+    return s ;
+}
+
+double FilterEngine::unitScaleY() const {
+    double s = sqrt(tr_.m3() * tr_.m3() + tr_.m4() * tr_.m4()) ;
+    if ( filter_.primitiveUnits() == FilterUnits::ObjectBoundingBox ) s *= bbox_.height() ;
+    return s ;
+}
+
+FilterEngine::BufferPtr FilterEngine::gaussianBlur(const FEGaussianBlurElement &e)
+{
+    BufferPtr in = input(e.in()) ;
+
+    int lx[3], rx[3], ly[3], ry[3] ;
+    int nx = box_windows(e.stdDeviationX() * unitScaleX(), lx, rx) ;
+    int ny = box_windows(e.stdDeviationY() * unitScaleY(), ly, ry) ;
+
+    if ( nx == 0 && ny == 0 ) return in ;
+
+    BufferPtr a = create(), b = create() ;
+    const uint32_t *src = in->data() ;
+    int w = width_, h = height_ ;
+    size_t work = (size_t)w * h ;
+
+    for( int i=0 ; i<nx ; i++ ) {
+        uint32_t *dst = a->data() ;
+        parallel_for(h, work, [&](int y0, int y1) { box_blur_rows(src, dst, w, y0, y1, lx[i], rx[i]) ; }) ;
+        src = dst ;
+        std::swap(a, b) ;
+    }
+
+    for( int i=0 ; i<ny ; i++ ) {
+        uint32_t *dst = a->data() ;
+        parallel_for(w, work, [&](int x0, int x1) { box_blur_columns(src, dst, w, h, x0, x1, ly[i], ry[i]) ; }) ;
+        src = dst ;
+        std::swap(a, b) ;
+    }
+
+    // the last output was swapped into b
+    return b ;
+}
+
+FilterEngine::BufferPtr FilterEngine::offset(const FEOffsetElement &e)
+{
+    BufferPtr in = input(e.in()) ;
+
+    double dx = e.dx(), dy = e.dy() ;
+    if ( filter_.primitiveUnits() == FilterUnits::ObjectBoundingBox ) {
+        dx *= bbox_.width() ; dy *= bbox_.height() ;
+    }
+
+    // offsets are rounded to whole pixels
+    int ox = (int)lround(dx * tr_.m1() + dy * tr_.m3()) ;
+    int oy = (int)lround(dx * tr_.m2() + dy * tr_.m4()) ;
+
+    if ( ox == 0 && oy == 0 ) return in ;
+
+    BufferPtr out = create() ;
+
+    int x0 = std::max(0, ox), x1 = std::min(width_, width_ + ox) ;
+
+    if ( x0 < x1 ) {
+        for( int y = std::max(0, oy) ; y < std::min(height_, height_ + oy) ; y++ )
+            memcpy(out->data() + (size_t)y * width_ + x0, in->data() + (size_t)( y - oy ) * width_ + x0 - ox, ( x1 - x0 ) * sizeof(uint32_t)) ;
+    }
+
+    return out ;
+}
+
+FilterEngine::BufferPtr FilterEngine::flood(const FEFloodElement &e)
+{
+    const Style &st = e.style() ;
+    Color clr(st.getFloodColor(), st.getFloodOpacity()) ;
+
+    uint32_t p = PixelF(clr.a(), clr.r() * clr.a(), clr.g() * clr.a(), clr.b() * clr.a()).pack() ;
+
+    BufferPtr out = create() ;
+    std::fill(out->begin(), out->end(), p) ;
+    return out ;
+}
+
+FilterEngine::BufferPtr FilterEngine::blend(const FEBlendElement &e)
+{
+    BufferPtr in = input(e.in()), in2 = input(e.in2()) ;
+    BufferPtr out = create() ;
+
+    const uint32_t *sa = in->data(), *sb = in2->data() ;
+    uint32_t *d = out->data() ;
+    BlendMode mode = e.mode() ;
+    int w = width_ ;
+
+    parallel_for(height_, (size_t)width_ * height_, [&](int y0, int y1) {
+        for( size_t i = (size_t)y0 * w ; i < (size_t)y1 * w ; i++ ) {
+            // a is drawn over b
+            PixelF a(sa[i]), b(sb[i]), r ;
+            auto channel = [&](float ca, float cb) -> float {
+                switch ( mode ) {
+                case BlendMode::Multiply:
+                    return ( 1 - a.a ) * cb + ( 1 - b.a ) * ca + ca * cb ;
+                case BlendMode::Screen:
+                    return cb + ca - ca * cb ;
+                case BlendMode::Darken:
+                    return std::min(( 1 - a.a ) * cb + ca, ( 1 - b.a ) * ca + cb) ;
+                case BlendMode::Lighten:
+                    return std::max(( 1 - a.a ) * cb + ca, ( 1 - b.a ) * ca + cb) ;
+                default:
+                    return ( 1 - a.a ) * cb + ca ;
+                }
+            } ;
+
+            r.a = 1 - ( 1 - a.a ) * ( 1 - b.a ) ;
+            r.r = channel(a.r, b.r) ;
+            r.g = channel(a.g, b.g) ;
+            r.b = channel(a.b, b.b) ;
+            d[i] = r.pack() ;
+        }
+    }) ;
+
+    return out ;
+}
+
+FilterEngine::BufferPtr FilterEngine::composite(const FECompositeElement &e)
+{
+    BufferPtr in = input(e.in()), in2 = input(e.in2()) ;
+    BufferPtr out = create() ;
+
+    const uint32_t *sa = in->data(), *sb = in2->data() ;
+    uint32_t *d = out->data() ;
+    CompositeOperator op = e.op() ;
+    float k1 = e.k1(), k2 = e.k2(), k3 = e.k3(), k4 = e.k4() ;
+    int w = width_ ;
+
+    parallel_for(height_, (size_t)width_ * height_, [&](int y0, int y1) {
+        for( size_t i = (size_t)y0 * w ; i < (size_t)y1 * w ; i++ ) {
+            PixelF a(sa[i]), b(sb[i]) ;
+            float fa, fb ;
+
+            switch ( op ) {
+            case CompositeOperator::Arithmetic: {
+                auto channel = [&](float ca, float cb) { return k1 * ca * cb + k2 * ca + k3 * cb + k4 ; } ;
+                d[i] = PixelF(channel(a.a, b.a), channel(a.r, b.r), channel(a.g, b.g), channel(a.b, b.b)).pack() ;
+                continue ;
+            }
+            case CompositeOperator::In:
+                fa = b.a ; fb = 0 ;
+                break ;
+            case CompositeOperator::Out:
+                fa = 1 - b.a ; fb = 0 ;
+                break ;
+            case CompositeOperator::Atop:
+                fa = b.a ; fb = 1 - a.a ;
+                break ;
+            case CompositeOperator::Xor:
+                fa = 1 - b.a ; fb = 1 - a.a ;
+                break ;
+            default:
+                fa = 1 ; fb = 1 - a.a ;
+                break ;
+            }
+
+            d[i] = PixelF(a.a * fa + b.a * fb, a.r * fa + b.r * fb, a.g * fa + b.g * fb, a.b * fa + b.b * fb).pack() ;
+        }
+    }) ;
+
+    return out ;
+}
+
+FilterEngine::BufferPtr FilterEngine::merge(const FEMergeElement &e)
+{
+    BufferPtr out = create() ;
+    uint32_t *d = out->data() ;
+    int w = width_ ;
+
+    for( const auto &c: e.children() ) {
+        auto node = dynamic_cast<const FEMergeNodeElement *>(c.get()) ;
+        if ( !node ) continue ;
+
+        BufferPtr in = input(node->in()) ;
+        const uint32_t *s = in->data() ;
+
+        parallel_for(height_, (size_t)width_ * height_, [&](int y0, int y1) {
+            for( size_t i = (size_t)y0 * w ; i < (size_t)y1 * w ; i++ ) {
+                uint32_t p = s[i] ;
+                if ( ( p >> 24 ) == 0xff || d[i] == 0 ) d[i] = p ;
+                else if ( p != 0 ) {
+                    PixelF a(p), b(d[i]) ;
+                    float f = 1 - a.a ;
+                    d[i] = PixelF(a.a + b.a * f, a.r + b.r * f, a.g + b.g * f, a.b + b.b * f).pack() ;
+                }
+            }
+        }) ;
+    }
+
+    return out ;
+}
+
+FilterEngine::BufferPtr FilterEngine::colorMatrix(const FEColorMatrixElement &e)
+{
+    BufferPtr in = input(e.in()) ;
+
+    // 4x5 matrix applied to non-premultiplied (r, g, b, a, 1)
+    float m[20] = { 1, 0, 0, 0, 0,
+                    0, 1, 0, 0, 0,
+                    0, 0, 1, 0, 0,
+                    0, 0, 0, 1, 0 } ;
+
+    const vector<float> &values = e.values() ;
+
+    switch ( e.type() ) {
+    case ColorMatrixType::Matrix:
+        if ( values.size() == 20 ) std::copy(values.begin(), values.end(), m) ;
+        break ;
+    case ColorMatrixType::Saturate: {
+        float s = values.empty() ? 1.0f : values[0] ;
+        float sm[20] = { 0.213f + 0.787f * s, 0.715f - 0.715f * s, 0.072f - 0.072f * s, 0, 0,
+                         0.213f - 0.213f * s, 0.715f + 0.285f * s, 0.072f - 0.072f * s, 0, 0,
+                         0.213f - 0.213f * s, 0.715f - 0.715f * s, 0.072f + 0.928f * s, 0, 0,
+                         0, 0, 0, 1, 0 } ;
+        std::copy(sm, sm + 20, m) ;
+        break ;
+    }
+    case ColorMatrixType::HueRotate: {
+        float a = ( values.empty() ? 0.0f : values[0] ) * M_PI / 180.0 ;
+        float c = cos(a), s = sin(a) ;
+        float hm[20] = { 0.213f + c * 0.787f - s * 0.213f, 0.715f - c * 0.715f - s * 0.715f, 0.072f - c * 0.072f + s * 0.928f, 0, 0,
+                         0.213f - c * 0.213f + s * 0.143f, 0.715f + c * 0.285f + s * 0.140f, 0.072f - c * 0.072f - s * 0.283f, 0, 0,
+                         0.213f - c * 0.213f - s * 0.787f, 0.715f - c * 0.715f + s * 0.715f, 0.072f + c * 0.928f + s * 0.072f, 0, 0,
+                         0, 0, 0, 1, 0 } ;
+        std::copy(hm, hm + 20, m) ;
+        break ;
+    }
+    case ColorMatrixType::LuminanceToAlpha: {
+        float lm[20] = { 0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0,
+                         0, 0, 0, 0, 0,
+                         0.2125f, 0.7154f, 0.0721f, 0, 0 } ;
+        std::copy(lm, lm + 20, m) ;
+        break ;
+    }
+    }
+
+    BufferPtr out = create() ;
+    const uint32_t *s = in->data() ;
+    uint32_t *d = out->data() ;
+    int w = width_ ;
+
+    parallel_for(height_, (size_t)width_ * height_, [&](int y0, int y1) {
+        for( size_t i = (size_t)y0 * w ; i < (size_t)y1 * w ; i++ ) {
+            PixelF p(s[i]) ;
+
+            float r = 0, g = 0, b = 0 ;
+            if ( p.a > 0 ) {
+                r = p.r / p.a ; g = p.g / p.a ; b = p.b / p.a ;
+            }
+
+            float na = std::min(std::max(m[15] * r + m[16] * g + m[17] * b + m[18] * p.a + m[19], 0.0f), 1.0f) ;
+            float nr = m[0] * r + m[1] * g + m[2] * b + m[3] * p.a + m[4] ;
+            float ng = m[5] * r + m[6] * g + m[7] * b + m[8] * p.a + m[9] ;
+            float nb = m[10] * r + m[11] * g + m[12] * b + m[13] * p.a + m[14] ;
+
+            d[i] = PixelF(na, nr * na, ng * na, nb * na).pack() ;
+        }
+    }) ;
+
+    return out ;
+}
+
+void FilterEngine::apply(unsigned char *pixels, int width, int height, int stride)
+{
+    width_ = width ; height_ = height ;
+
+    source_ = create() ;
+    for( int y=0 ; y<height ; y++ )
+        memcpy(source_->data() + (size_t)y * width, pixels + (size_t)y * stride, width * sizeof(uint32_t)) ;
+
+    last_.reset() ;
+    results_.clear() ;
+    source_alpha_.reset() ;
+    bool has_primitives = false ;
+
+    for( const auto &c: filter_.children() ) {
+        BufferPtr out ;
+        string result ;
+
+        if ( auto p = dynamic_cast<const FEGaussianBlurElement *>(c.get()) ) {
+            out = gaussianBlur(*p) ;
+            result = p->result() ;
+        } else if ( auto p = dynamic_cast<const FEOffsetElement *>(c.get()) ) {
+            out = offset(*p) ;
+            result = p->result() ;
+        } else if ( auto p = dynamic_cast<const FEFloodElement *>(c.get()) ) {
+            out = flood(*p) ;
+            result = p->result() ;
+        } else if ( auto p = dynamic_cast<const FEBlendElement *>(c.get()) ) {
+            out = blend(*p) ;
+            result = p->result() ;
+        } else if ( auto p = dynamic_cast<const FECompositeElement *>(c.get()) ) {
+            out = composite(*p) ;
+            result = p->result() ;
+        } else if ( auto p = dynamic_cast<const FEMergeElement *>(c.get()) ) {
+            out = merge(*p) ;
+            result = p->result() ;
+        } else if ( auto p = dynamic_cast<const FEColorMatrixElement *>(c.get()) ) {
+            out = colorMatrix(*p) ;
+            result = p->result() ;
+        } else continue ;
+
+        if ( !result.empty() ) results_[result] = out ;
+        last_ = out ;
+        has_primitives = true ;
+    }
+
+    // an empty filter disables rendering of the element
+    if ( !has_primitives ) last_ = create() ;
+
+    for( int y=0 ; y<height ; y++ )
+        memcpy(pixels + (size_t)y * stride, last_->data() + (size_t)y * width, width * sizeof(uint32_t)) ;
+}
+
+}
+}
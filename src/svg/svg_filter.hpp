@@ -0,0 +1,64 @@
+#ifndef __XG_SVG_FILTER_HPP__
+#define __XG_SVG_FILTER_HPP__
+
+#include "svg_dom.hpp"
+
+#include <xg/xform.hpp>
+#include <xg/rectangle.hpp>
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+
+namespace xg {
+namespace svg {
+
+// Runs the primitives of a <filter> element on the pixels of a layer covering the filter region. All intermediate
+// results are premultiplied ARGB32 buffers of the layer size. Passes over large buffers are split in bands that
+// are processed in parallel. Colors are processed in sRGB (color-interpolation-filters is ignored).
+
+class FilterEngine {
+public:
+
+    // tr maps the user space of the filtered element to layer pixels, bbox is the bounding box of the element
+    // used when primitiveUnits="objectBoundingBox"
+    FilterEngine(const FilterElement &filter, const Matrix2d &tr, const Rectangle2d &bbox):
+        filter_(filter), tr_(tr), bbox_(bbox) {}
+
+    // replace the pixels with the filter output
+    void apply(unsigned char *pixels, int width, int height, int stride) ;
+
+private:
+
+    typedef std::vector<uint32_t> Buffer ;
+    typedef std::shared_ptr<Buffer> BufferPtr ;
+
+    BufferPtr input(const std::string &name) ;
+    BufferPtr create() ;
+
+    BufferPtr gaussianBlur(const FEGaussianBlurElement &e) ;
+    BufferPtr offset(const FEOffsetElement &e) ;
+    BufferPtr flood(const FEFloodElement &e) ;
+    BufferPtr blend(const FEBlendElement &e) ;
+    BufferPtr composite(const FECompositeElement &e) ;
+    BufferPtr merge(const FEMergeElement &e) ;
+    BufferPtr colorMatrix(const FEColorMatrixElement &e) ;
+
+    // scale of primitive units to pixels along each axis
+    double unitScaleX() const ;
+    double unitScaleY() const ;
+
+    const FilterElement &filter_ ;
+    Matrix2d tr_ ;
+    Rectangle2d bbox_ ;
+
+    int width_, height_ ;
+    BufferPtr source_, source_alpha_, last_ ;
+    std::map<std::string, BufferPtr> results_ ;
+} ;
+
+}
+}
+
+#endif
@@ -121,6 +121,24 @@ void SVGParser::beginElement(const string &name, const Dictionary &attributes) {
         createNode<svg::StyleElement>(attributes) ;
     else if ( name == "stop" )
         createNode<svg::StopElement>(attributes) ;
+    else if ( name == "filter" )
+        createNode<svg::FilterElement>(attributes) ;
+    else if ( name == "feGaussianBlur" )
+        createNode<svg::FEGaussianBlurElement>(attributes) ;
+    else if ( name == "feOffset" )
+        createNode<svg::FEOffsetElement>(attributes) ;
+    else if ( name == "feFlood" )
+        createNode<svg::FEFloodElement>(attributes) ;
+    else if ( name == "feBlend" )
+        createNode<svg::FEBlendElement>(attributes) ;
+    else if ( name == "feComposite" )
+        createNode<svg::FECompositeElement>(attributes) ;
+    else if ( name == "feMerge" )
+        createNode<svg::FEMergeElement>(attributes) ;
+    else if ( name == "feMergeNode" )
+        createNode<svg::FEMergeNodeElement>(attributes) ;
+    else if ( name == "feColorMatrix" )
+        createNode<svg::FEColorMatrixElement>(attributes) ;
     else
         createNode<svg::UnsupportedElement>(attributes) ;
 }
@@ -1,4 +1,5 @@
 #include "svg_render_context.hpp"
+#include "svg_filter.hpp"
 #include <xg/text_layout.hpp>
 
 using namespace std ;
@@ -407,6 +408,157 @@ void RenderingContext::setPaint(Element &e)
 
 }
 
+// true if the shape bounds, padded by the stroke extent, fall outside the current clip region
+// and the shape can be skipped. Should be called after preRenderShape so that bounds are in user space.
+
+bool RenderingContext::isCulled(const Rectangle2d &bounds)
+{
+    if ( bounds.empty() ) return false ;
+
+    double pad = strokePadding(states_.back()) ;
+
+    Rectangle2d r(bounds.x() - pad, bounds.y() - pad, bounds.width() + 2*pad, bounds.height() + 2*pad) ;
+
+    return !r.intersects(canvas_.clipExtents()) ;
+}
+
+// distance that the stroke may extend outside of the shape geometry
+
+double RenderingContext::strokePadding(const Style &st)
+{
+    if ( st.getStrokePaint().type() == PaintType::None ) return 0 ;
+
+    double hw = toPixels(st.getStrokeWidth(), LengthDirection::Absolute)/2.0 ;
+    return hw * std::max<double>(st.getMiterLimit(), 1.0) ;
+}
+
+// bounding box of a rectangle mapped by the transform
+
+static Rectangle2d transform_bounds(const Matrix2d &m, const Rectangle2d &r)
+{
+    Point2d p[4] = { m.transform(r.topLeft()), m.transform(r.topRight()),
+                     m.transform(r.bottomLeft()), m.transform(r.bottomRight()) } ;
+
+    Rectangle2d b(p[0], p[0]) ;
+    for( int i=1 ; i<4 ; i++ ) b.extend(p[i]) ;
+    return b ;
+}
+
+// Bounds of the element in its own user space, i.e. before its transform. With fill_only the stroke and the filter
+// regions of descendants are left out, giving the object bounding box. Returns false when they cannot be computed
+// cheaply (text, images, references), in which case the element should be treated as unbounded.
+
+bool RenderingContext::localBounds(Element *e, Rectangle2d &bounds, bool fill_only)
+{
+    Rectangle2d r ;
+    bool has_stroke = !fill_only ;
+
+    if ( auto p = dynamic_cast<GroupElement *>(e) ) {
+        pushState(p->style()) ;
+        for( const auto &c: p->children() ) {
+            Rectangle2d cb ;
+            bool ok ;
+            if ( fill_only ) {
+                ok = localBounds(c.get(), cb, true) ;
+                if ( ok && !cb.empty() ) cb = transform_bounds(dynamic_cast<Transformable *>(c.get())->trans(), cb) ;
+            }
+            else
+                ok = contentBounds(c.get(), cb) ;
+
+            if ( !ok ) {
+                popState() ;
+                return false ;
+            }
+            r = r.united(cb) ;
+        }
+        popState() ;
+        has_stroke = false ;
+    }
+    else if ( auto p = dynamic_cast<RectElement *>(e) )
+        r = Rectangle2d(toPixels(p->x(), LengthDirection::Horizontal), toPixels(p->y(), LengthDirection::Vertical),
+                        toPixels(p->width(), LengthDirection::Horizontal), toPixels(p->height(), LengthDirection::Vertical)) ;
+    else if ( auto p = dynamic_cast<CircleElement *>(e) ) {
+        double r0 = toPixels(p->r(), LengthDirection::Absolute) ;
+        r = Rectangle2d(toPixels(p->cx(), LengthDirection::Horizontal) - r0, toPixels(p->cy(), LengthDirection::Vertical) - r0, 2*r0, 2*r0) ;
+    }
+    else if ( auto p = dynamic_cast<EllipseElement *>(e) ) {
+        double rx = toPixels(p->rx(), LengthDirection::Horizontal), ry = toPixels(p->ry(), LengthDirection::Vertical) ;
+        r = Rectangle2d(toPixels(p->cx(), LengthDirection::Horizontal) - rx, toPixels(p->cy(), LengthDirection::Vertical) - ry, 2*rx, 2*ry) ;
+    }
+    else if ( auto p = dynamic_cast<LineElement *>(e) ) {
+        Point2d p1(toPixels(p->x1(), LengthDirection::Horizontal), toPixels(p->y1(), LengthDirection::Vertical)) ;
+        Point2d p2(toPixels(p->x2(), LengthDirection::Horizontal), toPixels(p->y2(), LengthDirection::Vertical)) ;
+        r = Rectangle2d(p1, p1) ;
+        r.extend(p2) ;
+    }
+    else if ( auto p = dynamic_cast<PathElement *>(e) )
+        r = p->data().path().extents() ;
+    else if ( auto p = dynamic_cast<PolygonElement *>(e) )
+        r = Path().addPolygon(p->points().points()).extents() ;
+    else if ( auto p = dynamic_cast<PolylineElement *>(e) )
+        r = Path().addPolyline(p->points().points()).extents() ;
+    else
+        return false ;
+
+    if ( has_stroke && !r.empty() ) {
+        pushState(dynamic_cast<Stylable *>(e)->style()) ;
+        double pad = strokePadding(states_.back()) ;
+        popState() ;
+        r = Rectangle2d(r.x() - pad, r.y() - pad, r.width() + 2*pad, r.height() + 2*pad) ;
+    }
+
+    bounds = r ;
+    return true ;
+}
+
+// Bounds of the element in the coordinates of its parent including the stroke and the region of its filter.
+
+bool RenderingContext::contentBounds(Element *e, Rectangle2d &bounds)
+{
+    Rectangle2d r ;
+    if ( !localBounds(e, r, false) ) return false ;
+
+    if ( r.empty() ) {
+        bounds = r ;
+        return true ;
+    }
+
+    // filter effects (e.g. shadows, blurs) may paint anywhere in the filter region
+    if ( const FilterElement *f = filterOf(e) ) {
+        Rectangle2d bbox ;
+        if ( !localBounds(e, bbox, true) ) return false ;
+        r = filterRegion(*f, bbox) ;
+    }
+
+    bounds = transform_bounds(dynamic_cast<Transformable *>(e)->trans(), r) ;
+    return true ;
+}
+
+// filter referenced by the style of the element, if any
+
+const FilterElement *RenderingContext::filterOf(Element *e)
+{
+    auto p = dynamic_cast<Stylable *>(e) ;
+    if ( !p ) return nullptr ;
+
+    string filter_id = p->style().getFilter().id() ;
+    if ( filter_id.empty() ) return nullptr ;
+
+    return dynamic_cast<FilterElement *>(e->document().resolve(filter_id)) ;
+}
+
+// region of the filter applied to an element with the given bounds
+
+Rectangle2d RenderingContext::filterRegion(const FilterElement &f, const Rectangle2d &bbox)
+{
+    if ( f.filterUnits() == FilterUnits::ObjectBoundingBox )
+        return Rectangle2d(bbox.x() + f.x().value() * bbox.width(), bbox.y() + f.y().value() * bbox.height(),
+                           f.width().value() * bbox.width(), f.height().value() * bbox.height()) ;
+    else
+        return Rectangle2d(toPixels(f.x(), LengthDirection::Horizontal), toPixels(f.y(), LengthDirection::Vertical),
+                           toPixels(f.width(), LengthDirection::Horizontal), toPixels(f.height(), LengthDirection::Vertical)) ;
+}
+
 void RenderingContext::postRenderShape()
 {
     canvas_.restore() ;
@@ -488,7 +640,7 @@ void RenderingContext::applyClipPath(ClipPathElement *cp)
 
 void RenderingContext::applyClipPath(ClipPathElement *cp)
 {
-    ImageCanvas clip_canvas(canvas_.width(), canvas_.height()) ;
+    ImageCanvas clip_canvas(canvas_.width(), canvas_.height(), 300, PixelFormat::A8) ;
 
     RenderingContext clipCtx(clip_canvas, RenderingMode::Cliping) ;
     clipCtx.obbox_ = obbox_ ;
@@ -546,8 +698,10 @@ void RenderingContext::render(PolygonElement &e)
 
     if  ( rendering_mode_ == RenderingMode::Display ) {
         preRenderShape(e, e.style(), e.trans(), p.extents()) ;
-        setPaint(e) ;
-        canvas_.drawPath(p) ;
+        if ( !isCulled(obbox_) ) {
+            setPaint(e) ;
+            canvas_.drawPath(p) ;
+        }
         postRenderShape() ;
     } else {
         pushTransform(e.trans()) ;
@@ -566,8 +720,10 @@ void RenderingContext::render(PolylineElement &e)
 
     if  ( rendering_mode_ == RenderingMode::Display ) {
         preRenderShape(e, e.style(), e.trans(), p.extents()) ;
-        setPaint(e) ;
-        canvas_.drawPath(p) ;
+        if ( !isCulled(obbox_) ) {
+            setPaint(e) ;
+            canvas_.drawPath(p) ;
+        }
         postRenderShape() ;
     } else {
         pushTransform(e.trans()) ;
@@ -582,8 +738,10 @@ void RenderingContext::render(PathElement &e) {
 
     if  ( rendering_mode_ == RenderingMode::Display ) {
         preRenderShape(e, e.style(), e.trans(), p.extents()) ;
-        setPaint(e) ;
-        canvas_.drawPath(p) ;
+        if ( !isCulled(obbox_) ) {
+            setPaint(e) ;
+            canvas_.drawPath(p) ;
+        }
         postRenderShape() ;
     } else {
         pushTransform(e.trans()) ;
@@ -762,24 +920,73 @@ Font RenderingContext::makeFont(const Style &st)
         break ;
     }
 
+    // relative weights as in CSS Fonts level 4, relative widths step through the keyword values
+
+    int weight_parent = font_weights_.back() ;
+
     switch ( f_weight )
     {
     case FontWeight::Normal:
-    case FontWeight::W100:
-    case FontWeight::W200:
-    case FontWeight::W300:
-    case FontWeight::W400:
         f.setWeight(xg::FontWeight::Normal) ;
         break ;
     case FontWeight::Bold:
-    case FontWeight::Bolder:
-    case FontWeight::W500:
-    case FontWeight::W600:
-    case FontWeight::W700:
-    case FontWeight::W800:
-    case FontWeight::W900:
         f.setWeight(xg::FontWeight::Bold) ;
         break ;
+    case FontWeight::Bolder:
+        f.setWeight( weight_parent < 350 ? 400 : weight_parent < 550 ? 700 : 900 ) ;
+        break ;
+    case FontWeight::Lighter:
+        f.setWeight( weight_parent < 100 ? weight_parent : weight_parent < 550 ? 100 : weight_parent < 750 ? 400 : 700 ) ;
+        break ;
+    default:
+        f.setWeight(100 * ( static_cast<int>(f_weight) - static_cast<int>(FontWeight::W100) + 1 )) ;
+        break ;
+    }
+
+    static const int stretch_values[] = { 50, 63, 75, 87, 100, 113, 125, 150, 200 } ;
+    int stretch_parent = font_stretches_.back() ;
+
+    switch ( st.getFontStretch() )
+    {
+    case FontStretch::Normal:
+        f.setStretch(xg::FontStretch::Normal) ;
+        break ;
+    case FontStretch::UltraCondensed:
+        f.setStretch(xg::FontStretch::UltraCondensed) ;
+        break ;
+    case FontStretch::ExtraCondensed:
+        f.setStretch(xg::FontStretch::ExtraCondensed) ;
+        break ;
+    case FontStretch::Condensed:
+        f.setStretch(xg::FontStretch::Condensed) ;
+        break ;
+    case FontStretch::SemiCondensed:
+        f.setStretch(xg::FontStretch::SemiCondensed) ;
+        break ;
+    case FontStretch::SemiExpanded:
+        f.setStretch(xg::FontStretch::SemiExpanded) ;
+        break ;
+    case FontStretch::Expanded:
+        f.setStretch(xg::FontStretch::Expanded) ;
+        break ;
+    case FontStretch::ExtraExpanded:
+        f.setStretch(xg::FontStretch::ExtraExpanded) ;
+        break ;
+    case FontStretch::UltraExpanded:
+        f.setStretch(xg::FontStretch::UltraExpanded) ;
+        break ;
+    case FontStretch::Narrower: {
+        int stretch = stretch_values[0] ;
+        for( int v: stretch_values ) if ( v < stretch_parent ) stretch = v ;
+        f.setStretch(stretch) ;
+        break ;
+    }
+    case FontStretch::Wider: {
+        int stretch = stretch_values[8] ;
+        for( int i=8 ; i>=0 ; i-- ) if ( stretch_values[i] > stretch_parent ) stretch = stretch_values[i] ;
+        f.setStretch(stretch) ;
+        break ;
+    }
     }
 
     return f ;
@@ -845,6 +1052,8 @@ void RenderingContext::render(TSpanElement &e)
     Font f = makeFont(st) ;
 
     font_sizes_.push_back(f.size()) ;
+    font_weights_.push_back(f.weight()) ;
+    font_stretches_.push_back(f.stretch()) ;
 
     // we add a space here ?
 
@@ -889,6 +1098,8 @@ void RenderingContext::render(TSpanElement &e)
     }
 
     font_sizes_.pop_back() ;
+    font_weights_.pop_back() ;
+    font_stretches_.pop_back() ;
     popState() ;
 }
 
@@ -919,6 +1130,13 @@ void RenderingContext::render(TRefElement &e)
 
 
 void RenderingContext::render(Element *e) {
+    if ( rendering_mode_ == RenderingMode::Display && e != filtered_ ) {
+        if ( const FilterElement *f = filterOf(e) ) {
+            renderFiltered(e, *f) ;
+            return ;
+        }
+    }
+
     if ( auto p = dynamic_cast<SVGElement *>(e) ) render(*p) ;
     else if ( auto p = dynamic_cast<RectElement *>(e) ) render(*p) ;
     else if ( auto p = dynamic_cast<PathElement *>(e) ) render(*p) ;
@@ -934,6 +1152,56 @@ void RenderingContext::render(Element *e) {
 
 }
 
+// Render the element into a layer covering the filter region and run the filter on its pixels before compositing.
+// The opacity of a group is applied to the filter result, through a layer enclosing the filter layer.
+
+void RenderingContext::renderFiltered(Element *e, const FilterElement &f)
+{
+    // the filter region and primitive units are in the user space of the element, the object bounding box is that of
+    // the fill geometry
+    Matrix2d etr ;
+    if ( auto p = dynamic_cast<Transformable *>(e) ) etr = p->trans() ;
+
+    Rectangle2d bbox, region ;
+    if ( localBounds(e, bbox, true) && !bbox.empty() ) {
+        region = filterRegion(f, bbox) ;
+        if ( region.width() <= 0 || region.height() <= 0 ) return ;
+        region = transform_bounds(etr, region) ;
+    }
+    else {
+        // unbounded content, use the visible area as the bounding box
+        if ( !etr.is_invertible() ) return ;
+        Matrix2d inv(etr) ;
+        inv.invert() ;
+        Rectangle2d visible = canvas_.clipExtents() ;
+        bbox = transform_bounds(inv, visible) ;
+        region = transform_bounds(etr, filterRegion(f, bbox)).intersected(visible) ;
+    }
+
+    if ( region.width() <= 0 || region.height() <= 0 ) return ;
+
+    float opacity = 1.0 ;
+    if ( auto g = dynamic_cast<GroupElement *>(e) ) opacity = g->style().getOpacity() ;
+
+    if ( opacity < 1.0 ) canvas_.beginLayer(opacity, region) ;
+
+    // the layer is in the coordinates of the parent, the element transform is applied once on top of it
+    canvas_.beginLayer(1.0, region, [&](unsigned char *pixels, int width, int height, int stride, const Matrix2d &tr) {
+        Matrix2d utr(tr) ;
+        utr.premult(etr) ;
+        FilterEngine(f, utr, bbox).apply(pixels, width, height, stride) ;
+    }) ;
+
+    Element *prev = filtered_ ;
+    filtered_ = e ;
+    render(e) ;
+    filtered_ = prev ;
+
+    canvas_.endLayer() ;
+
+    if ( opacity < 1.0 ) canvas_.endLayer() ;
+}
+
 void RenderingContext::clip(Element *e) {
     if ( auto p = dynamic_cast<RectElement *>(e) ) render(*p) ;
     else if ( auto p = dynamic_cast<PathElement *>(e) ) render(*p) ;
@@ -965,7 +1233,7 @@ void RenderingContext::clipChildren(const Element &e)
 
 void RenderingContext::addClipPath(const Path &p)
 {
-    clip_path_.addPath(p.transformed(transforms_.back())) ;
+    clip_path_.addPath(p, transforms_.back()) ;
 }
 
 
@@ -1009,7 +1277,37 @@ void RenderingContext::render(SymbolElement &e, double pw, double ph)
 
 void RenderingContext::render(GroupElement &g) {
     preRenderShape(g, g.style(), g.trans(), Rectangle2d()) ;
+
+    // group opacity is applied to the children as a whole through a layer instead of to each child's paint. The
+    // layer of a filtered group encloses the filter layer (renderFiltered).
+    float opacity = g.style().getOpacity() ;
+    bool layer = rendering_mode_ == RenderingMode::Display && opacity < 1.0 ;
+
+    if ( layer && &g == filtered_ ) {
+        states_.back().setOpacity(1.0) ;
+        layer = false ;
+    }
+
+    if ( layer ) {
+        Rectangle2d bounds ;
+        // bounds of the children in the group coordinates
+        for( const auto &c: g.children() ) {
+            Rectangle2d cb ;
+            if ( !contentBounds(c.get(), cb) ) {
+                bounds = Rectangle2d() ;
+                break ;
+            }
+            bounds = bounds.united(cb) ;
+        }
+
+        states_.back().setOpacity(1.0) ;
+        canvas_.beginLayer(opacity, bounds) ;
+    }
+
     renderChildren(g) ;
+
+    if ( layer ) canvas_.endLayer() ;
+
     postRenderShape() ;
 }
 
@@ -18,6 +18,8 @@ public:
           dpi_x_ = canvas_.dpiX() ;
           dpi_y_ = canvas_.dpiY() ;
           font_sizes_.push_back(12) ;
+          font_weights_.push_back(400) ;
+          font_stretches_.push_back(100) ;
       }
 
       void pushState(const Style &) ;
@@ -28,6 +30,12 @@ public:
       void preRenderShape(Element &e, const Style &s, const Matrix2d &tr, const Rectangle2d &rect) ;
       void setPaint(Element &e) ;
       void postRenderShape() ;
+      bool isCulled(const Rectangle2d &bounds) ;
+      double strokePadding(const Style &st) ;
+      bool localBounds(Element *e, Rectangle2d &bounds, bool fill_only) ;
+      bool contentBounds(Element *e, Rectangle2d &bounds) ;
+      const FilterElement *filterOf(Element *e) ;
+      Rectangle2d filterRegion(const FilterElement &f, const Rectangle2d &bbox) ;
 
       void applyClipPath(ClipPathElement *e) ;
 
@@ -60,6 +68,7 @@ public:
 
 
       void render(Element *e) ;
+      void renderFiltered(Element *e, const FilterElement &f) ;
       void renderChildren(const Element &e) ;
 
       void clip(Element &e, const Style &st);
@@ -82,6 +91,7 @@ protected:
       std::deque<Matrix2d> transforms_ ;
       std::deque<ViewBox> view_boxes_ ;
       std::deque<double> font_sizes_ ;
+      std::deque<int> font_weights_, font_stretches_ ;
 
       Rectangle2d obbox_  ;
       RenderingMode rendering_mode_ ;
@@ -93,6 +103,7 @@ protected:
       float doc_width_hint_, doc_height_hint_ ;
       float dpi_x_ = 92, dpi_y_ = 92 ;
       Path clip_path_ ;
+      Element *filtered_ = nullptr ;   // element currently rendered into a filter layer
 
 
 };
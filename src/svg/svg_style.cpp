@@ -273,6 +273,19 @@ void Style::parseNameValue(const string &name, const string &value) {
     else if ( name == "clip-path" ) {
         parseAttribute(name, val, clip_path_) ;
     }
+    else if ( name == "filter" ) {
+        if ( val != "none" ) parseAttribute(name, val, filter_) ;
+    }
+    else if ( name == "flood-color" ) {
+        parseAttribute(name, val, flood_color_) ;
+    }
+    else if ( name == "flood-opacity" ) {
+        float v ;
+        if ( parseOpacity(val, v) )
+            setFloodOpacity(v) ;
+        else
+            throw SVGDOMAttributeValueException(name, val) ;
+    }
 
 }
 
@@ -351,6 +364,9 @@ void Style::extend(const Style &other) {
     SVG_STYLE_ATTRIBUTE_COPY(display_) ;
     SVG_STYLE_ATTRIBUTE_COPY(visibility_) ;
     SVG_STYLE_ATTRIBUTE_COPY(text_quality_) ;
+    SVG_STYLE_ATTRIBUTE_COPY(filter_) ;
+    SVG_STYLE_ATTRIBUTE_COPY(flood_color_) ;
+    SVG_STYLE_ATTRIBUTE_COPY(flood_opacity_) ;
 }
 
 bool FontSize::parse(const string &val) {
@@ -42,6 +42,9 @@ public:
     SVG_STYLE_ATTRIBUTE(Opacity,  float, opacity_, 1.0)
     SVG_STYLE_ATTRIBUTE(StopColor,  CSSColor, stop_color_, NamedColor::black())
     SVG_STYLE_ATTRIBUTE(StopOpacity,  float, stop_opacity_, 1.0)
+    SVG_STYLE_ATTRIBUTE(Filter, URI, filter_, URI())
+    SVG_STYLE_ATTRIBUTE(FloodColor,  CSSColor, flood_color_, NamedColor::black())
+    SVG_STYLE_ATTRIBUTE(FloodOpacity,  float, flood_opacity_, 1.0)
     SVG_STYLE_ATTRIBUTE(Overflow,  OverflowType, overflow_, OverflowType::Hidden)
     SVG_STYLE_ATTRIBUTE(FontFamily,  std::string, font_family_, "serif")
     SVG_STYLE_ATTRIBUTE(FontStyle,  FontStyle, font_style_, FontStyle::Normal)
@@ -3,6 +3,9 @@
 #include "backends/cairo/text_layout_engine.hpp"
 #include "backends/cairo/font_manager.hpp"
 
+#include <thread>
+#include <algorithm>
+
 namespace xg {
 
 TextLayout::TextLayout(const std::string &text, const Font &fd) {
@@ -13,6 +16,22 @@ void TextLayout::setWrapWidth(double width) {
     engine_->setWrapWidth(width) ;
 }
 
+void TextLayout::setLineSpacing(double ls) {
+    engine_->setLineSpacing(ls) ;
+}
+
+void TextLayout::setLineBreakMode(LineBreakMode mode) {
+    engine_->setLineBreakMode(mode) ;
+}
+
+void TextLayout::setLineBreakPenalties(const LineBreakPenalties &penalties) {
+    engine_->setLineBreakPenalties(penalties) ;
+}
+
+void TextLayout::setJustify(bool justify) {
+    engine_->setJustify(justify) ;
+}
+
 void TextLayout::setTextDirection(TextDirection dir) {
      engine_->setTextDirection(dir) ;
 }
@@ -34,4 +53,87 @@ const std::vector<TextLine> &TextLayout::lines() const
     return engine_->lines() ;
 }
 
+// labels are laid out in contiguous chunks by separate threads, each with its own shaping buffer and runs, which
+// are then concatenated
+
+static const size_t min_labels_per_thread = 256 ;
+
+GlyphRuns TextLayout::layoutBatch(const std::vector<std::string> &texts, const Font &font, TextDirection dir)
+{
+    static const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency()) ;
+
+    std::shared_ptr<ShapingFont> shaping_font = FontManager::instance().shapingFont(font) ;
+
+    size_t n = texts.size() ;
+    size_t n_threads = std::max<size_t>(1, std::min<size_t>(max_threads, n / min_labels_per_thread)) ;
+
+    std::vector<GlyphRuns> parts(n_threads) ;
+
+    auto layout_chunk = [&](size_t k) {
+        std::unique_ptr<hb_buffer_t, decltype(&hb_buffer_destroy)> buffer(hb_buffer_create(), hb_buffer_destroy) ;
+        GlyphRuns &part = parts[k] ;
+
+        for( size_t i = n * k / n_threads ; i < n * ( k + 1 ) / n_threads ; i++ ) {
+            part.offsets_.push_back(part.glyphs_.size()) ;
+
+            TextLayoutEngine engine(texts[i], font, shaping_font) ;
+            engine.setTextDirection(dir) ;
+            part.metrics_.emplace_back(engine.layoutGlyphs(buffer.get(), part.glyphs_, part.positions_)) ;
+        }
+    } ;
+
+    std::vector<std::thread> threads ;
+    for( size_t k=1 ; k<n_threads ; k++ )
+        threads.emplace_back(layout_chunk, k) ;
+
+    layout_chunk(0) ;
+
+    for( auto &t: threads ) t.join() ;
+
+    GlyphRuns runs ;
+
+    if ( n_threads == 1 ) runs = std::move(parts[0]) ;
+    else {
+        size_t n_glyphs = 0 ;
+        for( const GlyphRuns &part: parts ) n_glyphs += part.glyphs_.size() ;
+
+        runs.glyphs_.reserve(n_glyphs) ;
+        runs.positions_.reserve(n_glyphs) ;
+        runs.offsets_.reserve(n + 1) ;
+        runs.metrics_.reserve(n) ;
+
+        for( const GlyphRuns &part: parts ) {
+            size_t base = runs.glyphs_.size() ;
+            for( size_t offset: part.offsets_ ) runs.offsets_.push_back(base + offset) ;
+
+            runs.glyphs_.insert(runs.glyphs_.end(), part.glyphs_.begin(), part.glyphs_.end()) ;
+            runs.positions_.insert(runs.positions_.end(), part.positions_.begin(), part.positions_.end()) ;
+            runs.metrics_.insert(runs.metrics_.end(), part.metrics_.begin(), part.metrics_.end()) ;
+        }
+    }
+
+    runs.offsets_.push_back(runs.glyphs_.size()) ;
+
+    return runs ;
+}
+
+TextMetrics measureText(const std::string &text, const Font &font) {
+    std::unique_ptr<hb_buffer_t, decltype(&hb_buffer_destroy)> buffer(hb_buffer_create(), hb_buffer_destroy) ;
+
+    return TextLayoutEngine(text, font).measure(buffer.get()) ;
+}
+
+std::vector<TextMetrics> measureText(const std::vector<std::string> &texts, const Font &font) {
+    std::shared_ptr<ShapingFont> shaping_font = FontManager::instance().shapingFont(font) ;
+    std::unique_ptr<hb_buffer_t, decltype(&hb_buffer_destroy)> buffer(hb_buffer_create(), hb_buffer_destroy) ;
+
+    std::vector<TextMetrics> metrics ;
+    metrics.reserve(texts.size()) ;
+
+    for( const auto &text: texts )
+        metrics.emplace_back(TextLayoutEngine(text, font, shaping_font).measure(buffer.get())) ;
+
+    return metrics ;
+}
+
 }
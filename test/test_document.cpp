@@ -0,0 +1,148 @@
+#include <xg/canvas.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <sys/resource.h>
+
+using namespace xg ;
+using namespace std ;
+
+// document output benchmark: multi-page reports streamed to a byte counting writer
+
+static void drawPage(Canvas &canvas, int page) {
+    canvas.setFont(Font("Arial", 10)) ;
+    canvas.setBrush(SolidBrush(NamedColor::black())) ;
+    canvas.drawText("Report page " + to_string(page + 1), 40, 40) ;
+
+    canvas.setPen(Pen(NamedColor::gray(), 0.5)) ;
+    for( int row=0 ; row<40 ; row++ ) {
+        double y = 60 + row * 18 ;
+        canvas.drawLine(40, y, 555, y) ;
+        canvas.drawText("Item " + to_string(row) + "  value " + to_string(page * 40 + row), 44, y + 13) ;
+    }
+
+    canvas.clearPen() ;
+    canvas.setBrush(SolidBrush(Color(0.1, 0.3, 0.8, 0.5))) ;
+    for( int i=0 ; i<20 ; i++ )
+        canvas.drawRect(300, 62 + i * 36, 10 + (page * 7 + i * 13) % 240, 14) ;
+}
+
+static long maxRSS() {
+    struct rusage usage ;
+    getrusage(RUSAGE_SELF, &usage) ;
+    return usage.ru_maxrss ;
+}
+
+static void report(const string &label, int pages, size_t bytes, chrono::steady_clock::time_point start) {
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+    cout << label << ": " << pages / secs << " pages/s, " << bytes / 1024 << " KB, max RSS " << maxRSS() / 1024 << " MB" << endl ;
+}
+
+// counts the bytes of a document stream and keeps its start and end
+
+struct Output {
+    size_t bytes = 0 ;
+    string head, tail ;
+
+    OutputWriter writer() {
+        return [this](const char *data, size_t len) {
+            bytes += len ;
+            if ( head.size() < 16 ) head.append(data, std::min<size_t>(len, 16 - head.size())) ;
+            tail.append(data, len) ;
+            if ( tail.size() > 64 ) tail.erase(0, tail.size() - 64) ;
+            return true ;
+        } ;
+    }
+
+    // starts with first and ends with last up to trailing white space
+    bool check(const string &first, const string &last) const {
+        size_t end = tail.find_last_not_of(" \r\n") ;
+        return head.compare(0, first.size(), first) == 0 && end != string::npos && end + 1 >= last.size() &&
+                tail.compare(end + 1 - last.size(), last.size(), last) == 0 ;
+    }
+} ;
+
+static int verify(const string &label, const DocumentCanvas &canvas, const Output &out, const string &first, const string &last) {
+    if ( canvas.hasError() ) {
+        cerr << label << ": output error" << endl ;
+        return 1 ;
+    }
+    if ( !out.check(first, last) ) {
+        cerr << label << ": malformed stream" << endl ;
+        return 1 ;
+    }
+    return 0 ;
+}
+
+int main(int argc, char *argv[]) {
+
+    const int pages = ( argc > 1 ) ? atoi(argv[1]) : 2000 ;
+    const double w = 595, h = 842 ; // A4
+
+    int failed = 0 ;
+
+    {
+        Output out ;
+        auto start = chrono::steady_clock::now() ;
+
+        PDFCanvas canvas(out.writer(), w, h) ;
+        for( int i=0 ; i<pages ; i++ ) {
+            if ( i ) canvas.newPage() ;
+            drawPage(canvas, i) ;
+        }
+        canvas.finish() ;
+
+        report("PDF", pages, out.bytes, start) ;
+        failed += verify("PDF", canvas, out, "%PDF-", "%%EOF") ;
+    }
+
+    {
+        Output out ;
+        auto start = chrono::steady_clock::now() ;
+
+        PSCanvas canvas(out.writer(), w, h) ;
+        for( int i=0 ; i<pages ; i++ ) {
+            if ( i ) canvas.newPage() ;
+            drawPage(canvas, i) ;
+        }
+        canvas.finish() ;
+
+        report("PS", pages, out.bytes, start) ;
+        failed += verify("PS", canvas, out, "%!PS", "%%EOF") ;
+    }
+
+    {
+        size_t bytes = 0 ;
+        int docs = pages / 10 ;
+        auto start = chrono::steady_clock::now() ;
+
+        for( int i=0 ; i<docs ; i++ ) {
+            Output out ;
+            SVGCanvas canvas(out.writer(), w, h) ;
+            drawPage(canvas, i) ;
+            canvas.finish() ;
+
+            bytes += out.bytes ;
+            failed += verify("SVG", canvas, out, "<?xml", "</svg>") ;
+        }
+
+        report("SVG", docs, bytes, start) ;
+    }
+
+    {
+        PDFCanvas canvas("/tmp/report.pdf", w, h) ;
+        for( int i=0 ; i<10 ; i++ ) {
+            if ( i ) canvas.newPage() ;
+            drawPage(canvas, i) ;
+        }
+        canvas.finish() ;
+        if ( canvas.hasError() ) {
+            cerr << "PDF file: output error" << endl ;
+            ++failed ;
+        }
+    }
+
+    return failed ? 1 : 0 ;
+}
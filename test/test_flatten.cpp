@@ -0,0 +1,51 @@
+#include <xg/path.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <random>
+
+using namespace xg ;
+using namespace std ;
+
+// flattening benchmark over a dense corpus of random curves, arcs and ellipses
+
+int main(int argc, char *argv[]) {
+
+    std::mt19937 gen(1) ;
+    std::uniform_real_distribution<double> coord(0, 1000), radius(1, 200) ;
+
+    Path corpus ;
+
+    for( int i=0 ; i<20000 ; i++ ) {
+        corpus.moveTo(coord(gen), coord(gen)) ;
+        corpus.curveTo(coord(gen), coord(gen), coord(gen), coord(gen), coord(gen), coord(gen)) ;
+        corpus.quadTo(coord(gen), coord(gen), coord(gen), coord(gen)) ;
+        corpus.arcTo(radius(gen), radius(gen), 30, false, true, coord(gen), coord(gen)) ;
+        corpus.addEllipse(coord(gen), coord(gen), radius(gen), radius(gen)) ;
+    }
+
+    FlattenedPath buffer ;
+
+    for( double tol: { 1.0, 0.25, 0.1 } ) {
+        const int runs = 10 ;
+
+        auto start = chrono::steady_clock::now() ;
+
+        for( int r=0 ; r<runs ; r++ )
+            corpus.flatten(buffer, tol) ;
+
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+        cout << "tolerance " << tol << ": " << buffer.points().size() << " points, "
+             << corpus.commands().size() * runs / secs / 1.0e6 << " Mcmds/s, length " << buffer.length() << endl ;
+    }
+
+    Path circle ;
+    circle.addEllipse(0, 0, 100, 100) ;
+    cout << "circle perimeter " << circle.length(0.01) << " (expected " << 2 * M_PI * 100 << ")" << endl ;
+
+    circle.flatten(buffer, 0.01) ;
+    Vector2d tangent(0, 0) ;
+    Point2d p = buffer.pointAtLength(buffer.length()/4, &tangent) ;
+    cout << "quarter point " << p.x() << ' ' << p.y() << " tangent " << tangent.x() << ' ' << tangent.y() << endl ;
+}
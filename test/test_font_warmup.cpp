@@ -0,0 +1,72 @@
+#include <xg/canvas.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <fstream>
+
+using namespace xg ;
+using namespace std ;
+
+// cold start benchmark: time to the first rendered label with the fonts preloaded from the match cache. Run twice, the
+// second run reads the matches saved by the first one and checks that the cached faces render the labels exactly as
+// the faces matched by fontconfig in the first run.
+
+static const char *cache_file = "/tmp/xg_fonts.cache" ;
+static const char *reference_file = "/tmp/xg_fonts.ref" ;
+
+int main(int argc, char *argv[]) {
+
+    auto start = chrono::steady_clock::now() ;
+
+    bool cached = loadFontCache(cache_file) ;
+
+    preloadFonts({ Font("Arial, sans-serif", 10),
+                   Font("Arial, sans-serif", 10).setWeight(FontWeight::Bold),
+                   Font("Times New Roman, serif", 10).setStyle(FontStyle::Italic),
+                   Font("Courier New, monospace", 10) }) ;
+
+    double preload = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+    ImageCanvas canvas(256, 160, 96) ;
+    canvas.setFont(Font("arial, sans-serif", 12)) ;
+    canvas.setBrush(SolidBrush(NamedColor::black())) ;
+    canvas.drawText("first label", 10, 30) ;
+
+    double first = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+    saveFontCache(cache_file) ;
+
+    cout << ( cached ? "cached" : "cold" ) << ": preload " << preload * 1000 << " ms, first label " << first * 1000 << " ms" << endl ;
+
+    // one label per preloaded face
+    canvas.setFont(Font("Arial, sans-serif", 12).setWeight(FontWeight::Bold)) ;
+    canvas.drawText("bold label", 10, 60) ;
+    canvas.setFont(Font("Times New Roman, serif", 12).setStyle(FontStyle::Italic)) ;
+    canvas.drawText("italic label", 10, 90) ;
+    canvas.setFont(Font("Courier New, monospace", 12)) ;
+    canvas.drawText("monospace label", 10, 120) ;
+
+    Image im = canvas.getImage() ;
+    string pixels(im.pixels(), size_t(im.stride()) * im.height()) ;
+
+    if ( !cached ) {
+        ofstream strm(reference_file, ios::binary) ;
+        strm << pixels ;
+        return 0 ;
+    }
+
+    ifstream strm(reference_file, ios::binary) ;
+    string reference((istreambuf_iterator<char>(strm)), istreambuf_iterator<char>()) ;
+
+    if ( reference.empty() ) {
+        cout << "no reference rendering, run once without " << cache_file << endl ;
+        return 0 ;
+    }
+
+    if ( reference != pixels ) {
+        cerr << "cached faces render differently from the matched ones" << endl ;
+        return 1 ;
+    }
+
+    return 0 ;
+}
@@ -0,0 +1,77 @@
+#include <xg/path.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+using namespace xg ;
+using namespace std ;
+
+// path transform benchmark: transform a path of curves with 10M points in place and into a preallocated path,
+// compared to a point by point loop. The kernels should run at memory bandwidth.
+
+int main(int argc, char *argv[]) {
+
+    const size_t points = ( argc > 1 ) ? atol(argv[1]) : 10000000 ;
+    const int iterations = 5 ;
+
+    Path path ;
+    path.moveTo(0, 0) ;
+    for( size_t i=1 ; i + 3 <= points ; i += 3 )
+        path.curveTo(i, i % 97, i + 1, i % 89, i + 2, i % 83) ;
+
+    const size_t n_points = 1 + ( path.commands().size() - 1 ) * 3 ;
+    const double bytes = path.commands().size() * sizeof(Path::CommandBlock) ;
+
+    Matrix2d m(0.5, 0.1, -0.1, 0.5, 10, 20) ;
+    // rotation, so that repeated transforms keep the magnitude of the coordinates
+    Matrix2d rot(0.6, 0.8, -0.8, 0.6, 0, 0) ;
+
+    // point by point, reading and writing the commands
+    auto start = chrono::steady_clock::now() ;
+
+    double sum = 0 ;
+    for( int k=0 ; k<iterations ; k++ ) {
+        Path dst ;
+        for( const Path::CommandBlock &c: path.commands() ) {
+            Point2d p = m.transform(Point2d(c.arg0_, c.arg1_)) ;
+            if ( c.cmd_ == Path::CurveToCmd ) {
+                Point2d p1 = m.transform(Point2d(c.arg2_, c.arg3_)), p2 = m.transform(Point2d(c.arg4_, c.arg5_)) ;
+                dst.curveTo(p.x(), p.y(), p1.x(), p1.y(), p2.x(), p2.y()) ;
+            }
+            else dst.moveTo(p.x(), p.y()) ;
+        }
+        sum += dst.commands().back().arg0_ ;
+    }
+
+    double scalar = chrono::duration<double>(chrono::steady_clock::now() - start).count() / iterations ;
+
+    // in place
+    start = chrono::steady_clock::now() ;
+
+    for( int k=0 ; k<iterations ; k++ )
+        path.transform(rot) ;
+
+    double in_place = chrono::duration<double>(chrono::steady_clock::now() - start).count() / iterations ;
+
+    // into a path whose storage is reused after the first call
+    Path dst ;
+    path.transformed(m, dst) ;
+
+    start = chrono::steady_clock::now() ;
+
+    for( int k=0 ; k<iterations ; k++ )
+        path.transformed(m, dst) ;
+
+    double into = chrono::duration<double>(chrono::steady_clock::now() - start).count() / iterations ;
+
+    sum += dst.commands().back().arg0_ ;
+
+    cout << n_points << " points, " << bytes / ( 1 << 20 ) << " MB" << endl ;
+    cout << "point by point: " << n_points / scalar / 1e6 << " Mpoints/s, " << 2 * bytes / scalar / 1e9 << " GB/s" << endl ;
+    cout << "in place: " << n_points / in_place / 1e6 << " Mpoints/s, " << 2 * bytes / in_place / 1e9 << " GB/s" << endl ;
+    cout << "into path: " << n_points / into / 1e6 << " Mpoints/s, " << 2 * bytes / into / 1e9 << " GB/s" << endl ;
+
+    // keep the results alive
+    if ( sum == 0.123 ) cout << endl ;
+}
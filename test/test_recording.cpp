@@ -0,0 +1,74 @@
+#include <xg/canvas.hpp>
+#include <xg/recording_canvas.hpp>
+
+#include <iostream>
+
+using namespace xg ;
+using namespace std ;
+
+// record a scene, store it to disk and re-rasterize only the part that changed in a second version
+
+static void scene(RecordingCanvas &c, double offset) {
+
+    c.setBrush(SolidBrush(NamedColor::white())) ;
+    c.drawRect(0, 0, 512, 512) ;
+
+    c.setPen(Pen(NamedColor::black(), 2)) ;
+
+    for( int i=0 ; i<8 ; i++ ) {
+        c.setBrush(SolidBrush(Color(0.1 * i, 0.3, 0.5))) ;
+        c.drawCircle(40 + 60 * i, 100, 25) ;
+    }
+
+    c.save() ;
+    c.setTransform(Matrix2d::translation({offset, 0})) ;
+    c.setBrush(SolidBrush(NamedColor::red())) ;
+    c.drawRect(100, 300, 80, 80) ;
+    c.restore() ;
+
+    c.setFont(Font("Arial", 16)) ;
+    c.drawText("Display list", 20, 480) ;
+}
+
+int main(int argc, char *argv[]) {
+
+    RecordingCanvas rec1(512, 512), rec2(512, 512) ;
+
+    scene(rec1, 0) ;
+    scene(rec2, 50) ;
+
+    cout << rec1.displayList().size() << " commands, " << rec1.displayList().byteSize() << " bytes" << endl ;
+
+    rec1.displayList().save("/tmp/scene.xgdl") ;
+
+    DisplayList loaded ;
+    if ( !loaded.load("/tmp/scene.xgdl") ) {
+        cerr << "failed to load display list" << endl ;
+        return 1 ;
+    }
+
+    // render at twice the resolution
+    ImageCanvas canvas(1024, 1024, 184) ;
+    canvas.setTransform(Matrix2d::scaling(2, 2)) ;
+    loaded.replay(canvas) ;
+    canvas.saveToPng("/tmp/scene_v1.png") ;
+
+    // update only the regions that changed
+    for( const Rectangle2d &r: DisplayList::diff(loaded, rec2.displayList()) ) {
+        cout << "dirty " << r.x() << ' ' << r.y() << ' ' << r.width() << ' ' << r.height() << endl ;
+        rec2.displayList().replay(canvas, r) ;
+    }
+
+    canvas.saveToPng("/tmp/scene_v2.png") ;
+
+    // retained mode: only the regions that differ from the previous frame are re-rasterized
+    ImageCanvas live(512, 512, 92) ;
+    live.update(rec1.displayList()) ;
+
+    double area = 0 ;
+    for( const Rectangle2d &r: live.update(rec2.displayList()) )
+        area += r.width() * r.height() ;
+
+    cout << "updated " << 100.0 * area / (512 * 512) << "% of the pixels" << endl ;
+    live.saveToPng("/tmp/scene_live.png") ;
+}
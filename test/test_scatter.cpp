@@ -0,0 +1,87 @@
+#include <xg/canvas.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <random>
+
+using namespace xg ;
+using namespace std ;
+
+// scatter plot benchmark: per point drawCircle against the batched primitives
+
+static void report(const string &label, int n, chrono::steady_clock::time_point start) {
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+    cout << label << ": " << n / secs / 1.0e6 << " Mpoints/s (" << secs * 1000 << " ms)" << endl ;
+}
+
+int main(int argc, char *argv[]) {
+
+    const int n = 1000000 ;
+
+    std::mt19937 gen(1) ;
+    std::normal_distribution<double> coord(512, 150) ;
+    std::uniform_real_distribution<double> unit(0, 1) ;
+
+    vector<double> pts(2*n) ;
+    for( auto &v: pts ) v = coord(gen) ;
+
+    vector<Color> colors(n) ;
+    for( int i=0 ; i<n ; i++ ) colors[i] = ( i < n/2 ) ? Color(0.1, 0.3, 0.8, 0.5) : Color(0.8, 0.2, 0.1, 0.5) ;
+
+    vector<double> sizes(n) ;
+    for( auto &s: sizes ) s = 1 + 3 * unit(gen) ;
+
+    {
+        ImageCanvas canvas(1024, 1024, 92) ;
+        canvas.setBrush(SolidBrush(Color(0.1, 0.3, 0.8, 0.5))) ;
+
+        auto start = chrono::steady_clock::now() ;
+        for( int i=0 ; i<n ; i++ ) {
+            canvas.drawCircle(pts[2*i], pts[2*i+1], 2) ;
+        }
+        report("drawCircle", n, start) ;
+        canvas.saveToPng("/tmp/scatter_single.png") ;
+    }
+
+    {
+        ImageCanvas canvas(1024, 1024, 92) ;
+        canvas.setBrush(SolidBrush(Color(0.1, 0.3, 0.8, 0.5))) ;
+
+        auto start = chrono::steady_clock::now() ;
+        canvas.drawCircles(pts.data(), n, 2) ;
+        report("drawCircles", n, start) ;
+        canvas.saveToPng("/tmp/scatter_batch.png") ;
+    }
+
+    {
+        ImageCanvas canvas(1024, 1024, 92) ;
+        canvas.setBrush(SolidBrush(NamedColor::black())) ;
+
+        auto start = chrono::steady_clock::now() ;
+        canvas.drawCircles(pts.data(), sizes.data(), n, colors.data()) ;
+        report("drawCircles (sizes, colors)", n, start) ;
+    }
+
+    {
+        ImageCanvas canvas(1024, 1024, 92) ;
+        canvas.setBrush(SolidBrush(Color(0.1, 0.3, 0.8, 0.5))) ;
+
+        Path diamond ;
+        diamond.moveTo(0, -1).lineTo(1, 0).lineTo(0, 1).lineTo(-1, 0).closePath() ;
+
+        auto start = chrono::steady_clock::now() ;
+        canvas.drawMarkers(pts.data(), n, diamond, 2) ;
+        report("drawMarkers", n, start) ;
+    }
+
+    {
+        ImageCanvas canvas(1024, 1024, 92) ;
+        canvas.setBrush(SolidBrush(Color(0.1, 0.3, 0.8, 0.5))) ;
+        canvas.setPen(Pen(NamedColor::black(), 0.5)) ;
+
+        auto start = chrono::steady_clock::now() ;
+        canvas.drawMarkers(pts.data(), n, MarkerShape::Star, 6) ;
+        report("drawMarkers (sprites)", n, start) ;
+        canvas.saveToPng("/tmp/scatter_sprites.png") ;
+    }
+}
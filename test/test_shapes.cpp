@@ -18,7 +18,7 @@ void drawShape(Canvas &canvas, const Rectangle2d &rect) {
 
 int main(int argc, char *argv[]) {
 
-    std::shared_ptr<ImageCanvas> mask(new ImageCanvas(400, 400)) ;
+    std::shared_ptr<ImageCanvas> mask(new ImageCanvas(400, 400, 300, PixelFormat::A8)) ;
 
     mask->setBrush(SolidBrush(Color(0, 0, 0, 0))) ;
     mask->drawRect(0, 0, 400, 400) ;
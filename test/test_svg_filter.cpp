@@ -0,0 +1,171 @@
+#include <xg/canvas.hpp>
+
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <regex>
+
+using namespace xg ;
+using namespace std ;
+
+// filter benchmark: drop shadow (blur + offset + merge) of a group rendered repeatedly and compared with the same
+// drawing without filters. The shadows of the translucent groups at the bottom should not be clipped and should be as
+// translucent as the shapes casting them.
+
+static const char *svg_source = R"svg(
+<svg xmlns="http://www.w3.org/2000/svg" width="1024" height="768" viewBox="0 0 1024 768">
+  <defs>
+    <filter id="shadow" x="-20%" y="-20%" width="140%" height="140%">
+      <feGaussianBlur in="SourceAlpha" stdDeviation="8" result="blur"/>
+      <feOffset in="blur" dx="6" dy="6" result="offset"/>
+      <feFlood flood-color="navy" flood-opacity="0.6"/>
+      <feComposite in2="offset" operator="in" result="shadow"/>
+      <feMerge>
+        <feMergeNode in="shadow"/>
+        <feMergeNode in="SourceGraphic"/>
+      </feMerge>
+    </filter>
+    <filter id="soft">
+      <feGaussianBlur stdDeviation="3"/>
+      <feColorMatrix type="saturate" values="0.2"/>
+    </filter>
+  </defs>
+  <g filter="url(#shadow)">
+    <rect x="100" y="100" width="400" height="250" rx="20" fill="orange"/>
+    <circle cx="650" cy="300" r="150" fill="teal"/>
+  </g>
+  <ellipse cx="500" cy="600" rx="300" ry="80" fill="crimson" filter="url(#soft)"/>
+  <g opacity="0.7">
+    <rect x="780" y="520" width="180" height="120" fill="gold" filter="url(#shadow)"/>
+  </g>
+  <g opacity="0.5" filter="url(#shadow)">
+    <circle cx="120" cy="620" r="70" fill="purple"/>
+  </g>
+</svg>
+)svg" ;
+
+// feOffset of a transformed shape against the same shape moved by the offset, in the user space of the shape
+static const char *offset_source = R"svg(
+<svg xmlns="http://www.w3.org/2000/svg" width="1024" height="768" viewBox="0 0 1024 768">
+  <defs>
+    <filter id="move" x="0" y="0" width="1.2" height="1.4">
+      <feOffset dx="10" dy="20"/>
+    </filter>
+  </defs>
+  <rect x="100" y="100" width="200" height="120" fill="orange" filter="url(#move)"/>
+  <rect transform="translate(30 20) scale(1.5)" x="300" y="180" width="120" height="80" fill="teal" filter="url(#move)"/>
+</svg>
+)svg" ;
+
+static const char *offset_reference = R"svg(
+<svg xmlns="http://www.w3.org/2000/svg" width="1024" height="768" viewBox="0 0 1024 768">
+  <rect x="110" y="120" width="200" height="120" fill="orange"/>
+  <rect transform="translate(30 20) scale(1.5)" x="310" y="200" width="120" height="80" fill="teal"/>
+</svg>
+)svg" ;
+
+static bool load(SVGDocument &doc, const string &src) {
+    istringstream strm(src) ;
+
+    try {
+        doc.readStream(strm) ;
+    }
+    catch ( SVGLoadException &e ) {
+        cout << e.what() << endl ;
+        return false ;
+    }
+
+    return true ;
+}
+
+static void draw(ImageCanvas &canvas, const SVGDocument &doc) {
+    canvas.setBrush(SolidBrush(NamedColor::white())) ;
+    canvas.drawRect(0, 0, 1024, 768) ;
+    canvas.drawSVG(doc) ;
+}
+
+static Image render(const SVGDocument &doc) {
+    ImageCanvas canvas(1024, 768, 96) ;
+    draw(canvas, doc) ;
+    return canvas.getImage() ;
+}
+
+static const unsigned char *pixel(const Image &im, int x, int y) {
+    return reinterpret_cast<const unsigned char *>(im.pixels()) + y * im.stride() + 4 * x ;
+}
+
+// largest difference of a channel over the whole image
+static int maxDifference(const Image &a, const Image &b) {
+    int d = 0 ;
+    for( unsigned y=0 ; y<a.height() ; y++ )
+        for( unsigned x=0 ; x<a.width() ; x++ ) {
+            const unsigned char *p = pixel(a, x, y), *q = pixel(b, x, y) ;
+            for( int c=0 ; c<4 ; c++ ) d = std::max(d, abs(p[c] - q[c])) ;
+        }
+    return d ;
+}
+
+static bool isWhite(const Image &im, int x, int y) {
+    const unsigned char *p = pixel(im, x, y) ;
+    return p[0] == 0xff && p[1] == 0xff && p[2] == 0xff && p[3] == 0xff ;
+}
+
+static bool samePixel(const Image &a, const Image &b, int x, int y) {
+    const unsigned char *p = pixel(a, x, y), *q = pixel(b, x, y) ;
+    for( int c=0 ; c<4 ; c++ )
+        if ( abs(p[c] - q[c]) > 1 ) return false ;
+    return true ;
+}
+
+int main(int argc, char *argv[]) {
+
+    const int iterations = ( argc > 1 ) ? atoi(argv[1]) : 50 ;
+
+    int failed = 0 ;
+
+    // pixel checks against references
+
+    SVGDocument offset_doc, offset_ref ;
+    if ( !load(offset_doc, offset_source) || !load(offset_ref, offset_reference) ) return 1 ;
+
+    int d = maxDifference(render(offset_doc), render(offset_ref)) ;
+    if ( d > 2 ) {
+        cerr << "feOffset differs from the moved shapes by " << d << endl ;
+        ++failed ;
+    }
+
+    // the filtered drawing without the filter attributes
+    string plain_source = regex_replace(string(svg_source), regex(" filter=\"url\\(#[a-z]+\\)\""), "") ;
+
+    SVGDocument doc, plain ;
+    if ( !load(doc, svg_source) || !load(plain, plain_source) ) return 1 ;
+
+    Image filtered = render(doc), unfiltered = render(plain) ;
+
+    // the source graphic is merged over its shadow, the shadow shows next to the shape and nothing far from it
+    if ( !samePixel(filtered, unfiltered, 300, 225) || isWhite(filtered, 505, 225) || !isWhite(filtered, 1000, 20) ) {
+        cerr << "unexpected drop shadow pixels" << endl ;
+        ++failed ;
+    }
+
+    ImageCanvas canvas(1024, 768, 96) ;
+
+    auto start = chrono::steady_clock::now() ;
+
+    for( int i=0 ; i<iterations ; i++ ) draw(canvas, plain) ;
+
+    double plain_secs = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+    start = chrono::steady_clock::now() ;
+
+    for( int i=0 ; i<iterations ; i++ ) draw(canvas, doc) ;
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+    cout << "unfiltered frames: " << iterations / plain_secs << " frames/s" << endl ;
+    cout << "filtered frames: " << iterations / secs << " frames/s (" << secs / plain_secs << "x the unfiltered time)" << endl ;
+
+    canvas.saveToPng("/tmp/svg_filter.png") ;
+
+    return failed ? 1 : 0 ;
+}
@@ -0,0 +1,95 @@
+#include <xg/canvas.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+
+using namespace xg ;
+using namespace std ;
+
+// label rendering benchmark: draw map style labels one by one with drawText and as a batch laid out with
+// TextLayout::layoutBatch and painted with drawGlyphRuns. The batch layout must give the glyphs and widths of the
+// layout of each label on its own.
+
+static bool sameLayout(const GlyphRuns &runs, size_t i, const string &text, const Font &font) {
+    TextLayout layout(text, font) ;
+    layout.compute() ;
+
+    const auto &lines = layout.lines() ;
+    if ( lines.size() != 1 ) return false ;
+
+    const vector<Glyph> &glyphs = lines[0].glyphs() ;
+    size_t first = runs.offsets_[i], n = runs.offsets_[i+1] - first ;
+    if ( glyphs.size() != n ) return false ;
+
+    for( size_t j=0 ; j<n ; j++ ) {
+        const Glyph &a = glyphs[j], &b = runs.glyphs_[first + j] ;
+        if ( a.index_ != b.index_ || a.face_ != b.face_ || fabs(a.x_advance_ - b.x_advance_) > 1.0e-6 ) return false ;
+    }
+
+    return fabs(runs.metrics_[i].width_ - layout.width()) < 1.0e-6 ;
+}
+
+int main(int argc, char *argv[]) {
+
+    const int labels = ( argc > 1 ) ? atoi(argv[1]) : 20000 ;
+
+    Font font("Arial", 10) ;
+
+    vector<string> texts ;
+    vector<double> origins ;
+    vector<Color> colors ;
+
+    for( int i=0 ; i<labels ; i++ ) {
+        texts.emplace_back("label " + to_string(i)) ;
+        origins.push_back(( i * 37 ) % 960) ;
+        origins.push_back(( i * 53 ) % 1024 + 10) ;
+        colors.emplace_back(( i / 100 ) % 2 ? NamedColor::black() : NamedColor::blue()) ;
+    }
+
+    ImageCanvas single(1024, 1024, 96) ;
+    single.setFont(font) ;
+    single.setBrush(SolidBrush(NamedColor::black())) ;
+
+    auto start = chrono::steady_clock::now() ;
+
+    for( int i=0 ; i<labels ; i++ )
+        single.drawText(texts[i], origins[2*i], origins[2*i+1]) ;
+
+    double draw_text = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+    ImageCanvas batch(1024, 1024, 96) ;
+    batch.setFont(font) ;
+    batch.setBrush(SolidBrush(NamedColor::black())) ;
+
+    start = chrono::steady_clock::now() ;
+
+    GlyphRuns runs = TextLayout::layoutBatch(texts, font) ;
+
+    double layout = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+    batch.drawGlyphRuns(runs, origins.data(), colors.data()) ;
+
+    double total = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+    cout << "drawText: " << labels / draw_text << " labels/s" << endl ;
+    cout << "batch: " << labels / total << " labels/s (" << draw_text / total << "x), layout " << layout * 1000 << " ms, "
+         << runs.glyphs_.size() << " glyphs" << endl ;
+
+    batch.saveToPng("/tmp/text_batch.png") ;
+
+    if ( runs.size() != texts.size() ) {
+        cerr << "batch: " << runs.size() << " labels laid out, expected " << texts.size() << endl ;
+        return 1 ;
+    }
+
+    for( size_t i=0 ; i<texts.size() ; i++ ) {
+        if ( !sameLayout(runs, i, texts[i], font) ) {
+            cerr << "batch: layout of label " << i << " (" << texts[i] << ") differs from TextLayout" << endl ;
+            return 1 ;
+        }
+    }
+
+    return 0 ;
+}
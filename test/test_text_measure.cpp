@@ -0,0 +1,61 @@
+#include <xg/text_layout.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+
+using namespace xg ;
+using namespace std ;
+
+// text measurement benchmark: size axis style labels with a full layout, with measureText and with the batch version
+
+int main(int argc, char *argv[]) {
+
+    const int labels = ( argc > 1 ) ? atoi(argv[1]) : 20000 ;
+
+    Font font("Arial", 11) ;
+
+    vector<string> texts ;
+    for( int i=0 ; i<labels ; i++ ) texts.emplace_back(to_string(i * 0.25)) ;
+
+    double w_layout = 0, w_measure = 0, w_batch = 0 ;
+
+    auto start = chrono::steady_clock::now() ;
+
+    for( const string &text: texts ) {
+        TextLayout layout(text, font) ;
+        layout.compute() ;
+        w_layout += layout.width() ;
+    }
+
+    double layout = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+    start = chrono::steady_clock::now() ;
+
+    for( const string &text: texts )
+        w_measure += measureText(text, font).width_ ;
+
+    double measure = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+    start = chrono::steady_clock::now() ;
+
+    for( const TextMetrics &m: measureText(texts, font) )
+        w_batch += m.width_ ;
+
+    double batch = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+    cout << "layout: " << labels / layout << " labels/s, total width " << w_layout << endl ;
+    cout << "measure: " << labels / measure << " labels/s (" << layout / measure << "x), total width " << w_measure << endl ;
+    cout << "batch: " << labels / batch << " labels/s (" << layout / batch << "x), total width " << w_batch << endl ;
+
+    // all three must agree up to rounding, allow 1/100 pixel per label
+    double tol = 0.01 * labels ;
+
+    if ( fabs(w_measure - w_layout) > tol || fabs(w_batch - w_layout) > tol ) {
+        cerr << "width mismatch: layout " << w_layout << ", measure " << w_measure << ", batch " << w_batch << endl ;
+        return 1 ;
+    }
+
+    return 0 ;
+}
@@ -0,0 +1,45 @@
+#include <xg/canvas.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+using namespace xg ;
+using namespace std ;
+
+// text rendering benchmark: axis style labels drawn from the glyph cache and as filled outlines
+
+static double drawLabels(ImageCanvas &canvas, TextRenderMode mode, int labels) {
+
+    canvas.setBrush(SolidBrush(NamedColor::white())) ;
+    canvas.drawRect(0, 0, canvas.width(), canvas.height()) ;
+
+    canvas.setTextRenderMode(mode) ;
+    canvas.setFont(Font("Arial", 11)) ;
+    canvas.setBrush(SolidBrush(NamedColor::black())) ;
+
+    auto start = chrono::steady_clock::now() ;
+
+    for( int i=0 ; i<labels ; i++ ) {
+        double x = 10 + ( i * 97 ) % 900, y = 20 + ( i * 13 ) % 700 ;
+        canvas.drawText(to_string(i * 0.25), x, y) ;
+    }
+
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+}
+
+int main(int argc, char *argv[]) {
+
+    const int labels = ( argc > 1 ) ? atoi(argv[1]) : 20000 ;
+
+    ImageCanvas canvas(1024, 768, 96) ;
+
+    double outlines = drawLabels(canvas, TextRenderMode::Outlines, labels) ;
+    canvas.saveToPng("/tmp/labels_outlines.png") ;
+
+    double glyphs = drawLabels(canvas, TextRenderMode::Glyphs, labels) ;
+    canvas.saveToPng("/tmp/labels_glyphs.png") ;
+
+    cout << "outlines: " << labels / outlines << " labels/s" << endl ;
+    cout << "glyphs: " << labels / glyphs << " labels/s (" << outlines / glyphs << "x)" << endl ;
+}
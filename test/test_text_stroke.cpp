@@ -0,0 +1,45 @@
+#include <xg/canvas.hpp>
+
+using namespace xg ;
+using namespace std ;
+
+// stroked glyphs followed by shapes stroked with the same pen, the frame and the line below the text should be
+// drawn with the thick dashed pen
+
+int main(int argc, char *argv[]) {
+
+    ImageCanvas canvas(480, 200, 96) ;
+
+    canvas.setBrush(SolidBrush(NamedColor::white())) ;
+    canvas.drawRect(0, 0, canvas.width(), canvas.height()) ;
+
+    Font font("Arial", 64) ;
+
+    TextLayout layout("Stroked", font) ;
+    layout.compute() ;
+
+    vector<Glyph> glyphs ;
+    vector<Point2d> positions ;
+
+    double x = 40 ;
+    for( const Glyph &g: layout.lines()[0].glyphs() ) {
+        glyphs.push_back(g) ;
+        positions.emplace_back(x + g.x_offset_, 110 - g.y_offset_) ;
+        x += g.x_advance_ ;
+    }
+
+    Pen pen(NamedColor::blue(), 6) ;
+    pen.setLineJoin(LineJoin::Miter).setLineCap(LineCap::Butt).setDashArray({12, 6}) ;
+
+    canvas.setFont(font) ;
+    canvas.setPen(pen) ;
+    canvas.setBrush(SolidBrush(NamedColor::yellow())) ;
+
+    canvas.drawGlyphs(glyphs, positions) ;
+
+    canvas.clearBrush() ;
+    canvas.drawRect(20, 20, 440, 160) ;
+    canvas.drawLine(40, 140, x, 140) ;
+
+    canvas.saveToPng("/tmp/text_stroke.png") ;
+}
@@ -0,0 +1,143 @@
+#include <xg/text_layout.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <sstream>
+#include <map>
+#include <cmath>
+
+using namespace xg ;
+using namespace std ;
+
+// line breaking benchmark: wrap text blocks of increasing size greedily and with optimal fit. Time per KB
+// should stay constant, raggedness is the mean squared slack of the lines.
+
+static const double wrap_width = 400 ;
+
+// soft hyphen (U+00AD) marking hyphenation points
+#define SHY "\xC2\xAD"
+
+static string makeText(size_t bytes, bool hyphens = true) {
+    static const char *words[] = { "lorem", "ipsum", "dolor", "sit", "amet,", "con" SHY "sec" SHY "te" SHY "tur", "adi" SHY "pis" SHY "cing",
+                                   "elit", "sed", "do", "eius" SHY "mod", "tem" SHY "por", "in" SHY "ci" SHY "di" SHY "dunt", "ut",
+                                   "la" SHY "bo" SHY "re", "et", "do" SHY "lo" SHY "re", "mag" SHY "na", "ali" SHY "qua." } ;
+    string text ;
+    for( size_t i=0 ; text.size() < bytes ; i++ ) {
+        string word = words[(i * 7) % 19] ;
+        if ( !hyphens ) {
+            for( size_t pos ; ( pos = word.find(SHY) ) != string::npos ; ) word.erase(pos, 2) ;
+        }
+        text += word ;
+        text += ( i % 97 == 96 ) ? '\n' : ' ' ;
+    }
+    return text ;
+}
+
+static void run(const string &label, const string &text, size_t kb, LineBreakMode mode, bool justify) {
+
+    auto start = chrono::steady_clock::now() ;
+
+    TextLayout layout(text, Font("Arial", 12)) ;
+    layout.setWrapWidth(wrap_width) ;
+    layout.setLineBreakMode(mode) ;
+    layout.setJustify(justify) ;
+    layout.setLineSpacing(1.2) ;
+    layout.compute() ;
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count() ;
+
+    double raggedness = 0 ;
+    const auto &lines = layout.lines() ;
+    for( size_t i=0 ; i+1<lines.size() ; i++ ) {
+        double slack = wrap_width - lines[i].width() ;
+        raggedness += slack * slack ;
+    }
+
+    cout << label << " " << kb << " KB: " << lines.size() << " lines, " << secs * 1000 << " ms, "
+         << secs * 1e6 / kb << " us/KB, raggedness " << raggedness / lines.size() << endl ;
+}
+
+// Greedy breaking of paragraphs of space separated words (no hyphenation points) computed from the word widths: a
+// word stays on the line if it fits together with the space following it, lines do not include the trailing space.
+
+static vector<double> greedyReference(const string &text, const Font &font) {
+    double space = measureText("a a", font).width_ - 2 * measureText("a", font).width_ ;
+
+    map<string, double> widths ;
+    vector<double> lines ;
+
+    istringstream paragraphs(text) ;
+    string paragraph ;
+
+    while ( getline(paragraphs, paragraph) ) {
+        vector<string> words ;
+        istringstream strm(paragraph) ;
+        for( string word ; strm >> word ; ) words.push_back(word) ;
+
+        double len = 0, line = 0 ;
+        bool empty = true ;
+
+        for( size_t i=0 ; i<words.size() ; i++ ) {
+            auto it = widths.find(words[i]) ;
+            if ( it == widths.end() ) it = widths.emplace(words[i], measureText(words[i], font).width_).first ;
+
+            double w = it->second, trailing = ( i + 1 < words.size() ) ? space : 0 ;
+
+            if ( !empty && len + w + trailing > wrap_width ) {
+                lines.push_back(line) ;
+                len = 0 ;
+                empty = true ;
+            }
+
+            line = len + w ;
+            len += w + trailing ;
+            empty = false ;
+        }
+
+        lines.push_back(line) ;
+    }
+
+    return lines ;
+}
+
+static bool checkGreedy(const string &text) {
+    Font font("Arial", 12) ;
+
+    TextLayout layout(text, font) ;
+    layout.setWrapWidth(wrap_width) ;
+    layout.setLineBreakMode(LineBreakMode::Greedy) ;
+    layout.compute() ;
+
+    vector<double> expected = greedyReference(text, font) ;
+    const auto &lines = layout.lines() ;
+
+    if ( lines.size() != expected.size() ) {
+        cerr << "greedy: " << lines.size() << " lines, expected " << expected.size() << endl ;
+        return false ;
+    }
+
+    for( size_t i=0 ; i<lines.size() ; i++ ) {
+        if ( fabs(lines[i].width() - expected[i]) > 0.5 ) {
+            cerr << "greedy: line " << i << " is " << lines[i].width() << " wide, expected " << expected[i] << endl ;
+            return false ;
+        }
+    }
+
+    return true ;
+}
+
+int main(int argc, char *argv[]) {
+
+    // without hyphenation points the line breaks of the greedy mode must match the reference
+    string plain = makeText(12 * 1024, false) ;
+    plain.erase(plain.find_last_not_of(" \n") + 1) ;
+    if ( !checkGreedy(plain) ) return 1 ;
+
+    for( size_t kb = 12 ; kb <= 192 ; kb *= 2 ) {
+        string text = makeText(kb * 1024) ;
+
+        run("greedy", text, kb, LineBreakMode::Greedy, false) ;
+        run("optimal", text, kb, LineBreakMode::OptimalFit, false) ;
+        run("optimal justified", text, kb, LineBreakMode::OptimalFit, true) ;
+    }
+}